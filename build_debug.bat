@@ -1,2 +1,4 @@
 @echo off
-gcc -g -Wall -Wextra -Werror -pedantic -std=c11 src/main.c src/fourier1.c src/realfft.c src/kmeans.c -o bin/Debug/SonicSpectra -Iinclude -Llib -lraylib -ltag_c -ltag -lopengl32 -lgdi32 -lwinmm
\ No newline at end of file
+gcc -g -Wall -Wextra -Werror -pedantic -std=c11 -DALLOC_ACCOUNTING src/main.c src/fourier1.c src/realfft.c src/kmeans.c src/audio_feeder.c src/track_loader.c src/playlist.c src/mapped_file.c src/wav_source.c src/latency_probe.c src/mp3_index.c src/palette_bench.c src/palette.c src/palette_cache.c src/oklab.c src/jpeg_scaled.c src/resample.c src/id3v2.c src/tag_bench.c src/library_index.c src/arena.c src/alloc_probe.c -o bin/Debug/SonicSpectra -Iinclude -Llib -lraylib -ltag_c -ltag -lopengl32 -lgdi32 -lwinmm -lpthread -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free || exit /b 1
+rem No heap calls on the per-frame path once warmed up (tests/audio/make_fixtures.py writes the file)
+bin\Debug\SonicSpectra --alloc-check tests\audio\tones.wav
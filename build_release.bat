@@ -1,2 +1,2 @@
 @echo off
-gcc -s -Os -std=c11 src/main.c src/fourier1.c src/realfft.c src/kmeans.c -o bin/Release/SonicSpectra -Iinclude -Llib -lraylib -ltag_c -ltag -lopengl32 -lgdi32 -lwinmm
\ No newline at end of file
+gcc -s -Os -std=c11 src/main.c src/fourier1.c src/realfft.c src/kmeans.c src/audio_feeder.c src/track_loader.c src/playlist.c src/mapped_file.c src/wav_source.c src/latency_probe.c src/mp3_index.c src/palette_bench.c src/palette.c src/palette_cache.c src/oklab.c src/jpeg_scaled.c src/resample.c src/id3v2.c src/tag_bench.c src/library_index.c src/arena.c src/alloc_probe.c -o bin/Release/SonicSpectra -Iinclude -Llib -lraylib -ltag_c -ltag -lopengl32 -lgdi32 -lwinmm -lpthread
\ No newline at end of file
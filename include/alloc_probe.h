@@ -0,0 +1,49 @@
+#ifndef ALLOC_PROBE_H
+#define ALLOC_PROBE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "raylib.h"
+
+/*
+ * Heap accounting.
+ * Debug builds link with --wrap=malloc,calloc,realloc,free (see
+ * build_debug.bat and ALLOC_ACCOUNTING), so every heap call made from the
+ * program, raylib and libgcc is counted against the thread that made it. The
+ * render loop brackets each frame with BeginAllocFrame()/EndAllocFrame(); once
+ * ALLOC_WARMUP_FRAMES have gone by, a frame in which a per-frame thread (render,
+ * audio) touched the heap is a steady-state allocation: the F3 overlay counts
+ * them and `--alloc-check` fails on them. Release builds count nothing.
+ */
+
+#define ALLOC_THREADS 16                // Threads counted apart; the rest share "other"
+#define ALLOC_WARMUP_FRAMES 120         // Frames allowed to allocate first (2 s at 60 FPS)
+
+typedef struct
+{
+    const char *name;
+    bool per_frame;                     // Part of the frame path: ingest, analysis, draw
+    int64_t allocations;                // malloc(), calloc() and realloc() calls
+    int64_t frees;                      // free() calls, NULL excluded
+    int64_t bytes;                      // Requested by the allocations
+} AllocCounts;
+
+typedef struct
+{
+    int64_t frames;                     // Since the first BeginAllocFrame()
+    int64_t heap_calls;                 // Per-frame threads, last frame
+    int64_t steady_frames;              // Frames after the warm-up that made heap calls
+    int64_t steady_heap_calls;
+    int64_t last_steady_frame;          // -1 if none
+} AllocFrameStats;
+
+bool IsAllocAccounting(void);           // False when built without ALLOC_ACCOUNTING
+void RegisterAllocThread(const char *name, bool per_frame);    // Cheap to repeat; name must stay valid
+void BeginAllocFrame(void);
+int64_t EndAllocFrame(void);            // Heap calls made by per-frame threads during the frame
+AllocFrameStats GetAllocFrameStats(void);
+int GetAllocThreadCounts(AllocCounts *counts, bool last_frame);    // Up to ALLOC_THREADS + 1, "other" last; returns how many
+void DrawAllocOverlay(int posX, int posY, int fontSize, Color color);
+
+#endif // ALLOC_PROBE_H
@@ -0,0 +1,48 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bump allocator for memory that is all released at once.
+ * Allocations are carved out of blocks taken from the heap and are never
+ * freed one by one: ResetArena() hands everything back in one step and keeps
+ * the blocks for the next round, so an arena reset between jobs of similar
+ * size stops touching the heap after the first few. A round that outgrew the
+ * first block has its blocks merged into one of their combined size at the
+ * next reset. An arena belongs to one thread at a time.
+ */
+
+#define ARENA_ALIGNMENT 16          // Enough for any scalar and SSE loads
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct
+{
+    int64_t allocations;            // Served from the blocks, since InitArena()
+    int64_t heap_blocks;            // Blocks taken from the heap, the first one included
+    size_t used;                    // Bytes handed out since the last reset
+    size_t peak;                    // Most bytes handed out between two resets
+} ArenaStats;
+
+typedef struct
+{
+    ArenaBlock *blocks;             // Current block first
+    size_t block_size;              // Of the next block taken from the heap
+    ArenaStats stats;
+} Arena;
+
+void InitArena(Arena *arena, size_t block_size);    // Nothing is allocated until the first ArenaAlloc()
+void FreeArena(Arena *arena);
+void ResetArena(Arena *arena);                      // Everything allocated so far is gone; the blocks stay
+void *ArenaAlloc(Arena *arena, size_t size);        // ARENA_ALIGNMENT-aligned; NULL when the heap is out
+void *ArenaCalloc(Arena *arena, size_t count, size_t size);
+char *ArenaCopyString(Arena *arena, const char *text);
+
+// From the arena when there is one, else malloc()/calloc()/free(): for code called both ways
+void *ScratchAlloc(Arena *arena, size_t size);
+void *ScratchCalloc(Arena *arena, size_t count, size_t size);
+void ScratchFree(Arena *arena, void *pointer);      // Nothing to do for arena memory
+
+#endif // ARENA_H
@@ -0,0 +1,66 @@
+#ifndef AUDIO_FEEDER_H
+#define AUDIO_FEEDER_H
+
+#include "raylib.h"
+#include "wav_source.h"
+#include "mp3_index.h"
+
+/*
+ * The audio feeder owns the playing Music stream and keeps its buffers
+ * filled from a dedicated thread, so a slow frame on the render loop can
+ * never starve the audio device. The render loop only posts commands.
+ */
+
+#define FEEDER_SUB_BUFFER_FRAMES 4096   // Frames per stream sub-buffer (raylib double-buffers)
+#define FEEDER_WAKE_INTERVAL_MS  5      // Feeder wake-up cadence
+#define FEEDER_QUEUE_SIZE        32     // Pending commands
+#define FEEDER_PRIME_FRAMES      (2 * FEEDER_SUB_BUFFER_FRAMES) // Frames before a seek target handed to the primer
+
+typedef enum
+{
+    FEEDER_CMD_PLAY = 0,    // Take ownership of a stream and start it (replaces the current one)
+    FEEDER_CMD_PAUSE,
+    FEEDER_CMD_RESUME,
+    FEEDER_CMD_SEEK,
+    FEEDER_CMD_STOP,        // Stop and unload the current stream
+    FEEDER_CMD_QUEUE_NEXT,  // Take ownership of the stream that follows the current one and prime it
+    FEEDER_CMD_ADVANCE      // Switch to the queued stream now
+} FeederCommandType;
+
+typedef struct
+{
+    FeederCommandType type;
+    Music music;            // FEEDER_CMD_PLAY, FEEDER_CMD_QUEUE_NEXT
+    const WavSource *wav;   // Same commands for a mapped WAV track (music unused); stays owned by the caller
+    Mp3Index *mp3_index;    // Seek table bound to music, if any; owned by the feeder along with it
+    unsigned int track_id;  // Caller's id for that stream, reported back in FeederStatus
+    float position;         // FEEDER_CMD_SEEK, in seconds
+} FeederCommand;
+
+typedef struct
+{
+    bool has_music;
+    bool playing;
+    bool has_next;          // A primed stream is queued behind the current one
+    unsigned int track_id;  // Id of the stream currently playing
+    float time_played;      // Seconds, as reported by the stream: mixed, not yet heard
+    double time;            // GetTime() when time_played was taken
+    unsigned int refills;   // Sub-buffer refills performed
+    unsigned int underruns; // Refills that arrived after both sub-buffers were drained
+} FeederStatus;
+
+bool StartAudioFeeder(AudioCallback processor, AudioCallback primer);   // primer may be NULL
+void StopAudioFeeder(void);
+void PostFeederCommand(FeederCommand command);
+void FeederPlay(Music music, Mp3Index *mp3_index, unsigned int track_id);
+void FeederQueueNext(Music music, Mp3Index *mp3_index, unsigned int track_id);
+void FeederPlayWav(const WavSource *wav, unsigned int track_id);
+void FeederQueueNextWav(const WavSource *wav, unsigned int track_id);
+void FeederAdvance(void);
+void FeederPause(void);
+void FeederResume(void);
+void FeederSeek(float position);
+void FeederStop(void);
+FeederStatus GetFeederStatus(void);
+
+#endif // AUDIO_FEEDER_H
@@ -0,0 +1,41 @@
+#ifndef ID3V2_H
+#define ID3V2_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "mapped_file.h"
+#include "arena.h"
+
+/*
+ * Minimal ID3v2.3/2.4 reader for the MP3 load path.
+ * Maps only the tag at the start of the file and pulls the title, artist,
+ * album, genre and year frames and the first attached picture, which is
+ * left where it is in the mapping. Tags it doesn't handle (ID3v2.2,
+ * unsynchronised, compressed or encrypted frames, numeric genres it has no
+ * name for, any of those fields missing, files with no ID3v2 tag) make it
+ * return false, for TagLib to read instead.
+ */
+
+#define ID3V2_PROBE_SIZE (64 * 1024)    // Mapped first; a larger tag is mapped again at its own size
+#define ID3V2_MIME_SIZE 32
+
+typedef struct
+{
+    MappedFile file;                // The tag region only
+    unsigned int version;           // 3 or 4
+    char *title;                    // UTF-8, values joined with " / "; from the arena, else free() them
+    char *artist;
+    char *album;
+    char *genre;
+    unsigned int year;
+    const unsigned char *picture;   // First APIC frame's image, inside the mapping; NULL if none
+    size_t picture_size;
+    char picture_mime[ID3V2_MIME_SIZE];
+    Arena *arena;                   // Holds the strings; NULL if they were malloc()ed
+} Id3v2Tag;
+
+bool OpenId3v2Tag(const char *file_path, Id3v2Tag *tag, Arena *arena);     // arena may be NULL
+void CloseId3v2Tag(Id3v2Tag *tag);      // Unmaps the picture too
+
+#endif // ID3V2_H
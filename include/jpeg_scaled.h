@@ -0,0 +1,23 @@
+#ifndef JPEG_SCALED_H
+#define JPEG_SCALED_H
+
+#include "raylib.h"
+
+/*
+ * Reduced-resolution JPEG decoding.
+ * Baseline (Huffman, 8-bit) grayscale, YCbCr or RGB JPEGs are decoded at
+ * 1/8, 1/4, 1/2 or full scale, the smallest whose output still covers the
+ * requested size, with the scaling done inside the IDCT: a 3000x3000 cover
+ * comes out 375x375 without the full-size image ever being built. Anything
+ * else (progressive, arithmetic coded, CMYK, 12-bit, truncated or corrupt
+ * data, a component no scan carries) returns an image that isn't ready, so
+ * the caller can fall back to LoadImageFromMemory().
+ */
+
+#define JPEG_MAX_COMPONENTS 3
+#define JPEG_MAX_PIXELS (1 << 26)       // Output larger than this is left to stb_image
+
+bool IsJpegData(const unsigned char *data, int size);
+Image LoadJpegScaled(const unsigned char *data, int size, int min_width, int min_height);   // Release with UnloadImage()
+
+#endif // JPEG_SCALED_H
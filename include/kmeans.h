@@ -1,9 +1,74 @@
 #ifndef KMEANS_HEADER
 #define KMEANS_HEADER
 
+#include <stdint.h>
+
+#include "raylib.h"
+#include "arena.h"
+
+#define KMEANS_MAX_THREADS 64
+#define KMEANS_MINIBATCH_SIZE 1024          // Default points per mini-batch
+#define KMEANS_MINIBATCH_TOLERANCE 0.5f     // Default stop: no centroid moved further (RGB units) for a few batches in a row
+
+typedef enum
+{
+    KMEANS_LLOYD = 0,       // Every point against every centroid, every iteration
+    KMEANS_HAMERLY,         // Same result; skips points whose distance bounds prove they keep their cluster
+    KMEANS_MINIBATCH,       // Centroids follow random batches of points (Sculley 2010); approximate, single-threaded
+} KMeansAlgorithm;
+
+typedef enum
+{
+    KMEANS_INIT_FARTHEST = 0,   // Each next centroid is the point farthest from those chosen so far
+    KMEANS_INIT_PLUSPLUS,       // k-means++: each next centroid is drawn with probability proportional to D^2
+} KMeansInit;
+
+typedef enum
+{
+    KMEANS_RGB = 0,             // Squared distance between sRGB values
+    KMEANS_OKLAB,               // Squared OKLab distance, closer to perceived difference (see oklab.h)
+} KMeansColorSpace;
+
+typedef struct
+{
+    int iterations;                 // Lloyd passes, or batches for KMEANS_MINIBATCH
+    int64_t distance_evaluations;   // Point-to-centroid distances computed
+    int64_t distances_skipped;      // Of the iterations * points * clusters a plain Lloyd pass computes
+} KMeansStats;
+
+typedef struct
+{
+    int histogram_bits;     // 0 clusters every pixel; 15 or 18 clusters the occupied bins of a 5:5:5 or 6:6:6 RGB histogram
+    bool scalar;            // Skip the SSE2/AVX2 assignment kernels (benchmarks)
+    int threads;            // Assignment threads, calling thread included (0 or 1: single-threaded); same palette for any count
+    KMeansAlgorithm algorithm;
+    KMeansInit init;
+    KMeansColorSpace color_space;
+    uint64_t seed;          // Picks the first centroid (and the k-means++ draws); 0 takes one from GetRandomValue()
+    int batch_size;         // KMEANS_MINIBATCH: points per batch (0: KMEANS_MINIBATCH_SIZE)
+    float tolerance;        // KMEANS_MINIBATCH: centroid movement to stop at (0: KMEANS_MINIBATCH_TOLERANCE)
+    KMeansStats *stats;     // Filled in when not NULL
+    Arena *arena;           // Working memory, released with it; NULL takes it from the heap
+} KMeansOptions;
+
+#define KMEANS_DEFAULT_OPTIONS ((KMeansOptions) { 0 })
+
+// Pixels as separate channel planes, the layout the k-means kernels work on
+typedef struct
+{
+    unsigned char *r;
+    unsigned char *g;
+    unsigned char *b;
+    int count;
+    Arena *arena;           // Holds the planes, or NULL if they were malloc()ed
+} ColorPlanes;
+
 void getDominantColors(int n_points, Color *image_color_data, Color *dominant_colors, int n_cluster);
+void getDominantColorsEx(int n_points, Color *image_color_data, Color *dominant_colors, int n_cluster, KMeansOptions options);
+void getDominantColorsFromPlanes(ColorPlanes planes, Color *dominant_colors, int n_cluster, KMeansOptions options);
+bool LoadColorPlanes(Image image, ColorPlanes *planes, Arena *arena);     // arena may be NULL
+void UnloadColorPlanes(ColorPlanes *planes);
 int distanceSquared(Color *color1, Color *color2);
 void InitializeCentroid(int **centroid, int n_points, Color *image_color_data,int n_cluster);
-void NewCentroid(int *cluster_list, int *centroid, int n_points, Color *image_color_data);
 
 #endif // KMEANS_HEADER
@@ -0,0 +1,55 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include "raylib.h"
+
+/*
+ * Audio-to-photon latency instrumentation.
+ * The render loop stamps each stage of a frame; intervals are kept for the
+ * last LATENCY_HISTORY frames and reported as percentiles in an overlay and
+ * in the log. A self-test plays a click track through the whole pipeline and
+ * measures how long the bars take to react to each click.
+ */
+
+#define LATENCY_HISTORY 600             // Frames kept for percentiles (10 s at 60 FPS)
+#define LATENCY_LOG_INTERVAL 5.0        // Seconds between log reports, while reporting is on
+#define LATENCY_SELFTEST_SAMPLE_RATE 44100
+#define LATENCY_SELFTEST_CLICKS 16
+
+typedef enum
+{
+    LATENCY_STAGE_SAMPLE_ARRIVAL = 0,   // Newest block reached ProcessAudioStreamCallback
+    LATENCY_STAGE_ANALYSIS_START,
+    LATENCY_STAGE_ANALYSIS_END,
+    LATENCY_STAGE_DRAW_START,           // BeginDrawing() returned
+    LATENCY_STAGE_DRAW_END,             // Everything but the overlays queued, before EndDrawing()
+    LATENCY_STAGE_FRAME_SWAP,           // EndDrawing() returned
+    LATENCY_STAGE_AUDIO_OUTPUT,         // Estimated time the analyzed window is heard
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+typedef enum
+{
+    LATENCY_ARRIVAL_TO_ANALYSIS = 0,    // Waiting for the render loop
+    LATENCY_ANALYSIS,                   // Windowing, FFT and band extraction
+    LATENCY_ANALYSIS_TO_SWAP,           // Drawing and presenting
+    LATENCY_ARRIVAL_TO_SWAP,            // Audio in, photons out
+    LATENCY_SWAP_TO_OUTPUT,             // Picture vs. sound: positive means the bars trail the audio
+    LATENCY_DRAW,                       // CPU time spent queuing the frame's draws
+    LATENCY_INTERVAL_COUNT
+} LatencyInterval;
+
+void SetLatencyReporting(bool enabled);
+bool IsLatencyReporting(void);
+void BeginLatencyFrame(void);
+void MarkLatencyStage(LatencyStage stage, double time);
+void EndLatencyFrame(void);
+float GetLatencyPercentile(LatencyInterval interval, float percentile);
+void DrawLatencyOverlay(int posX, int posY, int fontSize, Color color);
+
+bool StartLatencySelfTest(AudioCallback processor);
+bool IsLatencySelfTestRunning(void);
+bool UpdateLatencySelfTest(float band_level, double swap_time, double output_latency);
+void StopLatencySelfTest(void);
+
+#endif // LATENCY_PROBE_H
@@ -0,0 +1,84 @@
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "raylib.h"
+#include "mapped_file.h"
+#include "palette.h"
+#include "track_loader.h"
+
+/*
+ * Music library index.
+ * A scan walks a directory tree for the files the track loader plays, reads
+ * the tags, duration, cover hash and palette of each on a pool of worker
+ * threads and writes them to one file: fixed-size entries sorted by path,
+ * then a pool of the (deduplicated) strings they point to. Opening the index
+ * only maps it, so the whole library is listed without reading a track; a
+ * rescan reads again only the files whose size or modification time
+ * changed. Scans go through the track loader's tag and cover code, so they
+ * need it started.
+ */
+
+#define LIBRARY_INDEX_FILE "library.idx"
+#define LIBRARY_INDEX_VERSION 1
+#define LIBRARY_INDEX_WORKERS 4
+#define LIBRARY_EXTENSIONS ".mp3;.wav"      // What drag & drop takes
+#define LIBRARY_STRINGS_SIZE (64 * 1024)    // Blocks of each scan worker's tag arena
+
+#define LIBRARY_ENTRY_UNREADABLE 0x1        // No tags could be read: listed by path only
+
+typedef struct
+{
+    uint32_t path;                  // Offsets into the string pool
+    uint32_t title;
+    uint32_t artist;
+    uint32_t album;
+    uint32_t genre;
+    uint32_t year;
+    int64_t mtime;                  // Seconds since the epoch; with size, tells a rescan whether to read the file again
+    uint64_t size;
+    uint64_t cover_key;             // Palette cache key of the embedded picture, 0 for the default cover
+    float duration;                 // Seconds, 0 if unknown
+    Color palette[PALETTE_SIZE];    // Extracted with the backend the index was built with
+    uint32_t flags;
+} LibraryEntry;
+
+typedef struct
+{
+    MappedFile file;
+    const LibraryEntry *entries;    // Sorted by path, inside the mapping
+    int count;
+    const char *strings;
+    uint32_t strings_size;
+    PaletteBackend backend;
+} LibraryIndex;
+
+typedef struct
+{
+    int files;                      // Found under the root
+    int reused;                     // Unchanged since the last scan
+    int read;                       // New or changed
+    int unreadable;
+    int64_t arena_allocations;      // Tags and working memory of the files read
+    int64_t heap_allocations;       // Blocks the arenas took from the heap for them
+    double seconds;
+} LibraryScanStats;
+
+bool OpenLibraryIndex(const char *index_path, LibraryIndex *index);
+void CloseLibraryIndex(LibraryIndex *index);
+const char *GetLibraryString(const LibraryIndex *index, uint32_t offset);
+int FindLibraryEntry(const LibraryIndex *index, const char *path);         // -1 if not listed
+
+bool ScanLibrary(const char *root, const char *index_path, LibraryScanStats *stats);   // Writes the new index next to index_path
+bool ReplaceLibraryIndex(const char *index_path);   // Moves it over index_path; neither may be mapped (Windows)
+
+// The same scan on a background thread; PollLibraryScan() returns true once, when it has finished.
+bool StartLibraryScan(const char *root, const char *index_path);
+bool PollLibraryScan(LibraryScanStats *stats);
+void StopLibraryScan(void);
+
+int IndexLibraryOffline(const char *root);          // SonicSpectra --index-library <dir>
+
+#endif // LIBRARY_INDEX_H
@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Read-only memory-mapped file (CreateFileMapping on Windows, mmap elsewhere).
+ * Kept free of raylib.h on purpose: windows.h and raylib.h cannot share a
+ * translation unit.
+ */
+
+typedef enum
+{
+    MAPPED_FILE_NORMAL = 0,
+    MAPPED_FILE_SEQUENTIAL,     // Read ahead aggressively, pages behind can be dropped
+    MAPPED_FILE_RANDOM,         // No read-ahead
+    MAPPED_FILE_WILLNEED        // Start paging the range in now
+} MappedFileAdvice;
+
+typedef struct
+{
+    const unsigned char *data;
+    size_t size;                // Bytes mapped
+    uint64_t file_size;         // Size of the whole file
+    void *handle;               // Platform handles
+    void *mapping;
+} MappedFile;
+
+bool OpenMappedFile(const char *file_path, MappedFile *file);
+bool OpenMappedFileRange(const char *file_path, size_t length, MappedFile *file);
+void AdviseMappedFile(const MappedFile *file, size_t offset, size_t length, MappedFileAdvice advice);
+void CloseMappedFile(MappedFile *file);
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,48 @@
+#ifndef MP3_INDEX_H
+#define MP3_INDEX_H
+
+#include <stdint.h>
+
+#include "raylib.h"
+
+/*
+ * MP3 seek index.
+ * Built by scanning the frame headers of a file (no decoding), so that
+ * SeekMusicStream() can jump straight to a nearby frame instead of decoding
+ * from the start of the stream.
+ */
+
+#define MP3_INDEX_FRAME_STRIDE 16       // One seek point every 16 MP3 frames (~0.4 s at 44.1 kHz)
+#define MP3_INDEX_LEADING_FRAMES 2      // Frames decoded before a seek point to refill the bit reservoir
+
+typedef struct
+{
+    // Same layout as dr_mp3's drmp3_seek_point, which raylib decodes MP3 with.
+    uint64_t byte_offset;               // Of the first frame to decode
+    uint64_t pcm_frame;                 // PCM frame the point lands on
+    uint16_t mp3_frames_to_discard;
+    uint16_t pcm_frames_to_discard;
+} Mp3SeekPoint;
+
+typedef struct
+{
+    Mp3SeekPoint *points;
+    unsigned int count;
+    uint64_t frame_count;               // MP3 frames found by the scan
+    uint64_t pcm_frame_count;           // PCM frames they decode to
+    unsigned int sample_rate;
+    uint32_t tag_frame_count;           // Frame count stored in a Xing/Info or VBRI header, 0 if none
+    bool has_xing;
+    bool has_vbri;
+    bool complete;                      // The scan reached the end of the file without losing sync
+} Mp3Index;
+
+bool BuildMp3Index(const char *file_path, Mp3Index *index);
+bool BindMp3Index(Music music, Mp3Index *index);
+void UnloadMp3Index(Mp3Index *index);
+bool IsMp3Music(Music music);                                   // Decoded by dr_mp3, so the calls below apply
+bool SeekMp3Frame(Music music, uint64_t frame);                 // Moves the decoder only, not the stream
+unsigned int ReadMp3Frames(Music music, float *frames, unsigned int frame_count);   // Interleaved float, from the decoder's position
+float EstimateMp3Duration(const char *file_path);   // Seconds, from the first frame only
+
+#endif // MP3_INDEX_H
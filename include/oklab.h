@@ -0,0 +1,21 @@
+#ifndef OKLAB_H
+#define OKLAB_H
+
+#include "raylib.h"
+#include "kmeans.h"
+
+/*
+ * OKLab (Ottosson, 2020) in 8-bit planes: L, a and b are all scaled by
+ * OKLAB_SCALE, a and b offset by OKLAB_OFFSET, so squared differences of the
+ * bytes are squared OKLab distances (times OKLAB_SCALE^2) and the k-means
+ * kernels cluster them unchanged.
+ */
+
+#define OKLAB_SCALE 255.0f
+#define OKLAB_OFFSET 128                // a and b of sRGB colors stay within [-0.32, 0.28]
+#define OKLAB_GRID_BITS 5               // 3D LUT nodes every 2^(8 - OKLAB_GRID_BITS) sRGB levels
+
+bool LoadOklabPlanes(const ColorPlanes *rgb, ColorPlanes *oklab, Arena *arena);    // Release with UnloadColorPlanes()
+Color OklabToColor(int L, int a, int b);                                          // 8-bit planes' coordinates back to sRGB, clamped
+
+#endif // OKLAB_H
@@ -0,0 +1,37 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include "raylib.h"
+#include "kmeans.h"
+
+/*
+ * Palette extraction with interchangeable backends.
+ * k-means iterates until it converges, so its cost varies from cover to
+ * cover; the octree and median-cut quantizers make one pass over the pixels
+ * plus a fixed amount of work on a bounded summary of them. Their colors
+ * come out in the order farthest-point initialization gives k-means, from
+ * the most common one: each next color is the farthest from those before it
+ * (background, spectrum, text, border).
+ */
+
+#define PALETTE_HISTOGRAM_BITS 15      // k-means clusters over a 5:5:5 histogram of the decoded cover
+#define PALETTE_SEED 0x5EC7A11ull      // Fixed, so a cover always gets the same palette
+#define OCTREE_MAX_LEAVES 64            // Colors the octree keeps before the final merge
+#define OCTREE_DEPTH 5                  // Levels below the root, one per bit of the 5:5:5 histogram
+
+typedef enum
+{
+    PALETTE_BACKEND_KMEANS = 0,
+    PALETTE_BACKEND_KMEANS_OKLAB,       // Same, clustered in OKLab
+    PALETTE_BACKEND_OCTREE,
+    PALETTE_BACKEND_MEDIAN_CUT,
+    PALETTE_BACKEND_COUNT
+} PaletteBackend;
+
+void QuantizePalette(PaletteBackend backend, ColorPlanes planes, Color *palette, int n_colors, Arena *arena);  // Working memory from arena, or the heap when NULL
+void SetPaletteBackend(PaletteBackend backend);     // For every palette extracted from now on
+PaletteBackend GetPaletteBackend(void);
+const char *GetPaletteBackendName(PaletteBackend backend);
+bool FindPaletteBackend(const char *name, PaletteBackend *backend);
+
+#endif // PALETTE_H
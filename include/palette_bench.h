@@ -0,0 +1,19 @@
+#ifndef PALETTE_BENCH_H
+#define PALETTE_BENCH_H
+
+/*
+ * Palette extraction benchmark: SonicSpectra --bench-palette cover.jpg [more.jpg ...]
+ * Times every k-means variant on each image and checks that the faster ones
+ * stay within PALETTE_TOLERANCE of the per-pixel reference, then sums them up
+ * over the whole set.
+ */
+
+#define PALETTE_BENCH_RUNS 5            // Best of
+#define PALETTE_BENCH_SEED 1234
+#define PALETTE_TOLERANCE 16.0f         // RGB distance from a color to the nearest reference color
+#define PALETTE_ERROR_TOLERANCE 0.05    // Extra squared error over the reference palette's, for approximate variants
+#define PALETTE_COST_BUDGET 1.5         // OKLab conversion plus clustering, against the same clustering in RGB
+
+int RunPaletteBenchmark(int n_images, const char **image_paths);
+
+#endif // PALETTE_BENCH_H
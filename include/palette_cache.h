@@ -0,0 +1,29 @@
+#ifndef PALETTE_CACHE_H
+#define PALETTE_CACHE_H
+
+#include <stdint.h>
+
+#include "raylib.h"
+#include "palette.h"
+#include "track_loader.h"
+
+/*
+ * On-disk palette cache, keyed by a hash of the embedded picture's encoded
+ * bytes (the default cover is kept in memory by the track loader). Each entry
+ * keeps the palette of every backend it was extracted with and the
+ * ALBUM_COVER_SIZE thumbnail, so a hit skips the cover decode, the palette extraction and the resize.
+ * Safe to call from the track loader workers.
+ */
+
+#define PALETTE_CACHE_DIRECTORY "palette_cache"
+#define PALETTE_CACHE_SLOTS 1024        // Direct-mapped; a new cover evicts the one in its slot
+#define PALETTE_CACHE_VERSION 2         // Bump whenever a backend's palettes change
+
+bool OpenPaletteCache(const char *directory);
+void ClosePaletteCache(void);
+uint64_t HashCoverData(const unsigned char *data, int size);
+bool LoadCachedCover(uint64_t key, PaletteBackend backend, Color *palette, Image *thumbnail);
+bool LoadCachedPalette(uint64_t key, PaletteBackend backend, Color *palette);     // Without reading the thumbnail
+void StoreCachedCover(uint64_t key, PaletteBackend backend, const Color *palette, Image thumbnail);
+
+#endif // PALETTE_CACHE_H
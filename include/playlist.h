@@ -0,0 +1,26 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <stdbool.h>
+
+/*
+ * Play queue of file paths. Dropped files are appended; playback wraps
+ * around to the first item after the last one. Items the track loader
+ * couldn't open are marked failed and skipped from then on.
+ */
+
+typedef struct
+{
+    char **paths;
+    bool *failed;
+    int count;
+    int capacity;
+} Playlist;
+
+int AddToPlaylist(Playlist *playlist, const char *file_path);
+const char *GetPlaylistPath(const Playlist *playlist, int index);
+int GetNextPlaylistIndex(const Playlist *playlist, int index);
+void MarkPlaylistItemFailed(Playlist *playlist, int index);
+void UnloadPlaylist(Playlist *playlist);
+
+#endif // PLAYLIST_H
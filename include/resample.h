@@ -0,0 +1,35 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stdbool.h>
+
+#include "raylib.h"
+
+/*
+ * Separable image resampling for 8-bit images (grayscale, gray-alpha, RGB,
+ * RGBA): a horizontal then a vertical pass of precomputed fixed-point filter
+ * weights, SIMD on x86, in bands of output rows spread over threads. The
+ * result is the same for any thread count and with or without SIMD.
+ */
+
+#define RESAMPLE_MAX_THREADS 16
+
+typedef enum
+{
+    RESAMPLE_BOX = 0,           // Area average when shrinking
+    RESAMPLE_BICUBIC,           // Keys cubic, a = -0.5
+    RESAMPLE_LANCZOS3,          // Sharpest; rings a little on hard edges
+} ResampleFilter;
+
+typedef struct
+{
+    ResampleFilter filter;
+    int threads;                // Bands resampled at once, calling thread included (0 or 1: single-threaded)
+    bool scalar;                // Skip the SSE2/AVX2 kernels (benchmarks)
+} ResampleOptions;
+
+// Replaces the image's data with a width x height resampled copy, as ImageResize() does; false (image untouched) for other formats.
+bool ResampleImage(Image *image, int width, int height, ResampleOptions options);
+const char *GetResampleFilterName(ResampleFilter filter);
+
+#endif // RESAMPLE_H
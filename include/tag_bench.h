@@ -0,0 +1,21 @@
+#ifndef TAG_BENCH_H
+#define TAG_BENCH_H
+
+/*
+ * Tag reading benchmark: SonicSpectra --bench-tags library/ [more.mp3 ...]
+ * Reads the tags and cover of every MP3 (directories are searched
+ * recursively) with TagLib and with the ID3v2 reader, reports the time per
+ * file and checks that the two agree on every file the reader takes.
+ *
+ * Tag reader check: SonicSpectra --check-tags tests/tags
+ * The same comparison over fixtures, which must also be read by the reader
+ * (under id3v2/) or left to TagLib (under taglib/).
+ */
+
+#define TAG_BENCH_RUNS 3                // Best of, after one pass to warm the page cache
+#define TAG_BENCH_REPORTED 10           // Mismatching files listed by name
+
+int RunTagBenchmark(int n_paths, const char **paths);
+int RunTagCheck(const char *fixtures);
+
+#endif // TAG_BENCH_H
@@ -0,0 +1,96 @@
+#ifndef TRACK_LOADER_H
+#define TRACK_LOADER_H
+
+#include <stdint.h>
+
+#include "raylib.h"
+#include "arena.h"
+#include "wav_source.h"
+#include "mp3_index.h"
+#include "id3v2.h"
+#include "palette.h"
+#include "resample.h"
+
+/*
+ * Asynchronous track loading.
+ * Stream opening, tag parsing, cover decoding/resizing and palette extraction
+ * run on worker threads; finished tracks are published to a completion queue
+ * that the render thread drains with PollLoadedTrack(). Only the GPU texture
+ * upload is left to the render thread.
+ *
+ * A track's strings live in its own arena, recycled once the render thread
+ * hands it back; each worker decodes and extracts palettes in a scratch
+ * arena reset after every job. Past the first few loads, neither takes
+ * anything from the heap (see GetTrackLoaderStats()).
+ */
+
+#define ALBUM_COVER_SIZE 200
+#define PALETTE_SIZE 4
+#define TRACK_LOADER_WORKERS 2
+#define COVER_RESAMPLE_THREADS 4        // Bands per cover resize; covers decoded near ALBUM_COVER_SIZE stay on the worker's thread
+#define COVER_RESAMPLE_OPTIONS ((ResampleOptions){ RESAMPLE_BICUBIC, COVER_RESAMPLE_THREADS, false })
+#define TRACK_ARENA_SIZE (4 * 1024)            // Path and tags; longer ones take another block
+#define TRACK_ARENA_SPARES 4                    // Track arenas kept for reuse: current, next, and loads in flight
+#define TRACK_SCRATCH_SIZE (1024 * 1024)        // First block of each worker's scratch arena; grows to the largest load seen
+
+typedef struct
+{
+    /* data */
+    char *title;                    // In the arena they were read into
+    char *artist;
+    char *album;
+    char *genre;
+    unsigned int year;
+} MusicInfo;
+
+typedef struct
+{
+    const unsigned char *data;      // Encoded picture, borrowed: valid until UnloadCoverPicture()
+    int size;
+    const char *file_type;          // Decoder, as the extension LoadImageFromMemory() takes; NULL if none fits
+    void *properties;               // TagLib_Complex_Property_Attribute ***, owns data when TagLib read it
+    Id3v2Tag id3;                   // Or the mapped ID3v2 tag it points into
+} CoverPicture;
+
+typedef struct
+{
+    unsigned int id;                // Id returned by RequestTrackLoad()
+    Arena *arena;                   // Holds file_path and the music_info strings; ReleaseTrackArena() when done with both
+    char *file_path;
+    bool ok;                        // False if the music stream could not be opened
+    Music music;                    // Compressed files, decoded by raylib
+    WavSource *wav;                 // .wav files, mapped instead (music unused)
+    Mp3Index *mp3_index;            // .mp3 files: seek table bound to music, NULL if none could be built
+    unsigned int sample_rate;
+    unsigned int sample_size;       // Bits per sample
+    float durations;
+    MusicInfo music_info;
+    Image album_cover;              // ALBUM_COVER_SIZE x ALBUM_COVER_SIZE, still in RAM
+    Color palette[PALETTE_SIZE];    // Background, spectrum, text, box border
+} LoadedTrack;
+
+typedef struct
+{
+    int64_t loads;                  // Jobs finished
+    int64_t arena_allocations;      // Strings and working memory handed out by the arenas
+    int64_t heap_allocations;       // Arena blocks, arenas and jobs that had to come from the heap
+    size_t scratch_peak;            // Most working memory one load took
+} TrackLoaderStats;
+
+bool StartTrackLoader(void);
+void StopTrackLoader(void);
+unsigned int RequestTrackLoad(const char *file_path);
+bool PollLoadedTrack(LoadedTrack *track);
+void UnloadLoadedTrack(LoadedTrack *track);
+void ReleaseTrackArena(Arena *arena);           // Also after StopTrackLoader()
+TrackLoaderStats GetTrackLoaderStats(void);
+
+// Between StartTrackLoader() and StopTrackLoader(), from any thread (the library indexer uses them too)
+void ReadTrackTags(const char *music_file_path, MusicInfo *music_info, CoverPicture *cover, Arena *arena);   // Strings in arena; release cover with UnloadCoverPicture()
+uint64_t LoadTrackCover(const CoverPicture *cover, PaletteBackend backend, Color *palette, Image *album_cover, Arena *scratch);
+void InitializeMusicInfo(const char *music_file_path, MusicInfo *music_info, CoverPicture *cover, Arena *arena);
+void UnloadCoverPicture(CoverPicture *cover);
+void ExtractPalette(Image album_cover, PaletteBackend backend, Color *palette, Arena *scratch);     // scratch may be NULL
+bool HasFileExtension(const char *file_path, const char *extensions);   // IsFileExtension() without raylib's static buffers
+
+#endif // TRACK_LOADER_H
@@ -0,0 +1,44 @@
+#ifndef WAV_SOURCE_H
+#define WAV_SOURCE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mapped_file.h"
+
+/*
+ * Uncompressed WAV (RIFF or RF64) read straight out of a memory mapping.
+ * Samples are converted on the fly by whoever reads them; there is no
+ * intermediate decode buffer.
+ */
+
+#define WAV_READ_AHEAD_FRAMES (1 << 17)     // Paged in ahead of a reader, about 3 s at 44.1 kHz
+
+typedef struct
+{
+    MappedFile file;
+    const unsigned char *frames;    // First frame of the data chunk, inside the mapping
+    uint64_t frame_count;
+    size_t frame_size;              // Bytes per frame (all channels)
+    unsigned int sample_rate;
+    unsigned int channels;
+    unsigned int bits_per_sample;   // 8, 16, 24 or 32
+    bool is_float;                  // 32-bit IEEE float instead of integer PCM
+} WavSource;
+
+typedef struct
+{
+    uint64_t start;                 // Frames already advised, start included, end excluded
+    uint64_t end;
+} WavReadAhead;
+
+bool OpenWavSource(const char *file_path, WavSource *source);
+void CloseWavSource(WavSource *source);
+float GetWavSample(const WavSource *source, uint64_t frame, unsigned int channel);
+const void *GetWavFrames(const WavSource *source, uint64_t frame);
+size_t ConvertWavFrames(const WavSource *source, uint64_t frame, size_t frame_count, float *output);
+void PrefetchWavFrames(const WavSource *source, uint64_t frame, uint64_t frame_count, bool sequential);
+void UpdateWavReadAhead(const WavSource *source, WavReadAhead *window, uint64_t frame);   // Call as the reader moves; zero-initialize first
+
+#endif // WAV_SOURCE_H
@@ -0,0 +1,260 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L     // pthread_self
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "raylib.h"
+#include "alloc_probe.h"
+
+/*
+ * Heap accounting.
+ * -----------------------------------------------------------
+ * With -Wl,--wrap=malloc the linker sends every call to malloc() made from
+ * a statically linked object (ours, libraylib.a, libgcc) to __wrap_malloc(),
+ * and the real one stays reachable as __real_malloc(); the same goes for
+ * calloc, realloc and free. Calls made inside DLLs (the C runtime's own
+ * strdup(), TagLib) are not seen.
+ *
+ * The wrappers run on every thread and before main(), so they only touch
+ * zero-initialized statics and atomics: no locks, no thread-local storage
+ * (mingw emulates it with malloc()) and no logging. A thread is found by its
+ * id among the registered ones, the first ALLOC_THREADS to register; any
+ * other thread counts as "other". Totals only ever grow: a frame's counts
+ * are the difference between two snapshots taken by the render thread.
+ * -----------------------------------------------------------
+ */
+
+#if defined(_WIN32)
+// windows.h and raylib.h cannot share a translation unit
+__declspec(dllimport) unsigned long __stdcall GetCurrentThreadId(void);
+#endif
+
+typedef struct
+{
+    _Atomic uintptr_t thread;       // 0 until registered
+    const char *name;               // Written before thread
+    bool per_frame;
+    _Atomic int64_t allocations;
+    _Atomic int64_t frees;
+    _Atomic int64_t bytes;
+} ThreadSlot;
+
+static ThreadSlot slots[ALLOC_THREADS + 1] = { [ALLOC_THREADS] = { .name = "other" } };
+static _Atomic int n_slots;
+
+static struct
+{
+    AllocCounts start[ALLOC_THREADS + 1];   // By slot, unregistered ones zero
+    AllocCounts last[ALLOC_THREADS + 1];    // Made during the last frame
+    AllocFrameStats stats;
+} frame = { .stats.last_steady_frame = -1 };
+
+static uintptr_t CurrentThread(void);
+static ThreadSlot *FindSlot(uintptr_t thread);
+static void ReadSlots(AllocCounts *counts);
+static int CompactCounts(const AllocCounts *counts, AllocCounts *used);
+
+#if defined(ALLOC_ACCOUNTING)
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+
+static void CountAllocation(size_t size)
+{
+    ThreadSlot *slot = FindSlot(CurrentThread());
+    atomic_fetch_add_explicit(&slot->allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&slot->bytes, (int64_t)size, memory_order_relaxed);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    CountAllocation(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    CountAllocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+    CountAllocation(size);
+    return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void *pointer)
+{
+    if (pointer != NULL) atomic_fetch_add_explicit(&FindSlot(CurrentThread())->frees, 1, memory_order_relaxed);
+    __real_free(pointer);
+}
+
+#endif // ALLOC_ACCOUNTING
+
+bool IsAllocAccounting(void)
+{
+#if defined(ALLOC_ACCOUNTING)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void RegisterAllocThread(const char *name, bool per_frame)
+{
+    if (!IsAllocAccounting()) return;
+
+    uintptr_t thread = CurrentThread();
+    if (FindSlot(thread) != &slots[ALLOC_THREADS]) return;   // Already counted apart
+
+    int slot = atomic_load_explicit(&n_slots, memory_order_relaxed);
+    do
+    {
+        if (slot >= ALLOC_THREADS) return;
+    } while (!atomic_compare_exchange_weak_explicit(&n_slots, &slot, slot + 1, memory_order_relaxed, memory_order_relaxed));
+
+    slots[slot].name = name;
+    slots[slot].per_frame = per_frame;
+    atomic_store_explicit(&slots[slot].thread, thread, memory_order_release);
+}
+
+void BeginAllocFrame(void)
+{
+    ReadSlots(frame.start);
+}
+
+int64_t EndAllocFrame(void)
+{
+    AllocCounts now[ALLOC_THREADS + 1];
+    ReadSlots(now);
+
+    int64_t heap_calls = 0;
+    for (int i = 0; i <= ALLOC_THREADS; i++)
+    {
+        frame.last[i] = now[i];
+        frame.last[i].allocations -= frame.start[i].allocations;
+        frame.last[i].frees -= frame.start[i].frees;
+        frame.last[i].bytes -= frame.start[i].bytes;
+        if (now[i].per_frame) heap_calls += frame.last[i].allocations + frame.last[i].frees;
+    }
+
+    AllocFrameStats *stats = &frame.stats;
+    stats->heap_calls = heap_calls;
+    if (stats->frames >= ALLOC_WARMUP_FRAMES && heap_calls > 0)
+    {
+        stats->steady_frames++;
+        stats->steady_heap_calls += heap_calls;
+        stats->last_steady_frame = stats->frames;
+    }
+    stats->frames++;
+
+    return heap_calls;
+}
+
+AllocFrameStats GetAllocFrameStats(void)
+{
+    return frame.stats;
+}
+
+int GetAllocThreadCounts(AllocCounts *counts, bool last_frame)
+{
+    if (last_frame) return CompactCounts(frame.last, counts);
+
+    AllocCounts totals[ALLOC_THREADS + 1];
+    ReadSlots(totals);
+    return CompactCounts(totals, counts);
+}
+
+void DrawAllocOverlay(int posX, int posY, int fontSize, Color color)
+{
+    int line_height = fontSize + 2;
+    if (!IsAllocAccounting())
+    {
+        DrawRectangle(posX - 4, posY - 4, 20 * fontSize, line_height + 8, Fade(BLACK, 0.6f));
+        DrawText("heap calls not counted (build_debug.bat)", posX, posY, fontSize, color);
+        return;
+    }
+
+    AllocCounts totals[ALLOC_THREADS + 1];
+    ReadSlots(totals);
+    int count = 0;
+    for (int i = 0; i <= ALLOC_THREADS; i++) count += (totals[i].name != NULL);
+    AllocFrameStats stats = frame.stats;
+
+    DrawRectangle(posX - 4, posY - 4, 20 * fontSize, (count + 2) * line_height + 8, Fade(BLACK, 0.6f));
+    DrawText("heap calls        frame     total      KB", posX, posY, fontSize, color);
+    int line = 1;
+    for (int i = 0; i <= ALLOC_THREADS; i++)
+    {
+        if (totals[i].name == NULL) continue;
+
+        // Slots line up with the last frame's; one registered since then made no calls in it.
+        const AllocCounts *last = &frame.last[i];
+        DrawText(TextFormat("%-12s%c %9lld %9lld %7lld", totals[i].name, totals[i].per_frame ? '*' : ' ', (long long)(last->allocations + last->frees),
+                            (long long)(totals[i].allocations + totals[i].frees), (long long)(totals[i].bytes / 1024)),
+                 posX, posY + line++ * line_height, fontSize, color);
+    }
+    DrawText(TextFormat("* after warm-up: %lld frames, %lld calls", (long long)stats.steady_frames, (long long)stats.steady_heap_calls),
+             posX, posY + line * line_height, fontSize, color);
+}
+
+static uintptr_t CurrentThread(void)
+{
+#if defined(_WIN32)
+    return GetCurrentThreadId();
+#else
+    return (uintptr_t)pthread_self();
+#endif
+}
+
+static ThreadSlot *FindSlot(uintptr_t thread)
+{
+    int count = atomic_load_explicit(&n_slots, memory_order_relaxed);
+    for (int i = 0; i < count; i++)
+    {
+        if (atomic_load_explicit(&slots[i].thread, memory_order_relaxed) == thread) return &slots[i];
+    }
+    return &slots[ALLOC_THREADS];
+}
+
+/* Totals of every slot, in slot order; the ones not registered yet read as zero. */
+static void ReadSlots(AllocCounts *counts)
+{
+    for (int i = 0; i <= ALLOC_THREADS; i++)
+    {
+        ThreadSlot *slot = &slots[i];
+        if (i < ALLOC_THREADS && atomic_load_explicit(&slot->thread, memory_order_acquire) == 0)
+        {
+            counts[i] = (AllocCounts) { 0 };
+            continue;
+        }
+
+        counts[i] = (AllocCounts) {
+            slot->name,
+            slot->per_frame,
+            atomic_load_explicit(&slot->allocations, memory_order_relaxed),
+            atomic_load_explicit(&slot->frees, memory_order_relaxed),
+            atomic_load_explicit(&slot->bytes, memory_order_relaxed),
+        };
+    }
+}
+
+/* The registered slots, then "other"; returns how many. */
+static int CompactCounts(const AllocCounts *counts, AllocCounts *used)
+{
+    int n_used = 0;
+    for (int i = 0; i <= ALLOC_THREADS; i++)
+    {
+        if (counts[i].name != NULL) used[n_used++] = counts[i];
+    }
+    return n_used;
+}
@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/*
+ * Arenas.
+ * -----------------------------------------------------------
+ * Each block is one heap allocation: this header, then block->size bytes.
+ * Only the first block is allocated from; when a request doesn't fit what
+ * is left of it, a new block of at least block_size goes in front and the
+ * rest of the old one stays unused until the reset.
+ * -----------------------------------------------------------
+ */
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t size;                    // Bytes after the header
+    size_t used;
+};
+
+static unsigned char *BlockData(ArenaBlock *block)
+{
+    return (unsigned char *)(block + 1);
+}
+
+void InitArena(Arena *arena, size_t block_size)
+{
+    memset(arena, 0, sizeof(Arena));
+    arena->block_size = block_size;
+}
+
+void FreeArena(Arena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->stats.used = 0;
+}
+
+void ResetArena(Arena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+    if (block != NULL && block->next != NULL)
+    {
+        // Outgrown: the next round gets one block as large as all of these.
+        size_t total = 0;
+        for (; block != NULL; block = block->next) total += block->size;
+        FreeArena(arena);
+        if (total > arena->block_size) arena->block_size = total;
+    }
+    else if (block != NULL) block->used = 0;
+
+    arena->stats.used = 0;
+}
+
+void *ArenaAlloc(Arena *arena, size_t size)
+{
+    if (size == 0) size = 1;
+    if (size > SIZE_MAX / 2) return NULL;
+
+    ArenaBlock *block = arena->blocks;
+    size_t offset = 0;
+    if (block != NULL)
+    {
+        uintptr_t base = (uintptr_t)BlockData(block);
+        offset = ((base + block->used + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1)) - base;
+    }
+
+    if (block == NULL || offset > block->size || size > block->size - offset)
+    {
+        size_t block_size = (size + ARENA_ALIGNMENT > arena->block_size) ? size + ARENA_ALIGNMENT : arena->block_size;
+        block = malloc(sizeof(ArenaBlock) + block_size);
+        if (block == NULL) return NULL;
+
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = 0;
+        arena->blocks = block;
+        arena->stats.heap_blocks++;
+
+        uintptr_t base = (uintptr_t)BlockData(block);
+        offset = ((base + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1)) - base;
+    }
+
+    block->used = offset + size;
+    arena->stats.allocations++;
+    arena->stats.used += size;
+    if (arena->stats.used > arena->stats.peak) arena->stats.peak = arena->stats.used;
+
+    return BlockData(block) + offset;
+}
+
+void *ArenaCalloc(Arena *arena, size_t count, size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+
+    void *pointer = ArenaAlloc(arena, count * size);
+    if (pointer != NULL) memset(pointer, 0, count * size);
+    return pointer;
+}
+
+char *ArenaCopyString(Arena *arena, const char *text)
+{
+    size_t length = strlen(text);
+    char *copy = ArenaAlloc(arena, length + 1);
+    if (copy != NULL) memcpy(copy, text, length + 1);
+    return copy;
+}
+
+void *ScratchAlloc(Arena *arena, size_t size)
+{
+    return (arena != NULL) ? ArenaAlloc(arena, size) : malloc(size);
+}
+
+void *ScratchCalloc(Arena *arena, size_t count, size_t size)
+{
+    return (arena != NULL) ? ArenaCalloc(arena, count, size) : calloc(count, size);
+}
+
+void ScratchFree(Arena *arena, void *pointer)
+{
+    if (arena == NULL) free(pointer);
+}
@@ -0,0 +1,653 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L     // clock_gettime, pthread_cond_timedwait
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "raylib.h"
+#include "wav_source.h"
+#include "audio_feeder.h"
+#include "alloc_probe.h"
+
+/*
+ * Audio feeder thread.
+ * -----------------------------------------------------------
+ * raylib streams music through two sub-buffers: while the device drains one,
+ * the other has to be refilled by UpdateMusicStream(). Calling it from the
+ * 60 FPS render loop means any long frame (track load, shader compile, window
+ * drag) can drain both sub-buffers and the device plays silence.
+ *
+ * Here the stream is owned by a thread that wakes every FEEDER_WAKE_INTERVAL_MS
+ * (or as soon as a command arrives), applies queued play/pause/seek/stop
+ * commands and refills the stream. Nothing on the render thread touches the
+ * stream after handing it over with FeederPlay().
+ *
+ * For playlists a second stream can be queued behind the current one. It is
+ * primed right away (both sub-buffers decoded while it is still stopped) and
+ * the feeder wakes exactly at the end of the current stream to start it, so
+ * no decoding or file access happens at the boundary. While a track is queued
+ * the current one stops looping: its last sub-buffer is padded with silence,
+ * so a late wake-up delays the next track instead of replaying the start of
+ * the old one. MP3 streams are decoded by the feeder itself for that, since
+ * UpdateMusicStream() can only loop them or cut their last sub-buffer.
+ *
+ * On a seek the frames leading up to the new position are handed to the
+ * primer callback before the stream restarts, so whatever follows the
+ * processor's output (the spectrum) has the new position's past to work with
+ * rather than the audio from before the seek.
+ *
+ * Mapped WAV tracks bypass raylib's decoders: the feeder submits frames to a
+ * plain AudioStream straight from the mapping (converted through a small
+ * scratch buffer only for formats the stream can't take as they are).
+ * -----------------------------------------------------------
+ */
+
+typedef struct
+{
+    Music music;
+    const WavSource *wav;       // Mapped WAV track: music is unused, frames go through stream
+    Mp3Index *mp3_index;        // Seek table bound to music's decoder, freed after it
+    AudioStream stream;
+    float *scratch;             // One sub-buffer of decoded or converted frames, when the track needs it
+    uint64_t cursor;            // Next frame to submit (WAV, and MP3 decoded here)
+    uint64_t frame_count;       // Of the track, for the above
+    WavReadAhead read_ahead;    // Paged in ahead of the cursor
+    double last_submit;         // When the last WAV sub-buffer was submitted
+    uint64_t draining_start;    // First frame of the WAV sub-buffer drained since last_submit
+    size_t draining_frames;     // Track frames in it, the rest being silence
+    uint64_t queued_start;      // Same for the sub-buffer queued behind it
+    size_t queued_frames;
+    unsigned int track_id;
+    bool loaded;
+} FeederTrack;
+
+static struct
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;            // Signalled when a command is queued or on shutdown
+    pthread_cond_t space;           // Signalled when the queue has room again
+
+    FeederCommand queue[FEEDER_QUEUE_SIZE];
+    int head, count;
+
+    bool running;
+    AudioCallback processor;        // Attached to every stream the feeder plays
+    AudioCallback primer;           // Given the frames before a seek target
+    float prime[FEEDER_PRIME_FRAMES][2];
+    FeederStatus status;            // Published snapshot, guarded by lock
+} feeder;
+
+static void ApplyFeederCommand(FeederCommand *command, FeederTrack *current, FeederTrack *next);
+static void LoadFeederTrack(FeederTrack *track, FeederCommand *command);
+static AudioStream *GetFeederTrackStream(FeederTrack *track);
+static bool IsFeederTrackPlaying(FeederTrack *track);
+static float GetFeederTrackTimePlayed(FeederTrack *track);
+static float GetFeederTrackTimeLength(FeederTrack *track);
+static void RefillFeederTrack(FeederTrack *track, bool loop);
+static void PlayFeederTrack(FeederTrack *track);
+static void SeekFeederTrack(FeederTrack *track, float position, bool loop);
+static void AdvanceFeederTrack(FeederTrack *current, FeederTrack *next);
+static void UnloadFeederTrack(FeederTrack *track);
+static void *FeederThread(void *arg);
+
+bool StartAudioFeeder(AudioCallback processor, AudioCallback primer)
+{
+    memset(&feeder, 0, sizeof(feeder));
+    feeder.processor = processor;
+    feeder.primer = primer;
+    feeder.running = true;
+
+    // Known sub-buffer size so the underrun deadline can be computed.
+    SetAudioStreamBufferSizeDefault(FEEDER_SUB_BUFFER_FRAMES);
+
+    pthread_mutex_init(&feeder.lock, NULL);
+    pthread_cond_init(&feeder.wake, NULL);
+    pthread_cond_init(&feeder.space, NULL);
+
+    if (pthread_create(&feeder.thread, NULL, FeederThread, NULL) != 0)
+    {
+        TraceLog(LOG_ERROR, "FEEDER: Unable to create audio feeder thread");
+        feeder.running = false;
+        return false;
+    }
+
+    return true;
+}
+
+void StopAudioFeeder(void)
+{
+    if (!feeder.running) return;
+
+    pthread_mutex_lock(&feeder.lock);
+    feeder.running = false;
+    pthread_cond_signal(&feeder.wake);
+    pthread_mutex_unlock(&feeder.lock);
+
+    pthread_join(feeder.thread, NULL);      // The thread unloads whatever it still owns.
+
+    pthread_cond_destroy(&feeder.space);
+    pthread_cond_destroy(&feeder.wake);
+    pthread_mutex_destroy(&feeder.lock);
+}
+
+void PostFeederCommand(FeederCommand command)
+{
+    pthread_mutex_lock(&feeder.lock);
+    while (feeder.running && feeder.count == FEEDER_QUEUE_SIZE)
+    {
+        pthread_cond_wait(&feeder.space, &feeder.lock);
+    }
+
+    if (feeder.running)
+    {
+        feeder.queue[(feeder.head + feeder.count) % FEEDER_QUEUE_SIZE] = command;
+        feeder.count++;
+        pthread_cond_signal(&feeder.wake);
+    }
+    else if ((command.type == FEEDER_CMD_PLAY || command.type == FEEDER_CMD_QUEUE_NEXT) && command.wav == NULL)
+    {
+        UnloadMusicStream(command.music);   // Nobody will take ownership anymore.
+    }
+    pthread_mutex_unlock(&feeder.lock);
+}
+
+void FeederPlay(Music music, Mp3Index *mp3_index, unsigned int track_id)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_PLAY, .music = music, .mp3_index = mp3_index, .track_id = track_id });
+}
+
+void FeederQueueNext(Music music, Mp3Index *mp3_index, unsigned int track_id)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_QUEUE_NEXT, .music = music, .mp3_index = mp3_index, .track_id = track_id });
+}
+
+void FeederPlayWav(const WavSource *wav, unsigned int track_id)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_PLAY, .wav = wav, .track_id = track_id });
+}
+
+void FeederQueueNextWav(const WavSource *wav, unsigned int track_id)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_QUEUE_NEXT, .wav = wav, .track_id = track_id });
+}
+
+void FeederAdvance(void)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_ADVANCE });
+}
+
+void FeederPause(void)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_PAUSE });
+}
+
+void FeederResume(void)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_RESUME });
+}
+
+void FeederSeek(float position)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_SEEK, .position = position });
+}
+
+void FeederStop(void)
+{
+    PostFeederCommand((FeederCommand) { .type = FEEDER_CMD_STOP });
+}
+
+FeederStatus GetFeederStatus(void)
+{
+    pthread_mutex_lock(&feeder.lock);
+    FeederStatus status = feeder.status;
+    pthread_mutex_unlock(&feeder.lock);
+    return status;
+}
+
+static void LoadFeederTrack(FeederTrack *track, FeederCommand *command)
+{
+    memset(track, 0, sizeof(FeederTrack));
+    track->track_id = command->track_id;
+    track->wav = command->wav;
+
+    if (track->wav == NULL)
+    {
+        track->music = command->music;
+        track->mp3_index = command->mp3_index;
+        track->music.looping = true;    // The feeder decides when a track ends; raylib would cut the last sub-buffer.
+        track->frame_count = track->music.frameCount;
+        if (IsMp3Music(track->music))
+        {
+            // Without the buffer UpdateMusicStream() still refills it, looping at the end.
+            track->scratch = malloc(FEEDER_SUB_BUFFER_FRAMES * track->music.stream.channels * sizeof(float));
+        }
+    }
+    else
+    {
+        // 8/16-bit PCM and 32-bit float go to the stream as they are; anything else is converted to float.
+        const WavSource *wav = track->wav;
+        bool direct = (!wav->is_float && (wav->bits_per_sample == 8 || wav->bits_per_sample == 16)) || wav->is_float;
+        unsigned int sample_size = direct ? wav->bits_per_sample : 32;
+
+        track->stream = LoadAudioStream(wav->sample_rate, sample_size, wav->channels); // Load audio stream (to stream raw audio pcm data)
+        if (!direct)
+        {
+            track->scratch = malloc(FEEDER_SUB_BUFFER_FRAMES * wav->channels * sizeof(float));
+        }
+        track->frame_count = wav->frame_count;
+        UpdateWavReadAhead(wav, &track->read_ahead, 0);
+    }
+
+    track->loaded = true;
+}
+
+static void UnloadFeederTrack(FeederTrack *track)
+{
+    if (!track->loaded) return;
+
+    if (track->wav == NULL)
+    {
+        StopMusicStream(track->music);                                      // Stop music playing
+        DetachAudioStreamProcessor(track->music.stream, feeder.processor);  // Disconnect audio stream processor
+        UnloadMusicStream(track->music);                                    // Unload music stream buffers from RAM
+        free(track->scratch);
+        if (track->mp3_index != NULL)
+        {
+            UnloadMp3Index(track->mp3_index);                               // The decoder no longer points at it
+            free(track->mp3_index);
+        }
+    }
+    else
+    {
+        // The WavSource itself stays mapped: it belongs to the render thread, which also reads it.
+        StopAudioStream(track->stream);
+        DetachAudioStreamProcessor(track->stream, feeder.processor);
+        UnloadAudioStream(track->stream);
+        free(track->scratch);
+    }
+    track->loaded = false;
+}
+
+static AudioStream *GetFeederTrackStream(FeederTrack *track)
+{
+    return (track->wav == NULL) ? &track->music.stream : &track->stream;
+}
+
+static bool IsFeederTrackPlaying(FeederTrack *track)
+{
+    if (!track->loaded) return false;
+    return (track->wav == NULL) ? IsMusicStreamPlaying(track->music) : IsAudioStreamPlaying(track->stream);
+}
+
+static float GetFeederTrackTimeLength(FeederTrack *track)
+{
+    if (track->wav == NULL) return GetMusicTimeLength(track->music);
+    return (float)((double)track->wav->frame_count / track->wav->sample_rate);
+}
+
+static float GetFeederTrackTimePlayed(FeederTrack *track)
+{
+    if (!track->loaded) return 0.0f;
+    if (track->wav == NULL) return GetMusicTimePlayed(track->music);
+
+    /*
+     * Two sub-buffers are queued ahead of the device; the one being drained
+     * has been playing since the other was last refilled. Once the track has
+     * played out nothing is refilled anymore, and the queued one follows.
+     */
+    const WavSource *wav = track->wav;
+    double drained = IsAudioStreamPlaying(track->stream) ? (GetTime() - track->last_submit) * wav->sample_rate : 0.0;
+
+    double played;
+    if (drained < FEEDER_SUB_BUFFER_FRAMES)
+    {
+        played = (double)track->draining_start + ((drained < track->draining_frames) ? drained : (double)track->draining_frames);
+    }
+    else
+    {
+        drained -= FEEDER_SUB_BUFFER_FRAMES;
+        played = (double)track->queued_start + ((drained < track->queued_frames) ? drained : (double)track->queued_frames);
+    }
+    if (played >= (double)wav->frame_count) played -= (double)wav->frame_count;    // Wrapped around (looping)
+
+    return (float)(played / wav->sample_rate);
+}
+
+/*
+ * loop is false while another track is queued: past the last frame nothing
+ * more is submitted, and the stream plays silence until the switch.
+ */
+static void RefillFeederTrack(FeederTrack *track, bool loop)
+{
+    if (track->wav == NULL && track->scratch == NULL)
+    {
+        UpdateMusicStream(track->music); // Update music buffer with new stream data
+        return;
+    }
+
+    if (track->wav == NULL)
+    {
+        unsigned int channels = track->music.stream.channels;
+        for (int sub_buffer = 0; sub_buffer < 2 && IsAudioStreamProcessed(track->music.stream); sub_buffer++)
+        {
+            if (track->cursor >= track->frame_count && !loop) break;
+
+            unsigned int frames = ReadMp3Frames(track->music, track->scratch, FEEDER_SUB_BUFFER_FRAMES);
+            track->cursor += frames;
+            if (frames < FEEDER_SUB_BUFFER_FRAMES && loop)
+            {
+                // Carry on from the start in the same sub-buffer, as UpdateMusicStream() does.
+                SeekMp3Frame(track->music, 0);
+                track->cursor = ReadMp3Frames(track->music, track->scratch + frames * channels, FEEDER_SUB_BUFFER_FRAMES - frames);
+                frames += (unsigned int)track->cursor;
+            }
+            if (frames == 0) break;
+
+            UpdateAudioStream(track->music.stream, track->scratch, (int)frames); // Copied into the stream's sub-buffer
+        }
+        return;
+    }
+
+    const WavSource *wav = track->wav;
+    for (int sub_buffer = 0; sub_buffer < 2 && IsAudioStreamProcessed(track->stream); sub_buffer++)
+    {
+        if (track->cursor >= wav->frame_count)
+        {
+            if (!loop) break;
+            track->cursor = 0;   // Loop, like raylib does for music
+        }
+
+        size_t frames = FEEDER_SUB_BUFFER_FRAMES;
+        if (frames > wav->frame_count - track->cursor) frames = (size_t)(wav->frame_count - track->cursor);
+
+        const void *pcm = GetWavFrames(wav, track->cursor);
+        if (track->scratch != NULL)
+        {
+            ConvertWavFrames(wav, track->cursor, frames, track->scratch);
+            pcm = track->scratch;
+        }
+
+        UpdateAudioStream(track->stream, pcm, (int)frames); // Copied into the stream's sub-buffer
+        if (track->draining_frames == 0)
+        {
+            track->draining_start = track->cursor;      // First since the track was loaded or sought: drained first
+            track->draining_frames = frames;
+        }
+        else
+        {
+            if (track->queued_frames > 0)
+            {
+                track->draining_start = track->queued_start;
+                track->draining_frames = track->queued_frames;
+            }
+            track->queued_start = track->cursor;
+            track->queued_frames = frames;
+        }
+        track->cursor += frames;
+        track->last_submit = GetTime();
+        UpdateWavReadAhead(wav, &track->read_ahead, track->cursor);
+    }
+}
+
+static void PlayFeederTrack(FeederTrack *track)
+{
+    if (track->wav == NULL) PlayMusicStream(track->music);   // Start music playing
+    else
+    {
+        PlayAudioStream(track->stream);
+        track->last_submit = GetTime();     // A queued track was primed a while ago; it drains from now
+    }
+}
+
+static void SeekFeederTrack(FeederTrack *track, float position, bool loop)
+{
+    /*
+     * Drop the queued sub-buffers as well, so the new position is heard right
+     * away. StopAudioStream() rather than StopMusicStream(), which would rewind
+     * the decoder. The processor is detached meanwhile: that waits for the
+     * mixer to be done with the stream, and keeps the primed frames ahead of
+     * the first ones mixed from the new position.
+     */
+    AudioStream *stream = GetFeederTrackStream(track);
+    bool playing = IsFeederTrackPlaying(track);
+    DetachAudioStreamProcessor(*stream, feeder.processor);
+    StopAudioStream(*stream);
+
+    uint64_t frame = (position > 0.0f) ? (uint64_t)((double)position * stream->sampleRate) : 0;
+    if (frame >= track->frame_count) frame = 0;
+    uint64_t first = (frame > FEEDER_PRIME_FRAMES) ? frame - FEEDER_PRIME_FRAMES : 0;
+    unsigned int primed = 0;
+
+    if (track->wav != NULL)
+    {
+        const WavSource *wav = track->wav;
+        for (; first + primed < frame; primed++)
+        {
+            feeder.prime[primed][0] = GetWavSample(wav, first + primed, 0);
+            feeder.prime[primed][1] = (wav->channels > 1) ? GetWavSample(wav, first + primed, 1) : feeder.prime[primed][0];
+        }
+
+        track->cursor = frame;
+        track->draining_frames = 0;
+        track->queued_frames = 0;
+        UpdateWavReadAhead(wav, &track->read_ahead, frame);
+    }
+    else
+    {
+        if (track->scratch != NULL && SeekMp3Frame(track->music, first))
+        {
+            primed = ReadMp3Frames(track->music, &feeder.prime[0][0], (unsigned int)(frame - first));
+            if (track->music.stream.channels == 1)
+            {
+                for (unsigned int i = primed; i-- > 0;)
+                {
+                    float sample = (&feeder.prime[0][0])[i];    // Spread out in place, from the back
+                    feeder.prime[i][0] = sample;
+                    feeder.prime[i][1] = sample;
+                }
+            }
+        }
+
+        SeekMusicStream(track->music, position);   // Jumps through the seek table when one is bound
+        track->cursor = frame;
+    }
+
+    RefillFeederTrack(track, loop);
+    if (primed > 0 && feeder.primer != NULL) feeder.primer(feeder.prime, primed);
+
+    AttachAudioStreamProcessor(*stream, feeder.processor); // Attach audio stream processor to stream, receives the samples as <float>s
+    if (playing) PlayFeederTrack(track);
+}
+
+static void AdvanceFeederTrack(FeederTrack *current, FeederTrack *next)
+{
+    FeederTrack previous = *current;
+
+    *current = *next;
+    next->loaded = false;
+
+    // The queued stream is already primed: start it first, then retire the old one.
+    AttachAudioStreamProcessor(*GetFeederTrackStream(current), feeder.processor); // Attach audio stream processor to stream, receives the samples as <float>s
+    PlayFeederTrack(current);
+    UnloadFeederTrack(&previous);
+}
+
+static void ApplyFeederCommand(FeederCommand *command, FeederTrack *current, FeederTrack *next)
+{
+    switch (command->type)
+    {
+        case FEEDER_CMD_PLAY:
+            UnloadFeederTrack(next);
+            UnloadFeederTrack(current);
+            LoadFeederTrack(current, command);
+            RefillFeederTrack(current, true);                                            // Fill both sub-buffers before the device reads them
+            PlayFeederTrack(current);
+            AttachAudioStreamProcessor(*GetFeederTrackStream(current), feeder.processor); // Attach audio stream processor to stream, receives the samples as <float>s
+            break;
+        case FEEDER_CMD_QUEUE_NEXT:
+            UnloadFeederTrack(next);
+            LoadFeederTrack(next, command);
+            RefillFeederTrack(next, true);  // Decode both sub-buffers now, while the stream is still stopped
+            break;
+        case FEEDER_CMD_ADVANCE:
+            if (next->loaded) AdvanceFeederTrack(current, next);
+            break;
+        case FEEDER_CMD_PAUSE:
+            if (current->loaded) PauseAudioStream(*GetFeederTrackStream(current));
+            break;
+        case FEEDER_CMD_RESUME:
+            if (current->loaded) ResumeAudioStream(*GetFeederTrackStream(current));
+            break;
+        case FEEDER_CMD_SEEK:
+            if (current->loaded) SeekFeederTrack(current, command->position, !next->loaded);
+            break;
+        case FEEDER_CMD_STOP:
+            UnloadFeederTrack(next);
+            UnloadFeederTrack(current);
+            break;
+    }
+}
+
+static void *FeederThread(void *arg)
+{
+    (void)arg;
+    RegisterAllocThread("feeder", false);
+
+    FeederTrack current = { 0 };
+    FeederTrack next = { 0 };
+
+    FeederCommand pending[FEEDER_QUEUE_SIZE];
+    double last_refill = 0.0;
+    double time_left = 0.0;     // Until the current stream ends, only tracked while one is queued
+    float last_played = 0.0f;   // Detects raylib looping the stream when the boundary was overslept
+
+    pthread_mutex_lock(&feeder.lock);
+    while (feeder.running)
+    {
+        if (feeder.count == 0)
+        {
+            // Wake on the regular cadence, or right at the end of the current stream.
+            long wait_ns = FEEDER_WAKE_INTERVAL_MS * 1000000L;
+            if (next.loaded && time_left * 1e9 < wait_ns) wait_ns = (time_left > 0.0) ? (long)(time_left * 1e9) : 0;
+
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += wait_ns;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec += 1;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            if (wait_ns > 0) pthread_cond_timedwait(&feeder.wake, &feeder.lock, &deadline);
+        }
+
+        // Take the whole queue, then work without holding the lock.
+        int n_pending = feeder.count;
+        for (int i = 0; i < n_pending; i++)
+        {
+            pending[i] = feeder.queue[(feeder.head + i) % FEEDER_QUEUE_SIZE];
+        }
+        feeder.head = (feeder.head + n_pending) % FEEDER_QUEUE_SIZE;
+        feeder.count = 0;
+        if (n_pending > 0) pthread_cond_broadcast(&feeder.space);
+        pthread_mutex_unlock(&feeder.lock);
+
+        //----------------------------------------------------------------------------------
+        for (int i = 0; i < n_pending; i++)
+        {
+            ApplyFeederCommand(&pending[i], &current, &next);
+            if (pending[i].type != FEEDER_CMD_PAUSE && pending[i].type != FEEDER_CMD_QUEUE_NEXT)
+            {
+                last_refill = GetTime();
+                last_played = 0.0f;
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        if (current.loaded && next.loaded && IsFeederTrackPlaying(&current))
+        {
+            float played = GetFeederTrackTimePlayed(&current);
+            bool wrapped = played < last_played;
+            last_played = played;
+            time_left = GetFeederTrackTimeLength(&current) - played;
+
+            if (time_left <= 0.0005 || wrapped)
+            {
+                AdvanceFeederTrack(&current, &next);
+                last_refill = GetTime();
+                last_played = 0.0f;
+                time_left = 0.0;
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        unsigned int refills = 0, underruns = 0;
+        bool playing = IsFeederTrackPlaying(&current);
+
+        if (playing && IsAudioStreamProcessed(*GetFeederTrackStream(&current)))
+        {
+            /*
+             * One sub-buffer lasts FEEDER_SUB_BUFFER_FRAMES / sampleRate seconds. If more than
+             * two of those have passed since the last refill the device ran dry in between.
+             */
+            double now = GetTime();
+            double buffer_seconds = 2.0 * FEEDER_SUB_BUFFER_FRAMES / (double)GetFeederTrackStream(&current)->sampleRate;
+            if (last_refill > 0.0 && (now - last_refill) > buffer_seconds)
+            {
+                underruns++;
+            }
+
+            RefillFeederTrack(&current, !next.loaded);
+            refills++;
+            last_refill = now;
+        }
+        else if (!playing)
+        {
+            last_refill = 0.0;
+        }
+
+        float time_played = GetFeederTrackTimePlayed(&current);
+        double status_time = GetTime();
+
+        //----------------------------------------------------------------------------------
+        pthread_mutex_lock(&feeder.lock);
+        feeder.status.has_music = current.loaded;
+        feeder.status.playing = playing;
+        feeder.status.has_next = next.loaded;
+        feeder.status.track_id = current.loaded ? current.track_id : 0;
+        feeder.status.time_played = time_played;
+        feeder.status.time = status_time;
+        feeder.status.refills += refills;
+        feeder.status.underruns += underruns;
+        if (underruns > 0)
+        {
+            TraceLog(LOG_WARNING, "FEEDER: Audio underrun (%u total)", feeder.status.underruns);
+        }
+    }
+
+    // Drop commands that never got applied, releasing any stream handed over.
+    for (int i = 0; i < feeder.count; i++)
+    {
+        FeederCommand *command = &feeder.queue[(feeder.head + i) % FEEDER_QUEUE_SIZE];
+        if ((command->type == FEEDER_CMD_PLAY || command->type == FEEDER_CMD_QUEUE_NEXT) && command->wav == NULL)
+        {
+            UnloadMusicStream(command->music);
+            if (command->mp3_index != NULL)
+            {
+                UnloadMp3Index(command->mp3_index);
+                free(command->mp3_index);
+            }
+        }
+    }
+    feeder.count = 0;
+    pthread_mutex_unlock(&feeder.lock);
+
+    UnloadFeederTrack(&next);
+    UnloadFeederTrack(&current);
+    return NULL;
+}
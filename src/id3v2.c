@@ -0,0 +1,475 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mapped_file.h"
+#include "id3v2.h"
+
+/*
+ * ID3v2 tag reader.
+ * -----------------------------------------------------------
+ * taglib_file_new() opens the file and builds TagLib's whole object model
+ * (every frame of every tag, the audio properties) for the few strings and
+ * the picture the track loader wants. An ID3v2 tag is a 10-byte header and
+ * a run of frames, each a 10-byte header (four-letter id, size, flags) and
+ * its payload, so the frames of interest can be read straight out of a
+ * mapping of the first bytes of the file:
+ *
+ *   TIT2, TPE1, TALB   title, artist, album
+ *   TCON               genres: text, or "(17)" / "17" for an ID3v1 genre
+ *   TDRC, TYER         year (2.4 recording time, 2.3 year)
+ *   APIC               encoding, MIME type, picture type, description, image
+ *
+ * Text frames start with an encoding byte (ISO-8859-1, UTF-16 with a BOM,
+ * UTF-16BE, UTF-8) and come out in UTF-8, several values joined with " / "
+ * as TagLib 2 shows them. ID3v2.4 frame sizes are syncsafe (7 bits per
+ * byte), except where some taggers wrote plain ones: a size with a high bit
+ * set is taken as plain. Frames whose payload isn't stored as is
+ * (unsynchronised, compressed, encrypted) can't be read in place, so the
+ * tag is left to TagLib, as is a tag missing any of the fields the player
+ * shows: TagLib would go on to an ID3v1 or APE tag for it.
+ * -----------------------------------------------------------
+ * https://id3.org/id3v2.3.0
+ * https://id3.org/id3v2.4.0-structure
+ * https://id3.org/id3v2.4.0-frames
+ */
+
+#define HEADER_SIZE 10
+#define TAG_UNSYNCHRONISED 0x80
+#define TAG_EXTENDED_HEADER 0x40
+
+// Frame format flags (second flag byte)
+#define V3_COMPRESSED 0x80
+#define V3_ENCRYPTED 0x40
+#define V4_COMPRESSED 0x08
+#define V4_ENCRYPTED 0x04
+#define V4_UNSYNCHRONISED 0x02
+#define V4_DATA_LENGTH 0x01
+
+#define MAX_VALUES 16           // Of one text frame, TCON fields included; more leave the tag to TagLib
+
+enum { ENCODING_LATIN1 = 0, ENCODING_UTF16, ENCODING_UTF16BE, ENCODING_UTF8 };
+
+// ID3v1 genres TCON may refer to by number; later (Winamp) numbers are left to TagLib.
+static const char *v1_genres[] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop", "Jazz", "Metal",
+    "New Age", "Oldies", "Other", "Pop", "R&B", "Rap", "Reggae", "Rock", "Techno", "Industrial",
+    "Alternative", "Ska", "Death Metal", "Pranks", "Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk",
+    "Fusion", "Trance", "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "Alternative Rock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock", "Ethnic", "Gothic",
+    "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream", "Southern Rock", "Comedy", "Cult", "Gangsta",
+    "Top 40", "Christian Rap", "Pop/Funk", "Jungle", "Native American", "Cabaret", "New Wave", "Psychedelic", "Rave", "Showtunes",
+    "Trailer", "Lo-Fi", "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock",
+};
+
+static uint32_t ReadU32BE(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static bool IsSyncsafe(const unsigned char *p)
+{
+    return ((p[0] | p[1] | p[2] | p[3]) & 0x80) == 0;
+}
+
+static uint32_t ReadSyncsafe(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 21) | ((uint32_t)p[1] << 14) | ((uint32_t)p[2] << 7) | (uint32_t)p[3];
+}
+
+static size_t PutUtf8(char *out, uint32_t code)
+{
+    if (code < 0x80)
+    {
+        out[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800)
+    {
+        out[0] = (char)(0xC0 | (code >> 6));
+        out[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (code >> 12));
+        out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code >> 18));
+    out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+/*
+ * The values of a text payload (after its encoding byte) in UTF-8, each
+ * followed by a zero byte, empty ones left out as TagLib does; NULL if out
+ * of memory. In UTF-16 a value without a BOM keeps the byte order of the
+ * one before it.
+ */
+static char *DecodeValues(unsigned int encoding, const unsigned char *p, size_t size, int *count, Arena *arena)
+{
+    char *text = ScratchAlloc(arena, 2 * size + 1);      // The longest expansion: ISO-8859-1 above 0x7F to two bytes
+    if (text == NULL) return NULL;
+    size_t length = 0, value_start = 0;
+    *count = 0;
+
+    if (encoding == ENCODING_UTF16 || encoding == ENCODING_UTF16BE)
+    {
+        bool big_endian = true;
+        bool value_begins = true;
+        for (size_t i = 0; i + 1 < size; i += 2)
+        {
+            if (value_begins && encoding == ENCODING_UTF16 && ((p[i] == 0xFF && p[i + 1] == 0xFE) || (p[i] == 0xFE && p[i + 1] == 0xFF)))
+            {
+                big_endian = (p[i] == 0xFE);
+                continue;
+            }
+            value_begins = false;
+
+            uint32_t unit = big_endian ? ((uint32_t)p[i] << 8 | p[i + 1]) : ((uint32_t)p[i + 1] << 8 | p[i]);
+            if (unit == 0)
+            {
+                if (length > value_start)
+                {
+                    text[length++] = '\0';
+                    (*count)++;
+                }
+                value_start = length;
+                value_begins = true;
+                continue;
+            }
+
+            if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < size)
+            {
+                uint32_t low = big_endian ? ((uint32_t)p[i + 2] << 8 | p[i + 3]) : ((uint32_t)p[i + 3] << 8 | p[i + 2]);
+                if (low >= 0xDC00 && low < 0xE000)
+                {
+                    unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                    i += 2;
+                }
+            }
+            if (unit >= 0xD800 && unit < 0xE000) unit = 0xFFFD;     // Unpaired surrogate
+            length += PutUtf8(text + length, unit);
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            if (p[i] == 0)
+            {
+                if (length > value_start)
+                {
+                    text[length++] = '\0';
+                    (*count)++;
+                }
+                value_start = length;
+            }
+            else if (encoding == ENCODING_UTF8) text[length++] = (char)p[i];
+            else length += PutUtf8(text + length, p[i]);
+        }
+    }
+
+    if (length > value_start)
+    {
+        text[length++] = '\0';
+        (*count)++;
+    }
+    if (length == 0) text[0] = '\0';
+    return text;
+}
+
+/* count strings joined with " / ", as TagLib 2 shows a frame with several values; NULL if out of memory. */
+static char *JoinValues(const char **values, int count, Arena *arena)
+{
+    size_t length = 0;
+    for (int i = 0; i < count; i++) length += strlen(values[i]) + 3;
+
+    char *text = ScratchAlloc(arena, length + 1);
+    if (text == NULL) return NULL;
+    length = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (i > 0)
+        {
+            memcpy(text + length, " / ", 3);
+            length += 3;
+        }
+        size_t value_length = strlen(values[i]);
+        memcpy(text + length, values[i], value_length);
+        length += value_length;
+    }
+    text[length] = '\0';
+    return text;
+}
+
+/* The whole of s is a number, as TagLib's String::toInt() wants it. */
+static bool ParseNumber(const char *s, long *number)
+{
+    if (!((s[0] >= '0' && s[0] <= '9') || ((s[0] == '-' || s[0] == '+') && s[1] >= '0' && s[1] <= '9'))) return false;
+    char *end;
+    *number = strtol(s, &end, 10);
+    return *end == '\0';
+}
+
+/*
+ * TCON values as TagLib 2 shows them. Each value is split first: "(17)(31)Indie"
+ * gives "17", "31" and "Indie", a reference dropped when the text after it is
+ * its own name ("(17)Rock"). Then numbers become ID3v1 genre names, repeats go
+ * and the rest is joined. NULL for a number without a name here, or out of memory.
+ */
+static char *ResolveGenres(char *values, int count, Arena *arena)
+{
+    const char *fields[MAX_VALUES];
+    int n_fields = 0;
+
+    char *value = values;
+    for (int v = 0; v < count; v++)
+    {
+        char *next = value + strlen(value) + 1;
+        char *close;
+        while (value[0] == '(' && (close = strchr(value + 1, ')')) != NULL)
+        {
+            *close = '\0';
+            const char *code = value + 1;
+            value = close + 1;
+
+            long number;
+            bool reference = ParseNumber(code, &number) && number >= 0 && number <= 255;
+            if (reference && number >= (long)(sizeof(v1_genres) / sizeof(v1_genres[0]))) return NULL;
+            if ((reference && strcmp(v1_genres[number], value) != 0) || strcmp(code, "RX") == 0 || strcmp(code, "CR") == 0)
+            {
+                if (n_fields == MAX_VALUES) return NULL;
+                fields[n_fields++] = code;
+            }
+        }
+        if (value[0] != '\0')
+        {
+            if (n_fields == MAX_VALUES) return NULL;
+            fields[n_fields++] = value;
+        }
+        value = next;
+    }
+
+    const char *genres[MAX_VALUES];
+    int n_genres = 0;
+    for (int f = 0; f < n_fields; f++)
+    {
+        const char *genre = fields[f];
+        long number;
+        if (ParseNumber(genre, &number) && number >= 0 && number <= 255)
+        {
+            if (number >= (long)(sizeof(v1_genres) / sizeof(v1_genres[0]))) return NULL;
+            genre = v1_genres[number];
+        }
+
+        bool repeated = false;
+        for (int g = 0; g < n_genres; g++) repeated |= (strcmp(genres[g], genre) == 0);
+        if (!repeated) genres[n_genres++] = genre;
+    }
+
+    return JoinValues(genres, n_genres, arena);
+}
+
+static bool ReadPicture(Id3v2Tag *tag, const unsigned char *p, size_t size)
+{
+    if (size < 2) return false;
+    unsigned int encoding = p[0];
+    size_t i = 1;
+
+    size_t mime_length = 0;
+    while (i < size && p[i] != 0)
+    {
+        if (mime_length < ID3V2_MIME_SIZE - 1) tag->picture_mime[mime_length++] = (char)p[i];
+        i++;
+    }
+    tag->picture_mime[mime_length] = '\0';
+    i += 2;     // Terminator, picture type
+
+    // Description, terminated by one zero byte, or two aligned ones in UTF-16
+    if (encoding == ENCODING_UTF16 || encoding == ENCODING_UTF16BE)
+    {
+        while (i + 1 < size && (p[i] | p[i + 1]) != 0) i += 2;
+        i += 2;
+    }
+    else
+    {
+        while (i < size && p[i] != 0) i++;
+        i += 1;
+    }
+    if (i >= size) return false;
+
+    tag->picture = p + i;
+    tag->picture_size = size - i;
+    return true;
+}
+
+/* The frames of interest, the first of each kind; false for TagLib to read the tag. */
+static bool ParseFrames(Id3v2Tag *tag, size_t pos, size_t end)
+{
+    char **texts[3] = { &tag->title, &tag->artist, &tag->album };
+    static const char *text_ids[3] = { "TIT2", "TPE1", "TALB" };
+    bool text_seen[3] = { false, false, false };
+    bool genre_seen = false, year_seen = false;
+
+    while (pos + HEADER_SIZE <= end)
+    {
+        const unsigned char *frame = tag->file.data + pos;
+        if (frame[0] == 0) break;   // Padding
+
+        for (int c = 0; c < 4; c++)
+        {
+            if (!((frame[c] >= 'A' && frame[c] <= 'Z') || (frame[c] >= '0' && frame[c] <= '9'))) return true;
+        }
+
+        size_t size = (tag->version == 4 && IsSyncsafe(frame + 4)) ? ReadSyncsafe(frame + 4) : ReadU32BE(frame + 4);
+        if (size > end - pos - HEADER_SIZE) break;
+        const unsigned char *payload = frame + HEADER_SIZE;
+        pos += HEADER_SIZE + size;
+
+        int text_index = -1;
+        for (int t = 0; t < 3; t++)
+        {
+            if (memcmp(frame, text_ids[t], 4) == 0 && !text_seen[t]) text_index = t;
+        }
+        bool genre = (memcmp(frame, "TCON", 4) == 0 && !genre_seen);
+        bool year = ((memcmp(frame, "TDRC", 4) == 0 || memcmp(frame, "TYER", 4) == 0) && !year_seen);
+        bool picture = (memcmp(frame, "APIC", 4) == 0 && tag->picture == NULL);
+        if (text_index < 0 && !genre && !year && !picture) continue;
+
+        unsigned char format = frame[9];
+        if (tag->version == 3 && (format & (V3_COMPRESSED | V3_ENCRYPTED))) return false;
+        if (tag->version == 4 && (format & (V4_COMPRESSED | V4_ENCRYPTED | V4_UNSYNCHRONISED))) return false;
+        if (tag->version == 4 && (format & V4_DATA_LENGTH))
+        {
+            if (size < 4) continue;
+            payload += 4;
+            size -= 4;
+        }
+        if (size < 1) continue;
+
+        if (picture)
+        {
+            ReadPicture(tag, payload, size);
+            continue;
+        }
+
+        int count;
+        char *values = DecodeValues(payload[0], payload + 1, size - 1, &count, tag->arena);
+        if (values == NULL) return false;
+
+        char *value = values;
+        if (text_index >= 0)
+        {
+            text_seen[text_index] = true;
+            if (count > 1)
+            {
+                const char *split[MAX_VALUES];
+                if (count > MAX_VALUES)
+                {
+                    ScratchFree(tag->arena, values);
+                    return false;
+                }
+                for (int v = 0; v < count; v++) split[v] = (v == 0) ? values : split[v - 1] + strlen(split[v - 1]) + 1;
+                value = JoinValues(split, count, tag->arena);
+                ScratchFree(tag->arena, values);
+                if (value == NULL) return false;
+            }
+            ScratchFree(tag->arena, *texts[text_index]);
+            *texts[text_index] = value;
+        }
+        else if (genre)
+        {
+            genre_seen = true;
+            value = ResolveGenres(values, count, tag->arena);
+            ScratchFree(tag->arena, values);
+            if (value == NULL) return false;
+            ScratchFree(tag->arena, tag->genre);
+            tag->genre = value;
+        }
+        else
+        {
+            year_seen = true;
+            tag->year = (unsigned int)strtoul(value, NULL, 10);     // "2019", or "2019-05-01T..." for TDRC
+            ScratchFree(tag->arena, values);
+        }
+    }
+
+    return true;
+}
+
+/* TagLib takes a field the ID3v2 tag lacks from an ID3v1 or APE tag: any shown one missing leaves the file to it. */
+static bool HasAllFields(const Id3v2Tag *tag)
+{
+    return tag->title[0] != '\0' && tag->artist[0] != '\0' && tag->album[0] != '\0' && tag->genre[0] != '\0' && tag->year != 0;
+}
+
+static char *EmptyString(Arena *arena)
+{
+    return ScratchCalloc(arena, 1, 1);
+}
+
+/* Reads the ID3v2 tag at the start of the file; false (nothing held) when it's missing or TagLib should read it. */
+bool OpenId3v2Tag(const char *file_path, Id3v2Tag *tag, Arena *arena)
+{
+    memset(tag, 0, sizeof(Id3v2Tag));
+    tag->arena = arena;
+    if (!OpenMappedFileRange(file_path, ID3V2_PROBE_SIZE, &tag->file)) return false;
+
+    const unsigned char *header = tag->file.data;
+    if (tag->file.size < HEADER_SIZE || memcmp(header, "ID3", 3) != 0 || (header[3] != 3 && header[3] != 4) ||
+        (header[5] & TAG_UNSYNCHRONISED) || !IsSyncsafe(header + 6))
+    {
+        CloseMappedFile(&tag->file);
+        return false;
+    }
+    tag->version = header[3];
+    unsigned char flags = header[5];
+
+    uint64_t end = HEADER_SIZE + (uint64_t)ReadSyncsafe(header + 6);
+    if (end > tag->file.size && tag->file.size < tag->file.file_size)
+    {
+        CloseMappedFile(&tag->file);
+        if (!OpenMappedFileRange(file_path, (size_t)end, &tag->file)) return false;
+    }
+    if (end > tag->file.size) end = tag->file.size;     // Truncated file: read what is there
+
+    size_t pos = HEADER_SIZE;
+    if (flags & TAG_EXTENDED_HEADER)
+    {
+        if (pos + 4 > end) end = pos;
+        else
+        {
+            const unsigned char *extended = tag->file.data + pos;
+            pos += (tag->version == 4) ? ReadSyncsafe(extended) : ReadU32BE(extended) + 4;     // 2.3 leaves the size field out
+        }
+    }
+
+    tag->title = EmptyString(arena);
+    tag->artist = EmptyString(arena);
+    tag->album = EmptyString(arena);
+    tag->genre = EmptyString(arena);
+
+    if (tag->title == NULL || tag->artist == NULL || tag->album == NULL || tag->genre == NULL || pos > end ||
+        !ParseFrames(tag, pos, (size_t)end) || !HasAllFields(tag))
+    {
+        CloseId3v2Tag(tag);
+        return false;
+    }
+
+    return true;
+}
+
+void CloseId3v2Tag(Id3v2Tag *tag)
+{
+    ScratchFree(tag->arena, tag->title);
+    ScratchFree(tag->arena, tag->artist);
+    ScratchFree(tag->arena, tag->album);
+    ScratchFree(tag->arena, tag->genre);
+    CloseMappedFile(&tag->file);
+    memset(tag, 0, sizeof(Id3v2Tag));
+}
@@ -0,0 +1,645 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "raylib.h"
+#include "jpeg_scaled.h"
+
+/*
+ * Reduced-resolution JPEG decoding.
+ * -----------------------------------------------------------
+ * An 8x8 block's DCT coefficients describe it at any resolution: an N-point
+ * inverse DCT of the top-left NxN coefficients (same C(u)/2 weights, angles
+ * of an N-point transform) gives the block averaged down to NxN. At N = 1
+ * that is the DC coefficient over 8, so a 1/8 decode never runs an IDCT.
+ * The Huffman data still has to be walked to find where each block ends,
+ * but the coefficients outside NxN are skipped rather than stored, and
+ * every later stage (IDCT, color conversion, the image itself) works on
+ * 1/N^2 of the pixels.
+ *
+ * Subsampled chroma is upsampled the same way: a component sampled at half
+ * the luma rate gets a 2N-point IDCT, so at 1/4 or 1/8 scale its planes come
+ * out at the luma's resolution for free. Only at full or half scale, where
+ * that would take more than 8 points, are its samples repeated.
+ *
+ * Components are decoded into planes, one scan at a time (baseline files
+ * may send each component in a scan of its own), then converted to RGB.
+ * -----------------------------------------------------------
+ * https://www.w3.org/Graphics/JPEG/itu-t81.pdf
+ */
+
+#define BLOCK_SIZE 8
+#define MAX_SAMPLING 4
+#define MAX_TABLES 4
+#define HUFFMAN_LOOKAHEAD 9                 // Codes up to this long take one table read
+#define MAX_DC_CATEGORY 11                  // Of an 8-bit baseline DC difference
+#define MAX_DC_VALUE 2047                   // Quantized DC of 8-bit samples; keeps dc_prediction * quant in range
+
+#define MARKER_SOF0 0xC0                    // Baseline
+#define MARKER_SOF1 0xC1                    // Extended sequential, Huffman
+#define MARKER_DHT 0xC4
+#define MARKER_RST0 0xD0
+#define MARKER_RST7 0xD7
+#define MARKER_EOI 0xD9
+#define MARKER_SOS 0xDA
+#define MARKER_DQT 0xDB
+#define MARKER_DRI 0xDD
+#define MARKER_APP0 0xE0
+#define MARKER_APP14 0xEE
+
+typedef struct
+{
+    uint16_t lookup[1 << HUFFMAN_LOOKAHEAD];    // Code length << 8 | symbol, 0 if the code is longer
+    int32_t max_code[17];                       // Largest code of each length, -1 if none
+    int32_t offset[17];                         // Index in symbols minus the code, per length
+    unsigned char symbols[256];
+} HuffmanTable;
+
+typedef struct
+{
+    int id;
+    int h, v;                                   // Sampling factors
+    int quant;
+    int dc_table, ac_table;
+    int dc_prediction;
+    int size_shift_x, size_shift_y;             // log2 of the IDCT's output per block
+    int repeat_shift_x, repeat_shift_y;         // log2 of the repetition up to the output grid
+    int stride, rows;
+    unsigned char *plane;
+    bool scanned;                               // Its blocks have been decoded
+} JpegComponent;
+
+typedef struct
+{
+    const unsigned char *pos, *end;
+    uint64_t bits;                              // Entropy-coded bits, MSB first
+    int n_bits;
+    int fill_bits;                              // Zeros fed past a marker or the end of the data, not all of them read yet
+    bool at_marker;                             // Zeros are fed from here on
+
+    uint16_t quant[MAX_TABLES][64];             // Natural order
+    HuffmanTable dc[MAX_TABLES], ac[MAX_TABLES];
+    bool has_dc[MAX_TABLES], has_ac[MAX_TABLES];
+
+    JpegComponent components[JPEG_MAX_COMPONENTS];
+    int n_components;
+    int width, height;
+    int max_h, max_v;
+    int mcus_x, mcus_y;
+    int restart_interval;
+    int scale_shift;                            // log2 of the output per luma block: 0 is 1/8, 3 full scale
+    int adobe_transform;                        // -1 without an Adobe segment
+    bool jfif;
+    bool frame;
+    bool error;
+} JpegDecoder;
+
+// Natural (row-major) position of each coefficient in zig-zag order.
+static const unsigned char zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static float idct_basis[4][BLOCK_SIZE][BLOCK_SIZE];     // [log2 N][x][u]: C(u)/2 cos((2x + 1) u pi / 2N)
+static pthread_once_t basis_once = PTHREAD_ONCE_INIT;
+
+static void BuildIdctBasis(void)
+{
+    for (int shift = 0; shift < 4; shift++)
+    {
+        int n = 1 << shift;
+        for (int x = 0; x < n; x++)
+        {
+            for (int u = 0; u < n; u++)
+            {
+                float c = (u == 0) ? 0.70710678f : 1.0f;
+                idct_basis[shift][x][u] = 0.5f * c * cosf((2 * x + 1) * u * PI / (2.0f * n));
+            }
+        }
+    }
+}
+
+static int ReadU16BE(const unsigned char *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static int Log2(int value)
+{
+    int shift = 0;
+    while ((1 << shift) < value) shift++;
+    return ((1 << shift) == value) ? shift : -1;
+}
+
+static unsigned char ClampSample(float value)
+{
+    return (unsigned char)((value <= 0.0f) ? 0 : (value >= 255.0f) ? 255 : (int)(value + 0.5f));
+}
+
+static int ScaledSize(int size, int scale_shift)
+{
+    return (size * (1 << scale_shift) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+/* Entropy-coded data */
+//----------------------------------------------------------------------------------
+static void FillBits(JpegDecoder *jpeg)
+{
+    while (jpeg->n_bits <= 56)
+    {
+        unsigned int byte = 0;
+        bool filler = true;
+        if (!jpeg->at_marker && jpeg->pos < jpeg->end)
+        {
+            byte = *jpeg->pos;
+            filler = false;
+            if (byte != 0xFF) jpeg->pos++;
+            else if (jpeg->pos + 1 < jpeg->end && jpeg->pos[1] == 0x00) jpeg->pos += 2;    // Stuffed 0xFF
+            else
+            {
+                jpeg->at_marker = true;     // Left for the marker parser (or a restart)
+                byte = 0;
+                filler = true;
+            }
+        }
+        if (filler) jpeg->fill_bits += 8;
+        jpeg->bits |= (uint64_t)byte << (56 - jpeg->n_bits);
+        jpeg->n_bits += 8;
+    }
+}
+
+static void ResetBits(JpegDecoder *jpeg)
+{
+    jpeg->bits = 0;
+    jpeg->n_bits = 0;
+    jpeg->fill_bits = 0;
+    jpeg->at_marker = false;
+}
+
+// True once the decoder has read bits that were never in the data: the scan is truncated or corrupt.
+static bool ReadPastData(const JpegDecoder *jpeg)
+{
+    return jpeg->fill_bits > jpeg->n_bits;
+}
+
+static unsigned int GetBits(JpegDecoder *jpeg, int n)
+{
+    if (n == 0) return 0;
+    if (jpeg->n_bits < n) FillBits(jpeg);
+    unsigned int value = (unsigned int)(jpeg->bits >> (64 - n));
+    jpeg->bits <<= n;
+    jpeg->n_bits -= n;
+    return value;
+}
+
+// The n-bit magnitude category's value: low codes are negative (F.12).
+static int Extend(unsigned int value, int n)
+{
+    return (n == 0) ? 0 : (value < (1u << (n - 1))) ? (int)value - (1 << n) + 1 : (int)value;
+}
+
+static int DecodeSymbol(JpegDecoder *jpeg, const HuffmanTable *table)
+{
+    if (jpeg->n_bits < 16) FillBits(jpeg);
+
+    unsigned int entry = table->lookup[jpeg->bits >> (64 - HUFFMAN_LOOKAHEAD)];
+    if (entry != 0)
+    {
+        jpeg->bits <<= entry >> 8;
+        jpeg->n_bits -= entry >> 8;
+        return entry & 0xFF;
+    }
+
+    uint32_t code16 = (uint32_t)(jpeg->bits >> 48);
+    for (int length = HUFFMAN_LOOKAHEAD + 1; length <= 16; length++)
+    {
+        int32_t code = (int32_t)(code16 >> (16 - length));
+        if (code <= table->max_code[length])
+        {
+            jpeg->bits <<= length;
+            jpeg->n_bits -= length;
+            return table->symbols[(code + table->offset[length]) & 0xFF];
+        }
+    }
+
+    jpeg->error = true;     // No such code
+    return 0;
+}
+
+/* Marker segments */
+//----------------------------------------------------------------------------------
+static bool ParseQuantTables(JpegDecoder *jpeg, const unsigned char *p, int length)
+{
+    while (length > 0)
+    {
+        int precision = p[0] >> 4, id = p[0] & 15;
+        int table_length = 1 + 64 * (precision + 1);
+        if (precision > 1 || id >= MAX_TABLES || table_length > length) return false;
+
+        for (int k = 0; k < 64; k++)
+        {
+            jpeg->quant[id][zigzag[k]] = precision ? (uint16_t)ReadU16BE(p + 1 + 2 * k) : p[1 + k];
+        }
+        p += table_length;
+        length -= table_length;
+    }
+    return true;
+}
+
+static bool BuildHuffmanTable(HuffmanTable *table, const unsigned char *counts, const unsigned char *symbols, int n_symbols)
+{
+    memset(table, 0, sizeof(HuffmanTable));
+    memcpy(table->symbols, symbols, n_symbols);
+
+    int32_t code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; length++)
+    {
+        table->offset[length] = k - code;
+        for (int i = 0; i < counts[length - 1]; i++, k++, code++)
+        {
+            if (code >= (1 << length)) return false;   // Over-subscribed
+            if (length <= HUFFMAN_LOOKAHEAD)
+            {
+                int first = code << (HUFFMAN_LOOKAHEAD - length), n = 1 << (HUFFMAN_LOOKAHEAD - length);
+                for (int j = 0; j < n; j++) table->lookup[first + j] = (uint16_t)(length << 8 | symbols[k]);
+            }
+        }
+        table->max_code[length] = (counts[length - 1] > 0) ? code - 1 : -1;
+        code <<= 1;
+    }
+    return true;
+}
+
+static bool ParseHuffmanTables(JpegDecoder *jpeg, const unsigned char *p, int length)
+{
+    while (length >= 17)
+    {
+        int table_class = p[0] >> 4, id = p[0] & 15;
+        int n_symbols = 0;
+        for (int i = 0; i < 16; i++) n_symbols += p[1 + i];
+        if (table_class > 1 || id >= MAX_TABLES || n_symbols > 256 || 17 + n_symbols > length) return false;
+
+        HuffmanTable *table = table_class ? &jpeg->ac[id] : &jpeg->dc[id];
+        if (!BuildHuffmanTable(table, p + 1, p + 17, n_symbols)) return false;
+        if (table_class) jpeg->has_ac[id] = true;
+        else jpeg->has_dc[id] = true;
+
+        p += 17 + n_symbols;
+        length -= 17 + n_symbols;
+    }
+    return length == 0;
+}
+
+static bool ParseFrame(JpegDecoder *jpeg, const unsigned char *p, int length, int min_width, int min_height)
+{
+    if (jpeg->frame || length < 6) return false;
+
+    jpeg->height = ReadU16BE(p + 1);
+    jpeg->width = ReadU16BE(p + 3);
+    jpeg->n_components = p[5];
+    if (p[0] != 8 || jpeg->width == 0 || jpeg->height == 0) return false;  // 12-bit, or the height comes in a DNL marker
+    if ((jpeg->n_components != 1 && jpeg->n_components != 3) || length < 6 + 3 * jpeg->n_components) return false;
+
+    jpeg->max_h = jpeg->max_v = 1;
+    for (int c = 0; c < jpeg->n_components; c++)
+    {
+        JpegComponent *component = &jpeg->components[c];
+        component->id = p[6 + 3 * c];
+        component->h = p[7 + 3 * c] >> 4;
+        component->v = p[7 + 3 * c] & 15;
+        component->quant = p[8 + 3 * c];
+        if (component->h < 1 || component->h > MAX_SAMPLING || component->v < 1 || component->v > MAX_SAMPLING || component->quant >= MAX_TABLES) return false;
+        if (component->h > jpeg->max_h) jpeg->max_h = component->h;
+        if (component->v > jpeg->max_v) jpeg->max_v = component->v;
+    }
+
+    // Smallest scale that still covers the requested size
+    jpeg->scale_shift = 0;
+    while (jpeg->scale_shift < 3 && (ScaledSize(jpeg->width, jpeg->scale_shift) < min_width || ScaledSize(jpeg->height, jpeg->scale_shift) < min_height))
+    {
+        jpeg->scale_shift++;
+    }
+    if ((int64_t)ScaledSize(jpeg->width, jpeg->scale_shift) * ScaledSize(jpeg->height, jpeg->scale_shift) > JPEG_MAX_PIXELS) return false;
+
+    jpeg->mcus_x = (jpeg->width + BLOCK_SIZE * jpeg->max_h - 1) / (BLOCK_SIZE * jpeg->max_h);
+    jpeg->mcus_y = (jpeg->height + BLOCK_SIZE * jpeg->max_v - 1) / (BLOCK_SIZE * jpeg->max_v);
+
+    for (int c = 0; c < jpeg->n_components; c++)
+    {
+        JpegComponent *component = &jpeg->components[c];
+
+        // Output samples per block of this component, if it were upsampled all the way in the IDCT
+        int ratio_x = Log2(jpeg->max_h / component->h), ratio_y = Log2(jpeg->max_v / component->v);
+        if (jpeg->max_h % component->h != 0 || jpeg->max_v % component->v != 0 || ratio_x < 0 || ratio_y < 0) return false;
+
+        int shift_x = jpeg->scale_shift + ratio_x, shift_y = jpeg->scale_shift + ratio_y;
+        component->size_shift_x = (shift_x > 3) ? 3 : shift_x;
+        component->size_shift_y = (shift_y > 3) ? 3 : shift_y;
+        component->repeat_shift_x = shift_x - component->size_shift_x;
+        component->repeat_shift_y = shift_y - component->size_shift_y;
+
+        component->stride = (jpeg->mcus_x * component->h) << component->size_shift_x;
+        component->rows = (jpeg->mcus_y * component->v) << component->size_shift_y;
+        component->plane = calloc((size_t)component->stride * component->rows, 1);
+        if (component->plane == NULL) return false;
+    }
+
+    jpeg->frame = true;
+    return true;
+}
+
+/* Scans */
+//----------------------------------------------------------------------------------
+static void DecodeBlock(JpegDecoder *jpeg, JpegComponent *component, int block_x, int block_y)
+{
+    int size_x = 1 << component->size_shift_x, size_y = 1 << component->size_shift_y;
+    const uint16_t *quant = jpeg->quant[component->quant];
+    float coefficients[BLOCK_SIZE][BLOCK_SIZE];
+    for (int v = 0; v < size_y; v++)
+    {
+        for (int u = 0; u < size_x; u++) coefficients[v][u] = 0.0f;
+    }
+
+    int category = DecodeSymbol(jpeg, &jpeg->dc[component->dc_table]);
+    if (category > MAX_DC_CATEGORY)
+    {
+        jpeg->error = true;
+        return;
+    }
+    component->dc_prediction += Extend(GetBits(jpeg, category), category);
+    if (component->dc_prediction < -MAX_DC_VALUE || component->dc_prediction > MAX_DC_VALUE)
+    {
+        jpeg->error = true;
+        return;
+    }
+    coefficients[0][0] = (float)(component->dc_prediction * quant[0]);
+
+    const HuffmanTable *ac = &jpeg->ac[component->ac_table];
+    for (int k = 1; k < 64; k++)
+    {
+        int symbol = DecodeSymbol(jpeg, ac);
+        int run = symbol >> 4, size = symbol & 15;
+        if (size == 0)
+        {
+            if (run != 15) break;   // End of block
+            k += 15;
+            continue;
+        }
+
+        k += run;
+        if (k > 63)
+        {
+            jpeg->error = true;
+            return;
+        }
+
+        unsigned int bits = GetBits(jpeg, size);
+        int row = zigzag[k] >> 3, column = zigzag[k] & 7;
+        if (row < size_y && column < size_x) coefficients[row][column] = (float)(Extend(bits, size) * quant[zigzag[k]]);
+    }
+
+    // Columns, then rows, of the size_x x size_y inverse DCT
+    float (*basis_x)[BLOCK_SIZE] = idct_basis[component->size_shift_x];
+    float (*basis_y)[BLOCK_SIZE] = idct_basis[component->size_shift_y];
+    float columns[BLOCK_SIZE][BLOCK_SIZE];
+    for (int y = 0; y < size_y; y++)
+    {
+        for (int u = 0; u < size_x; u++)
+        {
+            float sum = 0.0f;
+            for (int v = 0; v < size_y; v++) sum += basis_y[y][v] * coefficients[v][u];
+            columns[y][u] = sum;
+        }
+    }
+
+    unsigned char *out = component->plane + (size_t)(block_y << component->size_shift_y) * component->stride + (block_x << component->size_shift_x);
+    for (int y = 0; y < size_y; y++, out += component->stride)
+    {
+        for (int x = 0; x < size_x; x++)
+        {
+            float sum = 128.0f;
+            for (int u = 0; u < size_x; u++) sum += basis_x[x][u] * columns[y][u];
+            out[x] = ClampSample(sum);
+        }
+    }
+}
+
+// Skips to the RSTn marker that should follow and resets the predictions.
+static void Restart(JpegDecoder *jpeg, JpegComponent **scan, int n_scan)
+{
+    if (ReadPastData(jpeg)) jpeg->error = true;
+    ResetBits(jpeg);
+    while (jpeg->pos + 1 < jpeg->end && !(jpeg->pos[0] == 0xFF && jpeg->pos[1] >= MARKER_RST0 && jpeg->pos[1] <= MARKER_RST7))
+    {
+        if (jpeg->pos[0] == 0xFF && jpeg->pos[1] != 0x00 && jpeg->pos[1] != 0xFF) return;    // Another marker: the data ends early
+        jpeg->pos++;
+    }
+    if (jpeg->pos + 1 < jpeg->end) jpeg->pos += 2;
+
+    for (int i = 0; i < n_scan; i++) scan[i]->dc_prediction = 0;
+}
+
+static bool DecodeScan(JpegDecoder *jpeg, const unsigned char *p, int length)
+{
+    int n_scan = p[0];
+    if (!jpeg->frame || n_scan < 1 || n_scan > jpeg->n_components || length < 4 + 2 * n_scan) return false;
+
+    JpegComponent *scan[JPEG_MAX_COMPONENTS];
+    for (int i = 0; i < n_scan; i++)
+    {
+        int id = p[1 + 2 * i], dc = p[2 + 2 * i] >> 4, ac = p[2 + 2 * i] & 15;
+        scan[i] = NULL;
+        for (int c = 0; c < jpeg->n_components; c++)
+        {
+            if (jpeg->components[c].id == id) scan[i] = &jpeg->components[c];
+        }
+        if (scan[i] == NULL || dc >= MAX_TABLES || ac >= MAX_TABLES || !jpeg->has_dc[dc] || !jpeg->has_ac[ac]) return false;
+        scan[i]->dc_table = dc;
+        scan[i]->ac_table = ac;
+        scan[i]->dc_prediction = 0;
+    }
+
+    const unsigned char *selection = p + 1 + 2 * n_scan;
+    if (selection[0] != 0 || selection[1] != 63 || selection[2] != 0) return false;    // Spectral selection or successive approximation
+
+    jpeg->pos = p + length;
+    ResetBits(jpeg);
+
+    // A single-component scan isn't interleaved: it covers that component's own blocks, one per MCU.
+    int n_mcus_x = jpeg->mcus_x, n_mcus_y = jpeg->mcus_y;
+    if (n_scan == 1)
+    {
+        const JpegComponent *only = scan[0];
+        n_mcus_x = ((jpeg->width * only->h + jpeg->max_h - 1) / jpeg->max_h + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        n_mcus_y = ((jpeg->height * only->v + jpeg->max_v - 1) / jpeg->max_v + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    }
+
+    int n_mcus = n_mcus_x * n_mcus_y;
+    for (int mcu = 0; mcu < n_mcus && !jpeg->error; mcu++)
+    {
+        int mcu_x = mcu % n_mcus_x, mcu_y = mcu / n_mcus_x;
+
+        if (n_scan == 1) DecodeBlock(jpeg, scan[0], mcu_x, mcu_y);
+        else
+        {
+            for (int i = 0; i < n_scan; i++)
+            {
+                JpegComponent *component = scan[i];
+                for (int by = 0; by < component->v; by++)
+                {
+                    for (int bx = 0; bx < component->h; bx++) DecodeBlock(jpeg, component, mcu_x * component->h + bx, mcu_y * component->v + by);
+                }
+            }
+        }
+
+        if (jpeg->restart_interval > 0 && (mcu + 1) % jpeg->restart_interval == 0 && mcu + 1 < n_mcus) Restart(jpeg, scan, n_scan);
+    }
+
+    if (ReadPastData(jpeg)) jpeg->error = true;
+    for (int i = 0; i < n_scan; i++) scan[i]->scanned = true;
+    return !jpeg->error;
+}
+
+/* Color conversion */
+//----------------------------------------------------------------------------------
+#define YCC_SHIFT 16
+#define YCC_ROUND (1 << (YCC_SHIFT - 1))
+#define YCC_FIXED(x) ((int)((x) * (1 << YCC_SHIFT) + 0.5))
+
+static unsigned char ClampByte(int value)
+{
+    return (unsigned char)((value < 0) ? 0 : (value > 255) ? 255 : value);
+}
+
+static void ConvertToImage(const JpegDecoder *jpeg, Image *image)
+{
+    int width = image->width, height = image->height;
+    unsigned char *out = image->data;
+
+    if (jpeg->n_components == 1)
+    {
+        const JpegComponent *gray = &jpeg->components[0];
+        for (int y = 0; y < height; y++) memcpy(out + (size_t)y * width, gray->plane + (size_t)y * gray->stride, width);
+        return;
+    }
+
+    // RGB stored as is when an Adobe segment says so, or, failing a JFIF or Adobe segment, the component ids spell it out
+    bool rgb = (jpeg->adobe_transform == 0) ||
+               (jpeg->adobe_transform < 0 && !jpeg->jfif && jpeg->components[0].id == 'R' && jpeg->components[1].id == 'G' && jpeg->components[2].id == 'B');
+
+    const JpegComponent *c0 = &jpeg->components[0], *c1 = &jpeg->components[1], *c2 = &jpeg->components[2];
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *row0 = c0->plane + (size_t)(y >> c0->repeat_shift_y) * c0->stride;
+        const unsigned char *row1 = c1->plane + (size_t)(y >> c1->repeat_shift_y) * c1->stride;
+        const unsigned char *row2 = c2->plane + (size_t)(y >> c2->repeat_shift_y) * c2->stride;
+
+        for (int x = 0; x < width; x++, out += 3)
+        {
+            int s0 = row0[x >> c0->repeat_shift_x], s1 = row1[x >> c1->repeat_shift_x], s2 = row2[x >> c2->repeat_shift_x];
+            if (rgb)
+            {
+                out[0] = (unsigned char)s0;
+                out[1] = (unsigned char)s1;
+                out[2] = (unsigned char)s2;
+                continue;
+            }
+
+            // JFIF YCbCr, full range
+            int luma = (s0 << YCC_SHIFT) + YCC_ROUND, cb = s1 - 128, cr = s2 - 128;
+            out[0] = ClampByte((luma + YCC_FIXED(1.402) * cr) >> YCC_SHIFT);
+            out[1] = ClampByte((luma - YCC_FIXED(0.344136) * cb - YCC_FIXED(0.714136) * cr) >> YCC_SHIFT);
+            out[2] = ClampByte((luma + YCC_FIXED(1.772) * cb) >> YCC_SHIFT);
+        }
+    }
+}
+
+/* Module functions */
+//----------------------------------------------------------------------------------
+bool IsJpegData(const unsigned char *data, int size)
+{
+    return data != NULL && size >= 4 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+Image LoadJpegScaled(const unsigned char *data, int size, int min_width, int min_height)
+{
+    Image image = { 0 };
+    if (!IsJpegData(data, size)) return image;
+
+    pthread_once(&basis_once, BuildIdctBasis);
+
+    JpegDecoder *jpeg = calloc(1, sizeof(JpegDecoder));     // ~10 KB of tables, kept off the worker's stack
+    if (jpeg == NULL) return image;
+    jpeg->adobe_transform = -1;
+    jpeg->end = data + size;
+
+    const unsigned char *pos = data + 2, *end = data + size;
+    bool ok = true;
+    while (ok)
+    {
+        while (pos < end && *pos != 0xFF) pos++;
+        while (pos < end && *pos == 0xFF) pos++;    // Fill bytes
+        if (pos >= end) break;
+
+        int marker = *pos++;
+        if (marker == MARKER_EOI) break;
+        if (marker == 0x00 || marker == 0x01 || (marker >= MARKER_RST0 && marker <= MARKER_RST7)) continue;    // No segment (or stuffed data after a scan)
+
+        if (end - pos < 2) break;
+        int length = ReadU16BE(pos);
+        if (length < 2 || length > end - pos)
+        {
+            ok = false;
+            break;
+        }
+        const unsigned char *segment = pos + 2;
+        int segment_length = length - 2;
+
+        switch (marker)
+        {
+            case MARKER_DQT: ok = ParseQuantTables(jpeg, segment, segment_length); break;
+            case MARKER_DHT: ok = ParseHuffmanTables(jpeg, segment, segment_length); break;
+            case MARKER_DRI: ok = (segment_length >= 2); if (ok) jpeg->restart_interval = ReadU16BE(segment); break;
+            case MARKER_SOF0:
+            case MARKER_SOF1: ok = ParseFrame(jpeg, segment, segment_length, min_width, min_height); break;
+            case MARKER_APP0: jpeg->jfif |= (segment_length >= 5 && memcmp(segment, "JFIF", 5) == 0); break;
+            case MARKER_APP14: if (segment_length >= 12 && memcmp(segment, "Adobe", 5) == 0) jpeg->adobe_transform = segment[11]; break;
+            case MARKER_SOS:
+            {
+                ok = (segment_length >= 1) && DecodeScan(jpeg, segment, segment_length);
+                pos = jpeg->pos;    // Past the entropy-coded data
+                continue;
+            }
+            default:
+            {
+                // Any other frame type: progressive, lossless, arithmetic coded
+                if ((marker & 0xF0) == 0xC0 && marker != 0xC8 && marker != 0xCC) ok = false;
+            } break;
+        }
+        pos += length;
+    }
+
+    // Every component must have come in a scan, or its plane is still blank
+    for (int c = 0; c < jpeg->n_components; c++) ok &= jpeg->components[c].scanned;
+    if (ok && jpeg->frame)
+    {
+        image.width = ScaledSize(jpeg->width, jpeg->scale_shift);
+        image.height = ScaledSize(jpeg->height, jpeg->scale_shift);
+        image.mipmaps = 1;
+        image.format = (jpeg->n_components == 1) ? PIXELFORMAT_UNCOMPRESSED_GRAYSCALE : PIXELFORMAT_UNCOMPRESSED_R8G8B8;
+        image.data = RL_MALLOC((size_t)image.width * image.height * jpeg->n_components);
+
+        if (image.data != NULL) ConvertToImage(jpeg, &image);
+        else image = (Image){ 0 };
+    }
+
+    for (int c = 0; c < JPEG_MAX_COMPONENTS; c++) free(jpeg->components[c].plane);
+    free(jpeg);
+
+    return image;
+}
@@ -5,11 +5,27 @@
 #include <float.h>
 #include <time.h>
 #include <math.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "raylib.h"
 #include "kmeans.h"
+#include "oklab.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define KMEANS_X86
+#include <immintrin.h>
+#endif
 
 #define MAX_ITERATION 50
+#define ASSIGN_BLOCK 256        // Points assigned before their sums are accumulated (stays in L1)
+#define MIN_POINTS_PER_THREAD (64 * ASSIGN_BLOCK)  // Fewer and the wake-ups cost more than the work
+#define CACHE_LINE_INT64 8      // Partial sums of different threads never share a cache line
+#define MINIBATCH_MAX_BATCHES 500
+#define MINIBATCH_PATIENCE 3    // Batches in a row under the tolerance that end an epoch
+#define MINIBATCH_EPOCHS 4      // The counts restart at each new epoch
+#define MINIBATCH_INIT_SAMPLE (16 * KMEANS_MINIBATCH_SIZE)  // Random points the mini-batch centroids are initialized from
+#define BOUND_SLACK 1e-9        // Margin for rounding in the Hamerly bounds; a point is only skipped when it strictly keeps its cluster
 
 
 /*
@@ -25,58 +41,394 @@
  * en.wikipedia.org/wiki/K-means_clustering
  * hackernoon.com/learn-k-means-clustering-by-quantizing-color-images-in-python
  * neptune.ai/blog/k-means-clustering
+ * -----------------------------------------------------------
+ * Points are kept as separate r, g, b planes (ColorPlanes), so the
+ * nearest-centroid search can load 8 or 16 points of one channel at once:
+ * SSE2 handles 8 points per step, AVX2 (picked at run time) 16. All three
+ * assignment kernels do the same integer math and break ties towards the
+ * lower cluster index, so their results are identical.
+ *
+ * With KMeansOptions.threads > 1 the points are split into contiguous
+ * ranges, one per thread, and each range gets its own partial sums. The
+ * ranges depend only on the point count and thread count asked for, and the
+ * partials are added up in range order with integer math, so the palette is
+ * bit-identical for any number of threads.
+ *
+ * KMEANS_HAMERLY (Hamerly, "Making k-means even faster", 2010) keeps, per
+ * point, an upper bound on the distance to its centroid and a lower bound on
+ * the distance to any other one, moved by how far the centroids moved. A
+ * point whose upper bound is below its lower bound, or below half the gap
+ * from its centroid to the nearest other centroid, cannot change cluster and
+ * is skipped; its contribution stays in the running sums, which are only
+ * updated for points that move. Skips need a strict inequality, so no tie
+ * is decided differently and the palette is the same as with KMEANS_LLOYD.
+ * Elkan's variant keeps one lower bound per centroid, which only pays off
+ * for far more clusters than a palette has.
+ *
+ * Initialization keeps each point's distance to its nearest chosen centroid
+ * and only compares it against the newest one, so picking k centroids costs
+ * O(n * k). Random draws come from a splitmix64 generator owned by the call,
+ * so a given KMeansOptions.seed always gives the same palette.
+ *
+ * KMEANS_MINIBATCH (Sculley, "Web-scale k-means clustering", 2010) never
+ * passes over every point: centroids are initialized from a random sample,
+ * then each batch of random points is assigned with the usual kernels and
+ * pulls its centroids towards it with a per-centroid learning rate of
+ * 1 / (points seen so far). An epoch ends once no centroid has moved
+ * further than the tolerance for MINIBATCH_PATIENCE batches in a row; the
+ * counts then restart, and the run stops after MINIBATCH_EPOCHS epochs.
+ *
+ * With KMEANS_OKLAB the points (pixels, or the histogram's bins) are first
+ * converted to 8-bit OKLab planes, where plain squared differences are
+ * perceptual distances; everything above runs on them unchanged, and the
+ * centroids are converted back to sRGB at the end.
 */
 
+typedef struct
+{
+    uint64_t state;
+} KMeansRng;
+
+typedef void (*AssignKernel)(const ColorPlanes *points, int start, int count, const int *centroids, int n_cluster, int *assignments);
+
+typedef struct AssignPool AssignPool;
+
+typedef struct
+{
+    int *assignments;           // Per point: its cluster
+    double *upper;              // Per point: at least the distance to its centroid
+    double *lower;              // Per point: at most the distance to any other centroid
+    double *moved;              // Per centroid: how far the last update moved it
+    double *half_gap;           // Per centroid: half the distance to the nearest other centroid
+    double max_moved;
+    double second_moved;        // Largest movement among the other centroids, for points of the farthest mover
+    int farthest_mover;
+    bool initialized;           // Bounds and running sums are set; false for the first pass
+} HamerlyBounds;
+
+typedef struct
+{
+    AssignPool *pool;
+    const ColorPlanes *points;
+    const int *weights;
+    const int *centroids;
+    int n_cluster;
+    AssignKernel assign;
+    int start;                  // Points [start, end)
+    int end;
+    int64_t *sums;              // r, g, b sums per cluster followed by the cluster sizes
+    HamerlyBounds *bounds;      // NULL for plain Lloyd passes
+    int64_t evaluations;        // Distances computed in the last pass
+} AssignTask;
+
+struct AssignPool
+{
+    pthread_t threads[KMEANS_MAX_THREADS];
+    int n_threads;              // Helpers running; the calling thread runs every task they don't
+    AssignTask *tasks;
+    int n_tasks;
+    pthread_mutex_t lock;
+    pthread_cond_t start;       // Broadcast when an iteration is posted or on shutdown
+    pthread_cond_t done;        // Signalled when the last helper finishes its range
+    unsigned int generation;    // Iterations posted so far
+    int pending;                // Helpers still working on the current iteration
+    bool quit;
+};
+
+static void lloydIterations(const ColorPlanes *points, const int *weights, int *centroids, int n_cluster, AssignKernel assign, KMeansOptions options);
+static void miniBatchIterations(const ColorPlanes *points, const int *weights, int *centroids, int n_cluster, AssignKernel assign, KMeansOptions options, KMeansRng *rng);
+static double maxCentroidMovement(const double *from, const double *to, int n_cluster);
+static void initializeCentroidsFromSample(int *centroids, int first_point, const ColorPlanes *points, int n_cluster, KMeansInit init, KMeansRng *rng, Arena *arena);
+static void assignRange(AssignTask *task);
+static void assignRangeHamerly(AssignTask *task);
+static void updateHamerlyBounds(HamerlyBounds *bounds, const int *old_centroids, const int *centroids, int n_cluster);
+static void startAssignPool(AssignPool *pool, AssignTask *tasks, int n_tasks);
+static void runAssignPool(AssignPool *pool);
+static void stopAssignPool(AssignPool *pool);
+static int buildColorHistogram(const ColorPlanes *points, int bits, int pixel, ColorPlanes *unique_colors, int **weights, int *pixel_bin, Arena *arena);
+static void initializeCentroids(int *centroids, int first_point, const ColorPlanes *points, const int *weights, int n_cluster, KMeansInit init, KMeansRng *rng, Arena *arena);
+static KMeansRng seedRandom(uint64_t seed);
+static uint64_t nextRandom(KMeansRng *rng);
+static int randomIndex(KMeansRng *rng, int count);
+static AssignKernel selectAssignKernel(bool scalar);
+static bool allocColorPlanes(ColorPlanes *planes, int count, Arena *arena);
+static void assignScalar(const ColorPlanes *points, int start, int count, const int *centroids, int n_cluster, int *assignments);
+
 void getDominantColors(int n_points, Color *image_color_data, Color *dominant_colors, int n_cluster)
 {
-    // Initialize cluster lists.
-    int **cluster_lists = malloc(n_cluster * sizeof(int*));
-    int **centroids     = malloc(n_cluster * sizeof(int*));
+    getDominantColorsEx(n_points, image_color_data, dominant_colors, n_cluster, KMEANS_DEFAULT_OPTIONS);
+}
 
-    int *cluster_size      = malloc(n_cluster * sizeof(int));
-    int *prev_cluster_size = malloc(n_cluster * sizeof(int));
+void getDominantColorsEx(int n_points, Color *image_color_data, Color *dominant_colors, int n_cluster, KMeansOptions options)
+{
+    ColorPlanes planes = { 0 };
+    if (!allocColorPlanes(&planes, n_points, options.arena)) {
+        return;
+    }
 
-    for (int cluster = 0; cluster < n_cluster; cluster++) {
-        centroids[cluster]     = malloc(3 * sizeof(int));
-        cluster_lists[cluster] = malloc(n_points * sizeof(int));
+    for (int point = 0; point < n_points; point++) {
+        planes.r[point] = image_color_data[point].r;
+        planes.g[point] = image_color_data[point].g;
+        planes.b[point] = image_color_data[point].b;
     }
 
-    InitializeCentroid(centroids, n_points, image_color_data, n_cluster);
+    getDominantColorsFromPlanes(planes, dominant_colors, n_cluster, options);
+    UnloadColorPlanes(&planes);
+}
 
-    int iterate = 1;                // Stopping criterion.
-    int iteration = 0;
+void getDominantColorsFromPlanes(ColorPlanes planes, Color *dominant_colors, int n_cluster, KMeansOptions options)
+{
+    if (planes.count <= 0) {
+        return;
+    }
 
-    while (iterate && iteration < MAX_ITERATION) {
-        memset(cluster_size, 0, n_cluster * sizeof(int));
+    int *centroids = ScratchAlloc(options.arena, n_cluster * 3 * sizeof(int));     // r, g, b per cluster
+    if (centroids == NULL) {
+        return;
+    }
 
-        for (int cluster = 0; cluster < n_cluster; cluster++) {
-            memset(cluster_lists[cluster], 0, n_points * sizeof(int));
+    AssignKernel assign = selectAssignKernel(options.scalar);
+    ColorPlanes unique_colors = { 0 };
+    int *weights = NULL;
+    int n_unique = 0, first_bin = 0;
+
+    /* Initialize 1st centroid randomly */
+    KMeansRng rng = seedRandom(options.seed);
+    int c1_random_index = randomIndex(&rng, planes.count);
+
+    if (options.histogram_bits > 0) {
+        n_unique = buildColorHistogram(&planes, options.histogram_bits, c1_random_index, &unique_colors, &weights, &first_bin, options.arena);
+    }
+
+    // Weighted Lloyd iterations over the occupied bins: as if every pixel of a bin had the bin's mean color.
+    const ColorPlanes *points = (n_unique > 0) ? &unique_colors : &planes;
+
+    ColorPlanes oklab_points = { 0 };
+    if (options.color_space == KMEANS_OKLAB) {
+        if (!LoadOklabPlanes(points, &oklab_points, options.arena)) {
+            UnloadColorPlanes(&unique_colors);
+            ScratchFree(options.arena, weights);
+            ScratchFree(options.arena, centroids);
+            return;
         }
+        points = &oklab_points;
+    }
 
-        for (int point = 0; point < n_points; point++) {
-            int cluster_id = 0;
+    if (n_unique > 0) {
+        // Seeded from the bin of the same random pixel, so both modes start from (nearly) the same centroids.
+        initializeCentroids(centroids, first_bin, points, weights, n_cluster, options.init, &rng, options.arena);
+    } else if (options.algorithm == KMEANS_MINIBATCH) {
+        initializeCentroidsFromSample(centroids, c1_random_index, points, n_cluster, options.init, &rng, options.arena);
+    } else {
+        initializeCentroids(centroids, c1_random_index, points, NULL, n_cluster, options.init, &rng, options.arena);
+    }
 
-            int min_distance = INT_MAX;
+    if (options.algorithm == KMEANS_MINIBATCH) {
+        miniBatchIterations(points, weights, centroids, n_cluster, assign, options, &rng);
+    } else {
+        lloydIterations(points, weights, centroids, n_cluster, assign, options);
+    }
 
-            for (int cluster = 0; cluster < n_cluster; cluster++) {
+    for (int cluster = 0; cluster < n_cluster; cluster++) {
+        Color color = (Color) {
+            centroids[3 * cluster + 0], centroids[3 * cluster + 1], centroids[3 * cluster + 2], 255
+        };
+        if (options.color_space == KMEANS_OKLAB) {
+            color = OklabToColor(centroids[3 * cluster + 0], centroids[3 * cluster + 1], centroids[3 * cluster + 2]);
+        }
+        dominant_colors[cluster] = color;
+    }
 
-                Color color = (Color) {
-                    centroids[cluster][0], centroids[cluster][1], centroids[cluster][2], 255
-                };
+    UnloadColorPlanes(&oklab_points);
+    UnloadColorPlanes(&unique_colors);
+    ScratchFree(options.arena, weights);
+    ScratchFree(options.arena, centroids);
+}
 
-                int color_diff = distanceSquared(&color, &image_color_data[point]);
+static bool allocColorPlanes(ColorPlanes *planes, int count, Arena *arena)
+{
+    // One block for the three planes.
+    unsigned char *block = ScratchAlloc(arena, 3 * (size_t)count + 1);
+    if (block == NULL) {
+        return false;
+    }
 
-                if (color_diff < min_distance) {
-                    min_distance = color_diff;
-                    cluster_id   = cluster;
-                }
+    planes->r = block;
+    planes->g = block + count;
+    planes->b = block + 2 * (size_t)count;
+    planes->count = count;
+    planes->arena = arena;
+    return true;
+}
+
+bool LoadColorPlanes(Image image, ColorPlanes *planes, Arena *arena)
+{
+    /*
+     * Read the pixels straight from the image buffer for the 8-bit formats
+     * covers decode to; anything else goes through LoadImageColors() once.
+     */
+    int n_points = image.width * image.height;
+    if (image.data == NULL || n_points <= 0 || !allocColorPlanes(planes, n_points, arena)) {
+        return false;
+    }
+
+    const unsigned char *pixels = image.data;
+
+    switch (image.format) {
+        case PIXELFORMAT_UNCOMPRESSED_R8G8B8A8:
+            for (int point = 0; point < n_points; point++) {
+                planes->r[point] = pixels[4 * point + 0];
+                planes->g[point] = pixels[4 * point + 1];
+                planes->b[point] = pixels[4 * point + 2];
+            }
+            break;
+        case PIXELFORMAT_UNCOMPRESSED_R8G8B8:
+            for (int point = 0; point < n_points; point++) {
+                planes->r[point] = pixels[3 * point + 0];
+                planes->g[point] = pixels[3 * point + 1];
+                planes->b[point] = pixels[3 * point + 2];
+            }
+            break;
+        case PIXELFORMAT_UNCOMPRESSED_GRAYSCALE:
+        case PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA: {
+            int stride = (image.format == PIXELFORMAT_UNCOMPRESSED_GRAYSCALE) ? 1 : 2;
+            for (int point = 0; point < n_points; point++) {
+                planes->r[point] = planes->g[point] = planes->b[point] = pixels[stride * point];
+            }
+            break;
+        }
+        default: {
+            Color *colors = LoadImageColors(image);
+            if (colors == NULL) {
+                UnloadColorPlanes(planes);
+                return false;
+            }
+            for (int point = 0; point < n_points; point++) {
+                planes->r[point] = colors[point].r;
+                planes->g[point] = colors[point].g;
+                planes->b[point] = colors[point].b;
             }
+            UnloadImageColors(colors);
+            break;
+        }
+    }
+
+    return true;
+}
+
+void UnloadColorPlanes(ColorPlanes *planes)
+{
+    ScratchFree(planes->arena, planes->r);    // g and b share the block
+    memset(planes, 0, sizeof(ColorPlanes));
+}
+
+static void lloydIterations(const ColorPlanes *points, const int *weights, int *centroids, int n_cluster, AssignKernel assign, KMeansOptions options)
+{
+    /*
+     * One assignment per point, plus running sums and counts per cluster that
+     * are accumulated block by block right behind the assignment kernel: each
+     * iteration is a single pass over the points, with nothing allocated or
+     * cleared per point. A point's weight counts it that many times (1 when
+     * weights is NULL).
+     */
+    int n_points = points->count;
+
+    // As many ranges as threads asked for, as long as each gets enough points.
+    int threads = options.threads;
+    int n_tasks = (threads < 1) ? 1 : (threads > KMEANS_MAX_THREADS) ? KMEANS_MAX_THREADS : threads;
+    if (n_tasks > n_points / MIN_POINTS_PER_THREAD) {
+        n_tasks = (n_points / MIN_POINTS_PER_THREAD > 1) ? n_points / MIN_POINTS_PER_THREAD : 1;
+    }
+    int stride = (4 * n_cluster + CACHE_LINE_INT64 - 1) / CACHE_LINE_INT64 * CACHE_LINE_INT64;
+
+    AssignTask *tasks          = ScratchCalloc(options.arena, n_tasks, sizeof(AssignTask));
+    int64_t *partials          = ScratchAlloc(options.arena, (size_t)n_tasks * stride * sizeof(int64_t));
+    int64_t *sums              = ScratchAlloc(options.arena, n_cluster * 3 * sizeof(int64_t));
+    int64_t *cluster_size      = ScratchAlloc(options.arena, n_cluster * sizeof(int64_t));
+    int64_t *prev_cluster_size = ScratchCalloc(options.arena, n_cluster, sizeof(int64_t));
+    int *old_centroids         = ScratchAlloc(options.arena, n_cluster * 3 * sizeof(int));
+
+    HamerlyBounds bounds = { 0 };
+    bool hamerly = (options.algorithm == KMEANS_HAMERLY);
+    if (hamerly) {
+        bounds.assignments = ScratchAlloc(options.arena, n_points * sizeof(int));
+        bounds.upper    = ScratchAlloc(options.arena, n_points * sizeof(double));
+        bounds.lower    = ScratchAlloc(options.arena, n_points * sizeof(double));
+        bounds.moved    = ScratchAlloc(options.arena, n_cluster * sizeof(double));
+        bounds.half_gap = ScratchAlloc(options.arena, n_cluster * sizeof(double));
+    }
+    bool bounds_ready = !hamerly || (bounds.assignments != NULL && bounds.upper != NULL && bounds.lower != NULL && bounds.moved != NULL && bounds.half_gap != NULL);
+
+    if (tasks == NULL || partials == NULL || sums == NULL || cluster_size == NULL || prev_cluster_size == NULL ||
+        old_centroids == NULL || !bounds_ready) {
+        ScratchFree(options.arena, tasks);
+        ScratchFree(options.arena, partials);
+        ScratchFree(options.arena, sums);
+        ScratchFree(options.arena, cluster_size);
+        ScratchFree(options.arena, prev_cluster_size);
+        ScratchFree(options.arena, old_centroids);
+        ScratchFree(options.arena, bounds.assignments);
+        ScratchFree(options.arena, bounds.upper);
+        ScratchFree(options.arena, bounds.lower);
+        ScratchFree(options.arena, bounds.moved);
+        ScratchFree(options.arena, bounds.half_gap);
+        return;
+    }
+
+    // Whole blocks per range, so every range starts on an ASSIGN_BLOCK boundary.
+    int n_blocks = (n_points + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+    for (int task = 0; task < n_tasks; task++) {
+        int first_block = (int)((int64_t)n_blocks * task / n_tasks);
+        int last_block  = (int)((int64_t)n_blocks * (task + 1) / n_tasks);
 
-            cluster_lists[cluster_id][cluster_size[cluster_id]++] = point;
+        tasks[task] = (AssignTask) {
+            .points = points, .weights = weights, .centroids = centroids, .n_cluster = n_cluster,
+            .assign = assign,
+            .start = first_block * ASSIGN_BLOCK,
+            .end = (last_block * ASSIGN_BLOCK < n_points) ? last_block * ASSIGN_BLOCK : n_points,
+            .sums = partials + (size_t)task * stride,
+            .bounds = hamerly ? &bounds : NULL,
+        };
+    }
+
+    AssignPool pool = { 0 };
+    startAssignPool(&pool, tasks, n_tasks);
+
+    int iterate = 1;                // Stopping criterion.
+    int iteration = 0;
+    int64_t evaluations = 0;
+
+    while (iterate && iteration < MAX_ITERATION) {
+        if (hamerly && iteration > 0) {
+            updateHamerlyBounds(&bounds, old_centroids, centroids, n_cluster);
+        }
+        runAssignPool(&pool);
+        bounds.initialized = true;
+        memcpy(old_centroids, centroids, n_cluster * 3 * sizeof(int));
+
+        // Reduce the partial sums in range order.
+        memset(cluster_size, 0, n_cluster * sizeof(int64_t));
+        memset(sums, 0, n_cluster * 3 * sizeof(int64_t));
+
+        for (int task = 0; task < n_tasks; task++) {
+            const int64_t *partial = tasks[task].sums;
+            evaluations += tasks[task].evaluations;
+            for (int cluster = 0; cluster < n_cluster; cluster++) {
+                sums[3 * cluster + 0] += partial[3 * cluster + 0];
+                sums[3 * cluster + 1] += partial[3 * cluster + 1];
+                sums[3 * cluster + 2] += partial[3 * cluster + 2];
+                cluster_size[cluster] += partial[3 * n_cluster + cluster];
+            }
         }
 
+        // New centroid: mean of the cluster, or unchanged if it lost all its points.
         for (int cluster = 0; cluster < n_cluster; cluster++) {
-            NewCentroid(cluster_lists[cluster], centroids[cluster], cluster_size[cluster], image_color_data);
+            if (cluster_size[cluster] == 0) {
+                continue;
+            }
+            centroids[3 * cluster + 0] = (int)(sums[3 * cluster + 0] / cluster_size[cluster]);
+            centroids[3 * cluster + 1] = (int)(sums[3 * cluster + 1] / cluster_size[cluster]);
+            centroids[3 * cluster + 2] = (int)(sums[3 * cluster + 2] / cluster_size[cluster]);
         }
 
         int cluster_size_converge = 0;
@@ -91,32 +443,607 @@ void getDominantColors(int n_points, Color *image_color_data, Color *dominant_co
             iterate = 0;
         }
 
-        memcpy(prev_cluster_size, cluster_size, n_cluster * sizeof(int));
+        memcpy(prev_cluster_size, cluster_size, n_cluster * sizeof(int64_t));
         iteration++;
     }
 
-    free(cluster_size);
-    cluster_size = NULL;
-    free(prev_cluster_size);
-    prev_cluster_size = NULL;
+    stopAssignPool(&pool);
+
+    if (options.stats != NULL) {
+        options.stats->iterations = iteration;
+        options.stats->distance_evaluations = evaluations;
+        options.stats->distances_skipped = (int64_t)iteration * n_points * n_cluster - evaluations;
+    }
+
+    ScratchFree(options.arena, tasks);
+    ScratchFree(options.arena, partials);
+    ScratchFree(options.arena, sums);
+    ScratchFree(options.arena, cluster_size);
+    ScratchFree(options.arena, prev_cluster_size);
+    ScratchFree(options.arena, old_centroids);
+    ScratchFree(options.arena, bounds.assignments);
+    ScratchFree(options.arena, bounds.upper);
+    ScratchFree(options.arena, bounds.lower);
+    ScratchFree(options.arena, bounds.moved);
+    ScratchFree(options.arena, bounds.half_gap);
+}
+
+/* Assign the points of one range and accumulate its partial sums. */
+static void assignRange(AssignTask *task)
+{
+    if (task->bounds != NULL) {
+        assignRangeHamerly(task);
+        return;
+    }
+
+    const ColorPlanes *points = task->points;
+    int n_cluster = task->n_cluster;
+    int64_t *sums = task->sums;
+    int64_t *cluster_size = task->sums + 3 * n_cluster;
+
+    int assignments[ASSIGN_BLOCK];
+
+    memset(sums, 0, 4 * n_cluster * sizeof(int64_t));
+    task->evaluations = (int64_t)(task->end - task->start) * n_cluster;
+
+    for (int start = task->start; start < task->end; start += ASSIGN_BLOCK) {
+        int count = (task->end - start < ASSIGN_BLOCK) ? task->end - start : ASSIGN_BLOCK;
+        task->assign(points, start, count, task->centroids, n_cluster, assignments);
+
+        for (int point = start; point < start + count; point++) {
+            int cluster_id = assignments[point - start];
+            int weight = (task->weights != NULL) ? task->weights[point] : 1;
+
+            cluster_size[cluster_id] += weight;
+            sums[3 * cluster_id + 0] += (int64_t)weight * points->r[point];
+            sums[3 * cluster_id + 1] += (int64_t)weight * points->g[point];
+            sums[3 * cluster_id + 2] += (int64_t)weight * points->b[point];
+        }
+    }
+}
+
+/*
+ * Hamerly pass over one range. The first pass assigns every point and sets
+ * its bounds and the range's running sums; later passes only look at points
+ * whose bounds no longer prove they keep their cluster, and move the sums of
+ * those that change.
+ */
+static void assignRangeHamerly(AssignTask *task)
+{
+    const ColorPlanes *points = task->points;
+    const int *centroids = task->centroids;
+    HamerlyBounds *bounds = task->bounds;
+    int n_cluster = task->n_cluster;
+    int64_t *sums = task->sums;
+    int64_t *cluster_size = task->sums + 3 * n_cluster;
+    int64_t evaluations = 0;
+
+    if (!bounds->initialized) {
+        memset(sums, 0, 4 * n_cluster * sizeof(int64_t));
+    }
+
+    for (int point = task->start; point < task->end; point++) {
+        int old_id = bounds->initialized ? bounds->assignments[point] : -1;
+
+        if (old_id >= 0) {
+            bounds->upper[point] += bounds->moved[old_id];
+            bounds->lower[point] -= (old_id == bounds->farthest_mover) ? bounds->second_moved : bounds->max_moved;
+
+            double limit = (bounds->half_gap[old_id] > bounds->lower[point]) ? bounds->half_gap[old_id] : bounds->lower[point];
+            if (bounds->upper[point] + BOUND_SLACK < limit) {
+                continue;
+            }
+
+            // Tighten the upper bound with the exact distance before a full search.
+            int r = points->r[point] - centroids[3 * old_id + 0];
+            int g = points->g[point] - centroids[3 * old_id + 1];
+            int b = points->b[point] - centroids[3 * old_id + 2];
+            bounds->upper[point] = sqrt((double)(r*r + g*g + b*b));
+            evaluations++;
+
+            if (bounds->upper[point] + BOUND_SLACK < limit) {
+                continue;
+            }
+        }
+
+        // Nearest and second nearest centroid, ties to the lower index as in assignScalar().
+        int cluster_id = 0;
+        int min_distance = INT_MAX, second_distance = INT_MAX;
+
+        for (int cluster = 0; cluster < n_cluster; cluster++) {
+            int r = points->r[point] - centroids[3 * cluster + 0];
+            int g = points->g[point] - centroids[3 * cluster + 1];
+            int b = points->b[point] - centroids[3 * cluster + 2];
+
+            int color_diff = r*r + g*g + b*b;
+
+            if (color_diff < min_distance) {
+                second_distance = min_distance;
+                min_distance = color_diff;
+                cluster_id = cluster;
+            } else if (color_diff < second_distance) {
+                second_distance = color_diff;
+            }
+        }
+        evaluations += (old_id >= 0) ? n_cluster - 1 : n_cluster;
+
+        bounds->upper[point] = sqrt((double)min_distance);
+        bounds->lower[point] = (second_distance == INT_MAX) ? INFINITY : sqrt((double)second_distance);
+
+        if (cluster_id == old_id) {
+            continue;
+        }
+
+        int weight = (task->weights != NULL) ? task->weights[point] : 1;
+        if (old_id >= 0) {
+            cluster_size[old_id] -= weight;
+            sums[3 * old_id + 0] -= (int64_t)weight * points->r[point];
+            sums[3 * old_id + 1] -= (int64_t)weight * points->g[point];
+            sums[3 * old_id + 2] -= (int64_t)weight * points->b[point];
+        }
+        cluster_size[cluster_id] += weight;
+        sums[3 * cluster_id + 0] += (int64_t)weight * points->r[point];
+        sums[3 * cluster_id + 1] += (int64_t)weight * points->g[point];
+        sums[3 * cluster_id + 2] += (int64_t)weight * points->b[point];
+        bounds->assignments[point] = cluster_id;
+    }
+
+    task->evaluations = evaluations;
+}
+
+/* Centroid movements and separations the Hamerly bounds are adjusted with before the next pass. */
+static void updateHamerlyBounds(HamerlyBounds *bounds, const int *old_centroids, const int *centroids, int n_cluster)
+{
+    bounds->max_moved = 0.0;
+    bounds->second_moved = 0.0;
+    bounds->farthest_mover = 0;
 
     for (int cluster = 0; cluster < n_cluster; cluster++) {
-        free(cluster_lists[cluster]);
+        int r = centroids[3 * cluster + 0] - old_centroids[3 * cluster + 0];
+        int g = centroids[3 * cluster + 1] - old_centroids[3 * cluster + 1];
+        int b = centroids[3 * cluster + 2] - old_centroids[3 * cluster + 2];
+        double moved = sqrt((double)(r*r + g*g + b*b));
+
+        bounds->moved[cluster] = moved;
+        if (moved > bounds->max_moved) {
+            bounds->second_moved = bounds->max_moved;
+            bounds->max_moved = moved;
+            bounds->farthest_mover = cluster;
+        } else if (moved > bounds->second_moved) {
+            bounds->second_moved = moved;
+        }
+
+        int min_gap = INT_MAX;
+        for (int other = 0; other < n_cluster; other++) {
+            if (other == cluster) {
+                continue;
+            }
+            int dr = centroids[3 * cluster + 0] - centroids[3 * other + 0];
+            int dg = centroids[3 * cluster + 1] - centroids[3 * other + 1];
+            int db = centroids[3 * cluster + 2] - centroids[3 * other + 2];
+            int gap = dr*dr + dg*dg + db*db;
+            min_gap = (gap < min_gap) ? gap : min_gap;
+        }
+        bounds->half_gap[cluster] = (min_gap == INT_MAX) ? INFINITY : 0.5 * sqrt((double)min_gap);
+    }
+}
+
+static void *AssignThread(void *arg)
+{
+    AssignTask *task = arg;
+    AssignPool *pool = task->pool;
+    unsigned int seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->quit) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        seen = pool->generation;
+        bool quit = pool->quit;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (quit) {
+            break;
+        }
+
+        assignRange(task);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
     }
+    return NULL;
+}
+
+/* Helper i runs task i + 1; the calling thread keeps task 0 and any task whose helper failed to start. */
+static void startAssignPool(AssignPool *pool, AssignTask *tasks, int n_tasks)
+{
+    pool->tasks = tasks;
+    pool->n_tasks = n_tasks;
+    pool->n_threads = 0;
 
-    free(cluster_lists);
-    cluster_lists = NULL;
+    if (n_tasks <= 1) {
+        return;
+    }
 
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int task = 1; task < n_tasks; task++) {
+        tasks[task].pool = pool;
+        if (pthread_create(&pool->threads[pool->n_threads], NULL, AssignThread, &tasks[task]) != 0) {
+            break;
+        }
+        pool->n_threads++;
+    }
+}
+
+static void runAssignPool(AssignPool *pool)
+{
+    if (pool->n_threads > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pool->generation++;
+        pool->pending = pool->n_threads;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    assignRange(&pool->tasks[0]);
+    for (int task = 1 + pool->n_threads; task < pool->n_tasks; task++) {
+        assignRange(&pool->tasks[task]);
+    }
+
+    if (pool->n_threads > 0) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->pending > 0) {
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void stopAssignPool(AssignPool *pool)
+{
+    if (pool->n_tasks <= 1) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int thread = 0; thread < pool->n_threads; thread++) {
+        pthread_join(pool->threads[thread], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+static void miniBatchIterations(const ColorPlanes *points, const int *weights, int *centroids, int n_cluster, AssignKernel assign, KMeansOptions options, KMeansRng *rng)
+{
+    /*
+     * Centroids are tracked as doubles between batches and rounded for the
+     * assignment kernels. With weights (histogram mode), points are drawn
+     * with probability proportional to their weight.
+     *
+     * A 1 / count rate keeps the pull of the early assignments, made while
+     * the centroids were still far off, for the whole run; forgetting the
+     * counts each time the centroids settle lets them pull again from where
+     * they are now.
+     */
+    int batch_size = (options.batch_size > 0) ? options.batch_size : KMEANS_MINIBATCH_SIZE;
+    double tolerance = (options.tolerance > 0.0f) ? options.tolerance : KMEANS_MINIBATCH_TOLERANCE;
+
+    ColorPlanes batch = { 0 };
+    int *assignments     = ScratchAlloc(options.arena, batch_size * sizeof(int));
+    double *centers      = ScratchAlloc(options.arena, n_cluster * 3 * sizeof(double));
+    double *previous     = ScratchAlloc(options.arena, n_cluster * 3 * sizeof(double));
+    int64_t *seen        = ScratchCalloc(options.arena, n_cluster, sizeof(int64_t));         // Points each centroid has absorbed this epoch
+    int64_t *cumulative  = (weights != NULL) ? ScratchAlloc(options.arena, points->count * sizeof(int64_t)) : NULL;
+
+    if (assignments == NULL || centers == NULL || previous == NULL || seen == NULL ||
+        (weights != NULL && cumulative == NULL) || !allocColorPlanes(&batch, batch_size, options.arena)) {
+        ScratchFree(options.arena, assignments);
+        ScratchFree(options.arena, centers);
+        ScratchFree(options.arena, previous);
+        ScratchFree(options.arena, seen);
+        ScratchFree(options.arena, cumulative);
+        return;
+    }
+
+    int64_t total_weight = 0;
+    for (int point = 0; point < points->count && weights != NULL; point++) {
+        total_weight += weights[point];
+        cumulative[point] = total_weight;
+    }
+
+    for (int i = 0; i < n_cluster * 3; i++) {
+        centers[i] = centroids[i];
+    }
+    int n_batches = 0, calm = 0, epoch = 0;
+
+    while (n_batches < MINIBATCH_MAX_BATCHES && epoch < MINIBATCH_EPOCHS) {
+        for (int i = 0; i < batch_size; i++) {
+            int point;
+            if (weights != NULL) {
+                // First point whose cumulative weight exceeds a uniform draw in [0, total_weight).
+                int64_t target = (int64_t)(nextRandom(rng) % (uint64_t)total_weight);
+                int low = 0, high = points->count - 1;
+                while (low < high) {
+                    int mid = low + (high - low) / 2;
+                    if (cumulative[mid] > target) high = mid;
+                    else low = mid + 1;
+                }
+                point = low;
+            } else {
+                point = randomIndex(rng, points->count);
+            }
+            batch.r[i] = points->r[point];
+            batch.g[i] = points->g[point];
+            batch.b[i] = points->b[point];
+        }
+
+        for (int i = 0; i < n_cluster * 3; i++) {
+            centroids[i] = (int)lround(centers[i]);
+        }
+        assign(&batch, 0, batch_size, centroids, n_cluster, assignments);
+        memcpy(previous, centers, n_cluster * 3 * sizeof(double));
+
+        // Step each centroid towards its points; the rate falls as the centroid absorbs more of them.
+        for (int i = 0; i < batch_size; i++) {
+            int cluster_id = assignments[i];
+            double rate = 1.0 / (double)(++seen[cluster_id]);
+            double *center = &centers[3 * cluster_id];
+
+            center[0] += rate * (batch.r[i] - center[0]);
+            center[1] += rate * (batch.g[i] - center[1]);
+            center[2] += rate * (batch.b[i] - center[2]);
+        }
+
+        calm = (maxCentroidMovement(previous, centers, n_cluster) < tolerance) ? calm + 1 : 0;
+        n_batches++;
+
+        if (calm >= MINIBATCH_PATIENCE) {
+            memset(seen, 0, n_cluster * sizeof(int64_t));
+            calm = 0;
+            epoch++;
+        }
+    }
+
+    for (int i = 0; i < n_cluster * 3; i++) {
+        centroids[i] = (int)lround(centers[i]);
+    }
+
+    if (options.stats != NULL) {
+        options.stats->iterations = n_batches;
+        options.stats->distance_evaluations = (int64_t)n_batches * batch_size * n_cluster;
+        options.stats->distances_skipped = 0;
+    }
+
+    UnloadColorPlanes(&batch);
+    ScratchFree(options.arena, assignments);
+    ScratchFree(options.arena, centers);
+    ScratchFree(options.arena, previous);
+    ScratchFree(options.arena, seen);
+    ScratchFree(options.arena, cumulative);
+}
+
+/* Largest distance between matching centroids of two sets. */
+static double maxCentroidMovement(const double *from, const double *to, int n_cluster)
+{
+    double max_moved = 0.0;
     for (int cluster = 0; cluster < n_cluster; cluster++) {
-        Color color = (Color) {
-            centroids[cluster][0], centroids[cluster][1], centroids[cluster][2], 255
-        };
-        dominant_colors[cluster] = color;
-        free(centroids[cluster]);
+        double r = to[3 * cluster + 0] - from[3 * cluster + 0];
+        double g = to[3 * cluster + 1] - from[3 * cluster + 1];
+        double b = to[3 * cluster + 2] - from[3 * cluster + 2];
+        double moved = sqrt(r*r + g*g + b*b);
+        max_moved = (moved > max_moved) ? moved : max_moved;
     }
+    return max_moved;
+}
 
-    free(centroids);
-    centroids = NULL;
+/* Nearest centroid of points [start, start + count) into assignments[0, count), one at a time. */
+static void assignScalar(const ColorPlanes *points, int start, int count, const int *centroids, int n_cluster, int *assignments)
+{
+    for (int point = start; point < start + count; point++) {
+        int cluster_id = 0;
+
+        int min_distance = INT_MAX;
+
+        for (int cluster = 0; cluster < n_cluster; cluster++) {
+            int r = points->r[point] - centroids[3 * cluster + 0];
+            int g = points->g[point] - centroids[3 * cluster + 1];
+            int b = points->b[point] - centroids[3 * cluster + 2];
+
+            int color_diff = r*r + g*g + b*b;
+
+            if (color_diff < min_distance) {
+                min_distance = color_diff;
+                cluster_id   = cluster;
+            }
+        }
+
+        assignments[point - start] = cluster_id;
+    }
+}
+
+#ifdef KMEANS_X86
+/*
+ * Channel differences fit in 16 bits; pairing dr with dg lets one madd give
+ * dr*dr + dg*dg as 32 bits, and db is paired with zero for db*db.
+ */
+static void assignSSE2(const ColorPlanes *points, int start, int count, const int *centroids, int n_cluster, int *assignments)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int point = start;
+
+    for (; point + 8 <= start + count; point += 8) {
+        __m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(points->r + point)), zero);
+        __m128i g = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(points->g + point)), zero);
+        __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(points->b + point)), zero);
+
+        __m128i best_lo = _mm_set1_epi32(INT_MAX), best_hi = best_lo;    // Points 0-3 and 4-7
+        __m128i id_lo = zero, id_hi = zero;
+
+        for (int cluster = 0; cluster < n_cluster; cluster++) {
+            __m128i dr = _mm_sub_epi16(r, _mm_set1_epi16((short)centroids[3 * cluster + 0]));
+            __m128i dg = _mm_sub_epi16(g, _mm_set1_epi16((short)centroids[3 * cluster + 1]));
+            __m128i db = _mm_sub_epi16(b, _mm_set1_epi16((short)centroids[3 * cluster + 2]));
+
+            __m128i rg = _mm_unpacklo_epi16(dr, dg), bz = _mm_unpacklo_epi16(db, zero);
+            __m128i d_lo = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+            rg = _mm_unpackhi_epi16(dr, dg);
+            bz = _mm_unpackhi_epi16(db, zero);
+            __m128i d_hi = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+
+            __m128i id = _mm_set1_epi32(cluster);
+            __m128i lt_lo = _mm_cmplt_epi32(d_lo, best_lo), lt_hi = _mm_cmplt_epi32(d_hi, best_hi);
+            best_lo = _mm_or_si128(_mm_and_si128(lt_lo, d_lo), _mm_andnot_si128(lt_lo, best_lo));
+            best_hi = _mm_or_si128(_mm_and_si128(lt_hi, d_hi), _mm_andnot_si128(lt_hi, best_hi));
+            id_lo = _mm_or_si128(_mm_and_si128(lt_lo, id), _mm_andnot_si128(lt_lo, id_lo));
+            id_hi = _mm_or_si128(_mm_and_si128(lt_hi, id), _mm_andnot_si128(lt_hi, id_hi));
+        }
+
+        _mm_storeu_si128((__m128i *)(assignments + point - start), id_lo);
+        _mm_storeu_si128((__m128i *)(assignments + point - start + 4), id_hi);
+    }
+
+    assignScalar(points, point, start + count - point, centroids, n_cluster, assignments + point - start);
+}
+
+/* Same as assignSSE2() on 16 points. In-lane unpacking leaves points 0-3/8-11 in lo and 4-7/12-15 in hi. */
+__attribute__((target("avx2")))
+static void assignAVX2(const ColorPlanes *points, int start, int count, const int *centroids, int n_cluster, int *assignments)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int point = start;
+
+    for (; point + 16 <= start + count; point += 16) {
+        __m256i r = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(points->r + point)));
+        __m256i g = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(points->g + point)));
+        __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(points->b + point)));
+
+        __m256i best_lo = _mm256_set1_epi32(INT_MAX), best_hi = best_lo;
+        __m256i id_lo = zero, id_hi = zero;
+
+        for (int cluster = 0; cluster < n_cluster; cluster++) {
+            __m256i dr = _mm256_sub_epi16(r, _mm256_set1_epi16((short)centroids[3 * cluster + 0]));
+            __m256i dg = _mm256_sub_epi16(g, _mm256_set1_epi16((short)centroids[3 * cluster + 1]));
+            __m256i db = _mm256_sub_epi16(b, _mm256_set1_epi16((short)centroids[3 * cluster + 2]));
+
+            __m256i rg = _mm256_unpacklo_epi16(dr, dg), bz = _mm256_unpacklo_epi16(db, zero);
+            __m256i d_lo = _mm256_add_epi32(_mm256_madd_epi16(rg, rg), _mm256_madd_epi16(bz, bz));
+            rg = _mm256_unpackhi_epi16(dr, dg);
+            bz = _mm256_unpackhi_epi16(db, zero);
+            __m256i d_hi = _mm256_add_epi32(_mm256_madd_epi16(rg, rg), _mm256_madd_epi16(bz, bz));
+
+            __m256i id = _mm256_set1_epi32(cluster);
+            __m256i lt_lo = _mm256_cmpgt_epi32(best_lo, d_lo), lt_hi = _mm256_cmpgt_epi32(best_hi, d_hi);
+            best_lo = _mm256_blendv_epi8(best_lo, d_lo, lt_lo);
+            best_hi = _mm256_blendv_epi8(best_hi, d_hi, lt_hi);
+            id_lo = _mm256_blendv_epi8(id_lo, id, lt_lo);
+            id_hi = _mm256_blendv_epi8(id_hi, id, lt_hi);
+        }
+
+        _mm256_storeu_si256((__m256i *)(assignments + point - start), _mm256_permute2x128_si256(id_lo, id_hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(assignments + point - start + 8), _mm256_permute2x128_si256(id_lo, id_hi, 0x31));
+    }
+
+    assignSSE2(points, point, start + count - point, centroids, n_cluster, assignments + point - start);
+}
+#endif
+
+static AssignKernel selectAssignKernel(bool scalar)
+{
+    if (scalar) {
+        return assignScalar;
+    }
+#ifdef KMEANS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return assignAVX2;
+    }
+    return assignSSE2;
+#else
+    return assignScalar;
+#endif
+}
+
+/* Collapse the pixels into the occupied bins of a 15-bit (5:5:5) or 18-bit (6:6:6) RGB histogram.
+   Each bin is represented by the mean of its pixels and weighted by their count.
+   Also finds which of them holds the given pixel.
+   Returns the number of occupied bins, or 0 if bits is not supported or memory runs out.
+*/
+static int buildColorHistogram(const ColorPlanes *points, int bits, int pixel, ColorPlanes *unique_colors, int **weights, int *pixel_bin, Arena *arena)
+{
+    if ((bits != 15 && bits != 18) || points->count <= 0) {
+        return 0;
+    }
+
+    int channel_bits = bits / 3;
+    int shift = 8 - channel_bits;
+    int n_bins = 1 << bits;
+
+    uint32_t *counts = ScratchCalloc(arena, n_bins, sizeof(uint32_t));
+    uint32_t *bin_sums = ScratchCalloc(arena, (size_t)n_bins * 3, sizeof(uint32_t));   // Fits: at most 2^24 pixels of 255 per bin
+
+    if (counts == NULL || bin_sums == NULL) {
+        ScratchFree(arena, counts);
+        ScratchFree(arena, bin_sums);
+        return 0;
+    }
+
+    for (int point = 0; point < points->count; point++) {
+        int r = points->r[point], g = points->g[point], b = points->b[point];
+        int bin = ((r >> shift) << (2 * channel_bits)) | ((g >> shift) << channel_bits) | (b >> shift);
+        if (point == pixel) {
+            *pixel_bin = bin;
+        }
+        counts[bin]++;
+        bin_sums[3 * bin + 0] += r;
+        bin_sums[3 * bin + 1] += g;
+        bin_sums[3 * bin + 2] += b;
+    }
+
+    int n_unique = 0;
+    for (int bin = 0; bin < n_bins; bin++) {
+        n_unique += (counts[bin] > 0);
+    }
+
+    *weights = ScratchAlloc(arena, n_unique * sizeof(int));
+
+    if (*weights == NULL || !allocColorPlanes(unique_colors, n_unique, arena)) {
+        ScratchFree(arena, *weights);
+        *weights = NULL;
+        n_unique = 0;
+    } else {
+        int unique = 0;
+        for (int bin = 0; bin < n_bins; bin++) {
+            uint32_t count = counts[bin];
+            if (count == 0) {
+                continue;
+            }
+            unique_colors->r[unique] = (bin_sums[3 * bin + 0] + count / 2) / count;
+            unique_colors->g[unique] = (bin_sums[3 * bin + 1] + count / 2) / count;
+            unique_colors->b[unique] = (bin_sums[3 * bin + 2] + count / 2) / count;
+            (*weights)[unique] = (int)count;
+            if (bin == *pixel_bin) {
+                *pixel_bin = unique;
+            }
+            unique++;
+        }
+    }
+
+    ScratchFree(arena, counts);
+    ScratchFree(arena, bin_sums);
+    return n_unique;
 }
 
 /* This function returns the squared euclidean distance
@@ -135,68 +1062,148 @@ int distanceSquared(Color *color1, Color *color2)
 }
 
 
-// K-MEANS++
+// Farthest-point initialization of the first n_cluster centroids, as rows of r, g, b.
 void InitializeCentroid(int **centroid, int n_points, Color *image_color_data, int n_cluster)
 {
+    ColorPlanes planes = { 0 };
+    int *centroids = malloc(n_cluster * 3 * sizeof(int));
+    if (centroids == NULL || !allocColorPlanes(&planes, n_points, NULL)) {
+        free(centroids);
+        return;
+    }
+
+    for (int point = 0; point < n_points; point++) {
+        planes.r[point] = image_color_data[point].r;
+        planes.g[point] = image_color_data[point].g;
+        planes.b[point] = image_color_data[point].b;
+    }
 
     /* Initialize 1st centroid randomly */
-    int c1_random_index = GetRandomValue(0, n_points-1);    // Get a random value between min and max (both included)
-    Color *cluster_color = malloc(n_cluster * sizeof(Color));
+    KMeansRng rng = seedRandom(0);
+    int c1_random_index = randomIndex(&rng, n_points);
+
+    initializeCentroids(centroids, c1_random_index, &planes, NULL, n_cluster, KMEANS_INIT_FARTHEST, &rng, NULL);
+
+    for (int cluster = 0; cluster < n_cluster; cluster++) {
+        centroid[cluster][0] = centroids[3 * cluster + 0];
+        centroid[cluster][1] = centroids[3 * cluster + 1];
+        centroid[cluster][2] = centroids[3 * cluster + 2];
+    }
+
+    UnloadColorPlanes(&planes);
+    free(centroids);
+}
+
+/*
+ * After the first centroid, each next one is either the point farthest from
+ * all chosen so far (ties to the lower index) or, for k-means++, a point
+ * drawn with probability weight * D^2, D being its distance to the nearest
+ * chosen centroid. nearest[] holds D^2 and is only compared against the
+ * newest centroid.
+ */
+static void initializeCentroids(int *centroids, int first_point, const ColorPlanes *points, const int *weights, int n_cluster, KMeansInit init, KMeansRng *rng, Arena *arena)
+{
+    int n_points = points->count;
+    int *nearest = ScratchAlloc(arena, n_points * sizeof(int));
+
+    centroids[0] = points->r[first_point];
+    centroids[1] = points->g[first_point];
+    centroids[2] = points->b[first_point];
+
+    if (nearest == NULL) {
+        // No room to track distances: every centroid starts on the first point and Lloyd's iterations spread them.
+        for (int cluster = 1; cluster < n_cluster; cluster++) {
+            memcpy(&centroids[3 * cluster], centroids, 3 * sizeof(int));
+        }
+        return;
+    }
 
-    cluster_color[0] = image_color_data[c1_random_index];
+    for (int point = 0; point < n_points; point++) {
+        nearest[point] = INT_MAX;
+    }
 
-    // Initialize a centroid value for the 1st cluster
     for (int cluster = 1; cluster < n_cluster; cluster++) {
+        const int *newest = &centroids[3 * (cluster - 1)];
         int max_distance = 0;
         int c_id = 0;
+        int64_t total = 0;
 
         for (int point = 0; point < n_points; point++) {
-            int min_dist = INT_MAX;
+            int r = points->r[point] - newest[0];
+            int g = points->g[point] - newest[1];
+            int b = points->b[point] - newest[2];
 
-            for (int c = 0; c < cluster; c++) {
-                int temp_dist = distanceSquared(&cluster_color[c], &image_color_data[point]);
-                min_dist = (min_dist < temp_dist) ? min_dist : temp_dist;
+            int temp_dist = r*r + g*g + b*b;
+            if (temp_dist < nearest[point]) {
+                nearest[point] = temp_dist;
             }
 
             // Set the maximum distance and assign it to the next centroid.
-            if (min_dist > max_distance) {
-                max_distance = min_dist;
+            if (nearest[point] > max_distance) {
+                max_distance = nearest[point];
                 c_id = point;
             }
+            total += (int64_t)((weights != NULL) ? weights[point] : 1) * nearest[point];
         }
-        cluster_color[cluster] = image_color_data[c_id];
-    }
-    for (int cluster = 0; cluster < n_cluster; cluster++) {
-        centroid[cluster][0] = cluster_color[cluster].r;
-        centroid[cluster][1] = cluster_color[cluster].g;
-        centroid[cluster][2] = cluster_color[cluster].b;
+
+        if (init == KMEANS_INIT_PLUSPLUS && total > 0) {
+            // Walk the cumulative weight * D^2 up to a uniform draw in [0, total).
+            int64_t target = (int64_t)(nextRandom(rng) % (uint64_t)total);
+            for (c_id = 0; c_id < n_points - 1; c_id++) {
+                target -= (int64_t)((weights != NULL) ? weights[c_id] : 1) * nearest[c_id];
+                if (target < 0) {
+                    break;
+                }
+            }
+        }
+
+        centroids[3 * cluster + 0] = points->r[c_id];
+        centroids[3 * cluster + 1] = points->g[c_id];
+        centroids[3 * cluster + 2] = points->b[c_id];
     }
 
-    free(cluster_color);
-    cluster_color = NULL;
+    ScratchFree(arena, nearest);
 }
 
-void NewCentroid(int *cluster_list, int *centroid, int n_points, Color *image_color_data)
+/* initializeCentroids() over MINIBATCH_INIT_SAMPLE random points, the first of them first_point. */
+static void initializeCentroidsFromSample(int *centroids, int first_point, const ColorPlanes *points, int n_cluster, KMeansInit init, KMeansRng *rng, Arena *arena)
 {
-    if (cluster_list == NULL || n_points == 0) {
+    ColorPlanes sample = { 0 };
+    if (points->count <= MINIBATCH_INIT_SAMPLE || !allocColorPlanes(&sample, MINIBATCH_INIT_SAMPLE, arena)) {
+        initializeCentroids(centroids, first_point, points, NULL, n_cluster, init, rng, arena);
         return;
     }
 
-    int r = 0, g = 0, b = 0;
-
-    for (int point = 0; point < n_points; point++) {
-        int color_index = cluster_list[point];
-        r += image_color_data[color_index].r;
-        g += image_color_data[color_index].g;
-        b += image_color_data[color_index].b;
+    for (int i = 0; i < sample.count; i++) {
+        int point = (i == 0) ? first_point : randomIndex(rng, points->count);
+        sample.r[i] = points->r[point];
+        sample.g[i] = points->g[point];
+        sample.b[i] = points->b[point];
     }
 
-    r = (int) r / n_points;
-    g = (int) g / n_points;
-    b = (int) b / n_points;
-    centroid[0] = r;
-    centroid[1] = g;
-    centroid[2] = b;
+    initializeCentroids(centroids, 0, &sample, NULL, n_cluster, init, rng, arena);
+    UnloadColorPlanes(&sample);
+}
+
+/* splitmix64 (Steele, Lea & Flood). Seed 0 draws a seed from raylib's generator, which SetRandomSeed() controls. */
+static KMeansRng seedRandom(uint64_t seed)
+{
+    if (seed == 0) {
+        seed = ((uint64_t)(unsigned int)GetRandomValue(0, INT_MAX) << 32) | (unsigned int)GetRandomValue(0, INT_MAX);
+    }
+    return (KMeansRng) { seed };
 }
 
+static uint64_t nextRandom(KMeansRng *rng)
+{
+    uint64_t z = (rng->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
 
+/* Uniform in [0, count). */
+static int randomIndex(KMeansRng *rng, int count)
+{
+    return (int)(((nextRandom(rng) >> 32) * (uint64_t)count) >> 32);
+}
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "raylib.h"
+#include "latency_probe.h"
+
+/*
+ * Latency probe.
+ * -----------------------------------------------------------
+ * A frame is stamped at five points:
+ *
+ *   sample arrival   newest block seen by ProcessAudioStreamCallback,
+ *   analysis start   render loop begins windowing,
+ *   analysis end     band levels are ready,
+ *   frame swap       EndDrawing() returned (the closest we get to photons),
+ *   audio output     estimated time the analyzed window leaves the speakers.
+ *
+ * EndLatencyFrame() turns the stamps into intervals and keeps the last
+ * LATENCY_HISTORY of each for percentiles. The last interval is the one the
+ * viewer perceives: how far the picture is behind (or ahead of) the sound.
+ *
+ * The self-test replaces the music with a click track: 40 ms bursts at
+ * 120 Hz, in the band that drives the ripple. Each burst's output time is
+ * estimated from when it was mixed plus the device latency, and the delay is
+ * measured to the first swapped frame whose band level jumps.
+ * -----------------------------------------------------------
+ */
+
+#define CLICK_FREQUENCY 120.0f
+#define CLICK_AMPLITUDE 0.8f
+#define CLICK_LENGTH_FRAMES (LATENCY_SELFTEST_SAMPLE_RATE / 25)        // 40 ms
+#define CLICK_PERIOD_FRAMES (LATENCY_SELFTEST_SAMPLE_RATE * 3 / 4)     // 750 ms
+#define CLICK_RESPONSE_DB 6.0f      // Rise over the pre-click level that counts as a response
+#define CLICK_TIMEOUT 0.5           // Seconds after the click's output before it counts as missed
+
+static const char *interval_names[LATENCY_INTERVAL_COUNT] = {
+    "arrival->analysis",
+    "analysis",
+    "analysis->swap",
+    "arrival->swap",
+    "swap-output",
+    "draw (CPU)",
+};
+
+static struct
+{
+    double stamps[LATENCY_STAGE_COUNT];
+    bool marked[LATENCY_STAGE_COUNT];
+    bool in_frame;
+
+    float intervals[LATENCY_INTERVAL_COUNT][LATENCY_HISTORY];  // Milliseconds
+    int n_intervals[LATENCY_INTERVAL_COUNT];
+    int next[LATENCY_INTERVAL_COUNT];
+
+    bool reporting;
+    double last_log;
+} probe;
+
+static struct
+{
+    AudioStream stream;
+    AudioCallback processor;
+    bool running;
+
+    uint64_t frame;                         // Audio thread only
+    _Atomic double click_time;              // When the latest click was mixed
+    _Atomic unsigned int clicks_emitted;
+
+    unsigned int clicks_seen;
+    bool armed;                             // Waiting for the bars to react to a click
+    double click_output_time;
+    float baseline;
+    float last_level;
+
+    float delays[LATENCY_SELFTEST_CLICKS];  // Milliseconds
+    int n_delays;
+    int n_missed;
+} selftest;
+
+static float scratch[LATENCY_HISTORY];
+
+static int CompareFloats(const void *a, const void *b);
+static float Percentile(const float *values, int count, float percentile);
+static void PushInterval(LatencyInterval interval, double seconds);
+static void LogLatencyReport(void);
+static void ClickTrackCallback(void *bufferData, unsigned int frames);
+
+void SetLatencyReporting(bool enabled)
+{
+    probe.reporting = enabled;
+    probe.last_log = GetTime();
+}
+
+bool IsLatencyReporting(void)
+{
+    return probe.reporting;
+}
+
+void BeginLatencyFrame(void)
+{
+    memset(probe.marked, 0, sizeof(probe.marked));
+    probe.in_frame = true;
+}
+
+void MarkLatencyStage(LatencyStage stage, double time)
+{
+    if (!probe.in_frame) return;
+
+    probe.stamps[stage] = time;
+    probe.marked[stage] = true;
+}
+
+void EndLatencyFrame(void)
+{
+    if (!probe.in_frame) return;
+    probe.in_frame = false;
+
+    const double *t = probe.stamps;
+    const bool *m = probe.marked;
+
+    if (m[LATENCY_STAGE_SAMPLE_ARRIVAL] && m[LATENCY_STAGE_ANALYSIS_START])
+        PushInterval(LATENCY_ARRIVAL_TO_ANALYSIS, t[LATENCY_STAGE_ANALYSIS_START] - t[LATENCY_STAGE_SAMPLE_ARRIVAL]);
+    if (m[LATENCY_STAGE_ANALYSIS_START] && m[LATENCY_STAGE_ANALYSIS_END])
+        PushInterval(LATENCY_ANALYSIS, t[LATENCY_STAGE_ANALYSIS_END] - t[LATENCY_STAGE_ANALYSIS_START]);
+    if (m[LATENCY_STAGE_ANALYSIS_END] && m[LATENCY_STAGE_FRAME_SWAP])
+        PushInterval(LATENCY_ANALYSIS_TO_SWAP, t[LATENCY_STAGE_FRAME_SWAP] - t[LATENCY_STAGE_ANALYSIS_END]);
+    if (m[LATENCY_STAGE_SAMPLE_ARRIVAL] && m[LATENCY_STAGE_FRAME_SWAP])
+        PushInterval(LATENCY_ARRIVAL_TO_SWAP, t[LATENCY_STAGE_FRAME_SWAP] - t[LATENCY_STAGE_SAMPLE_ARRIVAL]);
+    if (m[LATENCY_STAGE_AUDIO_OUTPUT] && m[LATENCY_STAGE_FRAME_SWAP])
+        PushInterval(LATENCY_SWAP_TO_OUTPUT, t[LATENCY_STAGE_FRAME_SWAP] - t[LATENCY_STAGE_AUDIO_OUTPUT]);
+    if (m[LATENCY_STAGE_DRAW_START] && m[LATENCY_STAGE_DRAW_END])
+        PushInterval(LATENCY_DRAW, t[LATENCY_STAGE_DRAW_END] - t[LATENCY_STAGE_DRAW_START]);
+
+    if (probe.reporting && m[LATENCY_STAGE_FRAME_SWAP] && t[LATENCY_STAGE_FRAME_SWAP] - probe.last_log >= LATENCY_LOG_INTERVAL)
+    {
+        probe.last_log = t[LATENCY_STAGE_FRAME_SWAP];
+        LogLatencyReport();
+    }
+}
+
+float GetLatencyPercentile(LatencyInterval interval, float percentile)
+{
+    return Percentile(probe.intervals[interval], probe.n_intervals[interval], percentile);
+}
+
+void DrawLatencyOverlay(int posX, int posY, int fontSize, Color color)
+{
+    int line_height = fontSize + 2;
+    DrawRectangle(posX - 4, posY - 4, 20 * fontSize, (LATENCY_INTERVAL_COUNT + 1) * line_height + 8, Fade(BLACK, 0.6f));
+
+    DrawText("latency ms            p50     p90     p99", posX, posY, fontSize, color);
+    for (int i = 0; i < LATENCY_INTERVAL_COUNT; i++)
+    {
+        DrawText(TextFormat("%-18s %7.1f %7.1f %7.1f", interval_names[i],
+                            GetLatencyPercentile(i, 0.50f), GetLatencyPercentile(i, 0.90f), GetLatencyPercentile(i, 0.99f)),
+                 posX, posY + (i + 1) * line_height, fontSize, color);
+    }
+}
+
+bool StartLatencySelfTest(AudioCallback processor)
+{
+    if (selftest.running) return true;
+
+    memset(&selftest, 0, sizeof(selftest));
+    selftest.processor = processor;
+    selftest.stream = LoadAudioStream(LATENCY_SELFTEST_SAMPLE_RATE, 32, 2);
+    if (!IsAudioStreamReady(selftest.stream))
+    {
+        TraceLog(LOG_WARNING, "LATENCY: Unable to open the click track stream");
+        return false;
+    }
+
+    SetAudioStreamCallback(selftest.stream, ClickTrackCallback);
+    AttachAudioStreamProcessor(selftest.stream, processor);   // Through the same path as the music
+    PlayAudioStream(selftest.stream);
+    selftest.running = true;
+
+    TraceLog(LOG_INFO, "LATENCY: Self-test started, %d clicks", LATENCY_SELFTEST_CLICKS);
+    return true;
+}
+
+bool IsLatencySelfTestRunning(void)
+{
+    return selftest.running;
+}
+
+bool UpdateLatencySelfTest(float band_level, double swap_time, double output_latency)
+{
+    if (!selftest.running) return false;
+
+    unsigned int emitted = atomic_load_explicit(&selftest.clicks_emitted, memory_order_acquire);
+
+    if (selftest.armed && swap_time - selftest.click_output_time > CLICK_TIMEOUT)
+    {
+        selftest.armed = false;
+        selftest.n_missed++;
+    }
+
+    if (!selftest.armed && emitted > selftest.clicks_seen && selftest.clicks_seen < LATENCY_SELFTEST_CLICKS)
+    {
+        selftest.clicks_seen = emitted;
+        selftest.armed = true;
+        selftest.click_output_time = atomic_load_explicit(&selftest.click_time, memory_order_relaxed) + output_latency;
+        selftest.baseline = selftest.last_level;    // Level of the previous frame, before the click could show
+    }
+
+    if (selftest.armed && band_level >= selftest.baseline + CLICK_RESPONSE_DB)
+    {
+        selftest.armed = false;
+        selftest.delays[selftest.n_delays++] = (float)((swap_time - selftest.click_output_time) * 1000.0);
+    }
+
+    selftest.last_level = band_level;
+
+    if (!selftest.armed && selftest.clicks_seen >= LATENCY_SELFTEST_CLICKS)
+    {
+        TraceLog(LOG_INFO, "LATENCY: Self-test done, click to bar response p50 %.1f ms, p90 %.1f ms, max %.1f ms (%d detected, %d missed)",
+                 Percentile(selftest.delays, selftest.n_delays, 0.50f), Percentile(selftest.delays, selftest.n_delays, 0.90f),
+                 Percentile(selftest.delays, selftest.n_delays, 1.0f), selftest.n_delays, selftest.n_missed);
+        StopLatencySelfTest();
+        return false;
+    }
+
+    return true;
+}
+
+void StopLatencySelfTest(void)
+{
+    if (!selftest.running) return;
+
+    StopAudioStream(selftest.stream);
+    DetachAudioStreamProcessor(selftest.stream, selftest.processor);
+    UnloadAudioStream(selftest.stream);
+    selftest.running = false;
+}
+
+static int CompareFloats(const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static float Percentile(const float *values, int count, float percentile)
+{
+    if (count == 0) return 0.0f;
+
+    memcpy(scratch, values, count * sizeof(float));
+    qsort(scratch, count, sizeof(float), CompareFloats);
+
+    int index = (int)ceilf(percentile * count) - 1;
+    if (index < 0) index = 0;
+    if (index >= count) index = count - 1;
+    return scratch[index];
+}
+
+static void PushInterval(LatencyInterval interval, double seconds)
+{
+    probe.intervals[interval][probe.next[interval]] = (float)(seconds * 1000.0);
+    probe.next[interval] = (probe.next[interval] + 1) % LATENCY_HISTORY;
+    if (probe.n_intervals[interval] < LATENCY_HISTORY) probe.n_intervals[interval]++;
+}
+
+static void LogLatencyReport(void)
+{
+    for (int i = 0; i < LATENCY_INTERVAL_COUNT; i++)
+    {
+        TraceLog(LOG_INFO, "LATENCY: %-18s p50 %7.1f ms  p90 %7.1f ms  p99 %7.1f ms", interval_names[i],
+                 GetLatencyPercentile(i, 0.50f), GetLatencyPercentile(i, 0.90f), GetLatencyPercentile(i, 0.99f));
+    }
+}
+
+static void ClickTrackCallback(void *bufferData, unsigned int frames)
+{
+    float(*samples)[2] = bufferData;
+    double now = GetTime();
+
+    for (unsigned int i = 0; i < frames; i++)
+    {
+        uint64_t phase = selftest.frame % CLICK_PERIOD_FRAMES;
+        float sample = 0.0f;
+
+        if (selftest.frame >= CLICK_PERIOD_FRAMES && phase < CLICK_LENGTH_FRAMES)  // Leave the first period silent
+        {
+            if (phase == 0)
+            {
+                atomic_store_explicit(&selftest.click_time, now + (double)i / LATENCY_SELFTEST_SAMPLE_RATE, memory_order_relaxed);
+                atomic_fetch_add_explicit(&selftest.clicks_emitted, 1, memory_order_release);
+            }
+            sample = CLICK_AMPLITUDE * sinf(2.0f * PI * CLICK_FREQUENCY * (float)phase / LATENCY_SELFTEST_SAMPLE_RATE);
+        }
+
+        samples[i][0] = sample;
+        samples[i][1] = sample;
+        selftest.frame++;
+    }
+}
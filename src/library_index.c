@@ -0,0 +1,650 @@
+#if defined(_WIN32)
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#define _POSIX_C_SOURCE 200809L     // stat
+#include <sys/stat.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "raylib.h"
+#include "mapped_file.h"
+#include "mp3_index.h"
+#include "wav_source.h"
+#include "palette.h"
+#include "palette_cache.h"
+#include "track_loader.h"
+#include "library_index.h"
+
+/*
+ * Library index.
+ * -----------------------------------------------------------
+ * The file is a LibraryIndexHeader, count LibraryEntry records sorted by
+ * path, then strings_size bytes of NUL-terminated UTF-8 strings; entries
+ * refer to strings by offset, and offset 0 is the empty string. Artists,
+ * albums and genres repeat across thousands of tracks, so each distinct
+ * string is stored once. Like the palette cache, records are written in the
+ * machine's layout and the header's version and entry size reject an index
+ * from another build.
+ *
+ * A scan lists the files under the root (LoadDirectoryFilesEx, unfiltered:
+ * raylib's extension check isn't thread-safe), keeps the LIBRARY_EXTENSIONS
+ * ones, sorts them, and hands them out to LIBRARY_INDEX_WORKERS threads one
+ * at a time from an atomic counter. A file whose size and modification time
+ * match its entry in the current index, built with the same palette backend,
+ * keeps that entry; any other goes through the track loader's
+ * ReadTrackTags() and LoadTrackCover(), so MP3 tags come from the mapped
+ * ID3v2 reader. Covers shared by an album are decoded once: the scan keeps
+ * the palette of every cover it has seen, this scan's and the current
+ * index's, in a table of its own sized for the library. It only reads the
+ * palette cache, which holds the covers in rotation and is far too small for
+ * a library. Durations come from the first MP3 frame or the WAV header, not
+ * a decode. The new index is written next to the old one and moved over it
+ * afterwards, by whoever can make sure neither is mapped.
+ * -----------------------------------------------------------
+ */
+
+#define INDEX_MAGIC "SSLI"
+#define INDEX_PATH_SIZE 512
+#define NEW_SUFFIX ".new"
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t count;
+    uint32_t strings_size;
+    uint32_t backend;
+} LibraryIndexHeader;
+
+typedef struct
+{
+    const char *path;
+    LibraryEntry entry;             // String offsets filled in when written
+    MusicInfo info;                 // Read by the scan into its worker's arena, NULL strings if not
+    const LibraryEntry *previous;   // Unchanged entry of the current index
+} ScanItem;
+
+typedef struct
+{
+    uint64_t key;                   // Palette cache key of the cover, 0: empty slot
+    Color palette[PALETTE_SIZE];
+} ScanPalette;
+
+typedef struct
+{
+    ScanItem *items;
+    int count;
+    atomic_int next;
+    const LibraryIndex *previous;
+    PaletteBackend backend;
+    const atomic_bool *cancel;
+
+    pthread_mutex_t palettes_lock;
+    ScanPalette *palettes;          // Open addressing, NULL if it couldn't be allocated
+    uint32_t n_palettes;            // Power of two, at least twice the files and the previous entries
+} ScanJob;
+
+typedef struct
+{
+    ScanJob *job;
+    Arena strings;                  // Tags of the files this worker read, kept until the index is written
+    Arena scratch;                  // Cover planes and palette working memory, reset after every file
+} ScanThread;
+
+typedef struct
+{
+    char *data;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t *slots;                // Open addressing, offset + 1 of each string (0: empty)
+    uint32_t n_slots;               // Power of two, at least twice the strings stored
+    uint32_t n_strings;
+    bool failed;
+} StringPool;
+
+static struct
+{
+    pthread_t thread;
+    bool running;
+    atomic_bool done;
+    atomic_bool cancel;
+    bool ok;
+    char root[INDEX_PATH_SIZE];
+    char index_path[INDEX_PATH_SIZE];
+    LibraryScanStats stats;
+} background;
+
+static double Now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool GetFileStatus(const char *path, int64_t *mtime, uint64_t *size)
+{
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(path, &st) != 0) return false;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+#endif
+    *mtime = (int64_t)st.st_mtime;
+    *size = (uint64_t)st.st_size;
+    return true;
+}
+
+/* False if the name doesn't fit: a cut-off one could be another file. */
+static bool FormatPath(char *path, size_t size, const char *directory, const char *name)
+{
+    int length = snprintf(path, size, "%s%s", directory, name);
+    return (length >= 0) && ((size_t)length < size);
+}
+
+/* Index functions */
+//----------------------------------------------------------------------------------
+
+bool OpenLibraryIndex(const char *index_path, LibraryIndex *index)
+{
+    memset(index, 0, sizeof(LibraryIndex));
+    if (!OpenMappedFile(index_path, &index->file)) return false;
+
+    LibraryIndexHeader header;
+    bool valid = (index->file.size >= sizeof(header));
+    if (valid)
+    {
+        memcpy(&header, index->file.data, sizeof(header));
+        uint64_t expected = sizeof(header) + (uint64_t)header.count * sizeof(LibraryEntry) + header.strings_size;
+        valid = memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) == 0 && header.version == LIBRARY_INDEX_VERSION &&
+                header.entry_size == sizeof(LibraryEntry) && header.backend < PALETTE_BACKEND_COUNT &&
+                header.strings_size > 0 && expected == index->file.size &&
+                index->file.data[index->file.size - 1] == '\0';      // Every offset reads a terminated string
+    }
+    if (!valid)
+    {
+        TraceLog(LOG_WARNING, "LIBRARY: %s is not a library index of this build, rescanning", index_path);
+        CloseMappedFile(&index->file);
+        return false;
+    }
+
+    index->entries = (const LibraryEntry *)(index->file.data + sizeof(header));
+    index->count = (int)header.count;
+    index->strings = (const char *)(index->entries + header.count);
+    index->strings_size = header.strings_size;
+    index->backend = (PaletteBackend)header.backend;
+    return true;
+}
+
+void CloseLibraryIndex(LibraryIndex *index)
+{
+    CloseMappedFile(&index->file);
+    memset(index, 0, sizeof(LibraryIndex));
+}
+
+const char *GetLibraryString(const LibraryIndex *index, uint32_t offset)
+{
+    return (offset < index->strings_size) ? index->strings + offset : "";
+}
+
+int FindLibraryEntry(const LibraryIndex *index, const char *path)
+{
+    int low = 0, high = index->count - 1;
+    while (low <= high)
+    {
+        int middle = low + (high - low) / 2;
+        int order = strcmp(GetLibraryString(index, index->entries[middle].path), path);
+        if (order == 0) return middle;
+        if (order < 0) low = middle + 1;
+        else high = middle - 1;
+    }
+    return -1;
+}
+
+/* String pool */
+//----------------------------------------------------------------------------------
+
+static uint32_t HashString(const char *text)
+{
+    uint32_t hash = 2166136261u;      // FNV-1a
+    for (; *text != '\0'; text++) hash = (hash ^ (unsigned char)*text) * 16777619u;
+    return hash;
+}
+
+static bool GrowSlots(StringPool *pool)
+{
+    uint32_t n_slots = (pool->n_slots == 0) ? 4096 : pool->n_slots * 2;
+    uint32_t *slots = calloc(n_slots, sizeof(uint32_t));
+    if (slots == NULL) return false;
+
+    for (uint32_t i = 0; i < pool->n_slots; i++)
+    {
+        if (pool->slots[i] == 0) continue;
+        uint32_t slot = HashString(pool->data + pool->slots[i] - 1) & (n_slots - 1);
+        while (slots[slot] != 0) slot = (slot + 1) & (n_slots - 1);
+        slots[slot] = pool->slots[i];
+    }
+
+    free(pool->slots);
+    pool->slots = slots;
+    pool->n_slots = n_slots;
+    return true;
+}
+
+/* The pool starts with the empty string, offset 0. */
+static bool InitStringPool(StringPool *pool)
+{
+    pool->capacity = 64 * 1024;
+    pool->data = malloc(pool->capacity);
+    if (pool->data == NULL || !GrowSlots(pool)) return false;
+
+    pool->data[0] = '\0';
+    pool->size = 1;
+    return true;
+}
+
+/* Offset of text in the pool, stored the first time it is seen; 0 (the empty string) on failure. */
+static uint32_t AddString(StringPool *pool, const char *text)
+{
+    if (text == NULL || text[0] == '\0' || pool->failed) return 0;
+
+    if (2 * (pool->n_strings + 1) > pool->n_slots && !GrowSlots(pool))
+    {
+        pool->failed = true;
+        return 0;
+    }
+
+    uint32_t slot = HashString(text) & (pool->n_slots - 1);
+    for (; pool->slots[slot] != 0; slot = (slot + 1) & (pool->n_slots - 1))
+    {
+        if (strcmp(pool->data + pool->slots[slot] - 1, text) == 0) return pool->slots[slot] - 1;
+    }
+
+    size_t length = strlen(text) + 1;
+    if (pool->size + length > pool->capacity)
+    {
+        size_t capacity = 2 * (size_t)pool->capacity;
+        while (capacity < pool->size + length) capacity *= 2;
+        char *data = (capacity <= UINT32_MAX) ? realloc(pool->data, capacity) : NULL;
+        if (data == NULL)
+        {
+            pool->failed = true;
+            return 0;
+        }
+        pool->data = data;
+        pool->capacity = (uint32_t)capacity;
+    }
+
+    uint32_t offset = pool->size;
+    memcpy(pool->data + offset, text, length);
+    pool->size += (uint32_t)length;
+    pool->slots[slot] = offset + 1;
+    pool->n_strings++;
+    return offset;
+}
+
+/* Scan */
+//----------------------------------------------------------------------------------
+
+static bool FindScanPalette(ScanJob *job, uint64_t key, Color *palette)
+{
+    if (job->palettes == NULL || key == 0) return false;
+
+    bool found = false;
+    pthread_mutex_lock(&job->palettes_lock);
+    for (uint32_t slot = (uint32_t)key & (job->n_palettes - 1); job->palettes[slot].key != 0; slot = (slot + 1) & (job->n_palettes - 1))
+    {
+        if (job->palettes[slot].key == key)
+        {
+            memcpy(palette, job->palettes[slot].palette, PALETTE_SIZE * sizeof(Color));
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&job->palettes_lock);
+    return found;
+}
+
+static void AddScanPalette(ScanJob *job, uint64_t key, const Color *palette)
+{
+    if (job->palettes == NULL || key == 0) return;
+
+    pthread_mutex_lock(&job->palettes_lock);
+    uint32_t slot = (uint32_t)key & (job->n_palettes - 1);
+    while (job->palettes[slot].key != 0 && job->palettes[slot].key != key) slot = (slot + 1) & (job->n_palettes - 1);
+    job->palettes[slot].key = key;
+    memcpy(job->palettes[slot].palette, palette, PALETTE_SIZE * sizeof(Color));
+    pthread_mutex_unlock(&job->palettes_lock);
+}
+
+static void ScanFile(ScanJob *job, ScanItem *item, Arena *strings, Arena *scratch)
+{
+    LibraryEntry *entry = &item->entry;
+    if (!GetFileStatus(item->path, &entry->mtime, &entry->size))
+    {
+        entry->flags = LIBRARY_ENTRY_UNREADABLE;
+        return;
+    }
+
+    int found = (job->previous != NULL) ? FindLibraryEntry(job->previous, item->path) : -1;
+    if (found >= 0 && job->previous->backend == job->backend)
+    {
+        const LibraryEntry *previous = &job->previous->entries[found];
+        if (previous->mtime == entry->mtime && previous->size == entry->size)
+        {
+            item->previous = previous;
+            return;
+        }
+    }
+
+    CoverPicture cover;
+    ReadTrackTags(item->path, &item->info, &cover, strings);
+    uint64_t cover_key = (cover.file_type != NULL) ? HashCoverData(cover.data, cover.size) : 0;
+    if (FindScanPalette(job, cover_key, entry->palette)) entry->cover_key = cover_key;     // Another track of the album
+    else
+    {
+        entry->cover_key = LoadTrackCover(&cover, job->backend, entry->palette, NULL, scratch);
+        AddScanPalette(job, entry->cover_key, entry->palette);
+    }
+    UnloadCoverPicture(&cover);
+    ResetArena(scratch);
+
+    entry->year = item->info.year;
+    if (item->info.title == NULL) entry->flags = LIBRARY_ENTRY_UNREADABLE;
+
+    if (HasFileExtension(item->path, ".mp3")) entry->duration = EstimateMp3Duration(item->path);
+    else
+    {
+        WavSource wav;
+        if (OpenWavSource(item->path, &wav))
+        {
+            entry->duration = (float)((double)wav.frame_count / wav.sample_rate);
+            CloseWavSource(&wav);
+        }
+    }
+}
+
+static void *ScanWorker(void *arg)
+{
+    ScanThread *thread = arg;
+    ScanJob *job = thread->job;
+    int i;
+    while (!atomic_load(job->cancel) && (i = atomic_fetch_add(&job->next, 1)) < job->count)
+    {
+        ScanFile(job, &job->items[i], &thread->strings, &thread->scratch);
+    }
+    return NULL;
+}
+
+static int ComparePaths(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static bool WriteIndex(const char *path, ScanItem *items, int count, const LibraryIndex *previous, PaletteBackend backend)
+{
+    StringPool pool = { 0 };
+    LibraryEntry *entries = malloc((count > 0 ? count : 1) * sizeof(LibraryEntry));
+    if (entries == NULL || !InitStringPool(&pool))
+    {
+        free(entries);
+        free(pool.data);
+        free(pool.slots);
+        return false;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        const ScanItem *item = &items[i];
+        LibraryEntry *entry = &entries[i];
+
+        if (item->previous != NULL)
+        {
+            *entry = *item->previous;
+            entry->path = AddString(&pool, item->path);
+            entry->title = AddString(&pool, GetLibraryString(previous, item->previous->title));
+            entry->artist = AddString(&pool, GetLibraryString(previous, item->previous->artist));
+            entry->album = AddString(&pool, GetLibraryString(previous, item->previous->album));
+            entry->genre = AddString(&pool, GetLibraryString(previous, item->previous->genre));
+        }
+        else
+        {
+            *entry = item->entry;
+            entry->path = AddString(&pool, item->path);
+            entry->title = AddString(&pool, item->info.title);
+            entry->artist = AddString(&pool, item->info.artist);
+            entry->album = AddString(&pool, item->info.album);
+            entry->genre = AddString(&pool, item->info.genre);
+        }
+    }
+
+    LibraryIndexHeader header = { .version = LIBRARY_INDEX_VERSION, .entry_size = sizeof(LibraryEntry), .count = (uint32_t)count,
+                                  .strings_size = pool.size, .backend = (uint32_t)backend };
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+
+    bool ok = !pool.failed;
+    FILE *file = ok ? fopen(path, "wb") : NULL;
+    if (file != NULL)
+    {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             (count == 0 || fwrite(entries, sizeof(LibraryEntry), count, file) == (size_t)count) &&
+             fwrite(pool.data, 1, pool.size, file) == pool.size;
+        ok = (fclose(file) == 0) && ok;
+        if (!ok) remove(path);
+    }
+    else ok = false;
+
+    free(entries);
+    free(pool.data);
+    free(pool.slots);
+    return ok;
+}
+
+static bool RunScan(const char *root, const char *index_path, LibraryScanStats *stats, const atomic_bool *cancel)
+{
+    double start = Now();
+    memset(stats, 0, sizeof(LibraryScanStats));
+    if (!DirectoryExists(root)) return false;
+
+    FilePathList files = LoadDirectoryFilesEx(root, NULL, true);     // Files only, without a filter
+    qsort(files.paths, files.count, sizeof(char *), ComparePaths);
+
+    ScanItem *items = calloc((files.count > 0) ? files.count : 1, sizeof(ScanItem));
+    if (items == NULL)
+    {
+        UnloadDirectoryFiles(files);
+        return false;
+    }
+
+    int count = 0;
+    for (unsigned int i = 0; i < files.count; i++)
+    {
+        if (HasFileExtension(files.paths[i], LIBRARY_EXTENSIONS)) items[count++].path = files.paths[i];
+    }
+
+    LibraryIndex previous;
+    bool has_previous = OpenLibraryIndex(index_path, &previous);
+
+    ScanJob job = { .items = items, .count = count, .previous = has_previous ? &previous : NULL,
+                    .backend = GetPaletteBackend(), .cancel = cancel };
+    atomic_init(&job.next, 0);
+
+    // Every file and every entry of the current index fits at half load
+    int previous_count = has_previous ? previous.count : 0;
+    job.n_palettes = 16;
+    while (job.n_palettes < 2 * (uint32_t)(count + previous_count)) job.n_palettes *= 2;
+    job.palettes = calloc(job.n_palettes, sizeof(ScanPalette));
+    pthread_mutex_init(&job.palettes_lock, NULL);
+    if (has_previous && previous.backend == job.backend)
+    {
+        for (int i = 0; i < previous.count; i++) AddScanPalette(&job, previous.entries[i].cover_key, previous.entries[i].palette);
+    }
+
+    pthread_t workers[LIBRARY_INDEX_WORKERS];
+    ScanThread threads[LIBRARY_INDEX_WORKERS];
+    for (int i = 0; i < LIBRARY_INDEX_WORKERS; i++)
+    {
+        threads[i].job = &job;
+        InitArena(&threads[i].strings, LIBRARY_STRINGS_SIZE);
+        InitArena(&threads[i].scratch, TRACK_SCRATCH_SIZE);
+    }
+
+    int n_workers = 0;
+    for (int i = 0; i < LIBRARY_INDEX_WORKERS && i < count; i++)
+    {
+        if (pthread_create(&workers[n_workers], NULL, ScanWorker, &threads[n_workers]) == 0) n_workers++;
+    }
+    if (n_workers == 0) ScanWorker(&threads[0]);
+    for (int i = 0; i < n_workers; i++) pthread_join(workers[i], NULL);
+
+    bool ok = !atomic_load(cancel);
+    if (ok)
+    {
+        char new_path[INDEX_PATH_SIZE];
+        ok = FormatPath(new_path, sizeof(new_path), index_path, NEW_SUFFIX) &&
+             WriteIndex(new_path, items, count, has_previous ? &previous : NULL, job.backend);
+        if (!ok) TraceLog(LOG_WARNING, "LIBRARY: Unable to write %s%s", index_path, NEW_SUFFIX);
+    }
+
+    stats->files = count;
+    for (int i = 0; i < count; i++)
+    {
+        if (items[i].previous != NULL) stats->reused++;
+        else if (items[i].entry.flags & LIBRARY_ENTRY_UNREADABLE) stats->unreadable++;
+        else stats->read++;
+    }
+    for (int i = 0; i < LIBRARY_INDEX_WORKERS; i++)
+    {
+        stats->arena_allocations += threads[i].strings.stats.allocations + threads[i].scratch.stats.allocations;
+        stats->heap_allocations += threads[i].strings.stats.heap_blocks + threads[i].scratch.stats.heap_blocks;
+        FreeArena(&threads[i].strings);
+        FreeArena(&threads[i].scratch);
+    }
+    stats->seconds = Now() - start;
+
+    if (has_previous) CloseLibraryIndex(&previous);
+    pthread_mutex_destroy(&job.palettes_lock);
+    free(job.palettes);
+    free(items);
+    UnloadDirectoryFiles(files);
+    return ok;
+}
+
+bool ScanLibrary(const char *root, const char *index_path, LibraryScanStats *stats)
+{
+    static const atomic_bool never = false;
+    return RunScan(root, index_path, stats, &never);
+}
+
+bool ReplaceLibraryIndex(const char *index_path)
+{
+    char new_path[INDEX_PATH_SIZE];
+    if (!FormatPath(new_path, sizeof(new_path), index_path, NEW_SUFFIX) || !FileExists(new_path)) return false;
+
+#if defined(_WIN32)
+    remove(index_path);         // rename() doesn't replace on Windows
+#endif
+    return rename(new_path, index_path) == 0;
+}
+
+/* Background scan */
+//----------------------------------------------------------------------------------
+
+static void *BackgroundScanThread(void *arg)
+{
+    (void)arg;
+    background.ok = RunScan(background.root, background.index_path, &background.stats, &background.cancel);
+    atomic_store(&background.done, true);
+    return NULL;
+}
+
+bool StartLibraryScan(const char *root, const char *index_path)
+{
+    if (background.running) return false;
+    if (!FormatPath(background.root, sizeof(background.root), root, "") ||
+        !FormatPath(background.index_path, sizeof(background.index_path), index_path, ""))
+    {
+        TraceLog(LOG_WARNING, "LIBRARY: Path too long to scan %s", root);
+        return false;
+    }
+
+    atomic_store(&background.done, false);
+    atomic_store(&background.cancel, false);
+
+    background.running = (pthread_create(&background.thread, NULL, BackgroundScanThread, NULL) == 0);
+    if (!background.running) TraceLog(LOG_WARNING, "LIBRARY: Unable to create the scan thread");
+    return background.running;
+}
+
+bool PollLibraryScan(LibraryScanStats *stats)
+{
+    if (!background.running || !atomic_load(&background.done)) return false;
+
+    pthread_join(background.thread, NULL);
+    background.running = false;
+    *stats = background.stats;
+    return background.ok;
+}
+
+void StopLibraryScan(void)
+{
+    if (!background.running) return;
+
+    atomic_store(&background.cancel, true);     // Workers finish the file they are on
+    pthread_join(background.thread, NULL);
+    background.running = false;
+}
+
+/* Offline indexing */
+//----------------------------------------------------------------------------------
+
+int IndexLibraryOffline(const char *root)
+{
+    char index_path[INDEX_PATH_SIZE];
+    if (!FormatPath(index_path, sizeof(index_path), GetApplicationDirectory(), LIBRARY_INDEX_FILE))
+    {
+        printf("Unable to index %s: the application path is too long\n", root);
+        return EXIT_FAILURE;
+    }
+
+    StartTrackLoader();     // Tag and cover code, palette cache, default cover
+    LibraryScanStats stats;
+    bool ok = ScanLibrary(root, index_path, &stats) && ReplaceLibraryIndex(index_path);
+    StopTrackLoader();
+
+    if (!ok)
+    {
+        printf("Unable to index %s\n", root);
+        return EXIT_FAILURE;
+    }
+
+    printf("scan: %d files in %.1f ms (%d read, %d unchanged, %d unreadable), %d workers\n", stats.files, stats.seconds * 1000.0,
+           stats.read, stats.reused, stats.unreadable, LIBRARY_INDEX_WORKERS);
+    printf("arenas: %lld allocations, %lld blocks from the heap\n", (long long)stats.arena_allocations, (long long)stats.heap_allocations);
+
+    // What startup does: map the index and walk every entry's strings
+    double start = Now();
+    LibraryIndex index;
+    if (!OpenLibraryIndex(index_path, &index)) return EXIT_FAILURE;
+    size_t characters = 0;
+    for (int i = 0; i < index.count; i++)
+    {
+        const LibraryEntry *entry = &index.entries[i];
+        characters += strlen(GetLibraryString(&index, entry->path)) + strlen(GetLibraryString(&index, entry->title)) +
+                      strlen(GetLibraryString(&index, entry->artist)) + strlen(GetLibraryString(&index, entry->album));
+    }
+    double list_seconds = Now() - start;
+
+    printf("list: %d tracks in %.2f ms, index %.1f KB (%zu characters of paths and tags)\n", index.count, list_seconds * 1000.0,
+           index.file.size / 1024.0, characters);
+    CloseLibraryIndex(&index);
+    return EXIT_SUCCESS;
+}
@@ -9,23 +9,39 @@
 #include <math.h>
 #include <stdint.h>
 #include <string.h>
+#include <stdatomic.h>
 
 #include "raylib.h"
 #include "realfft.h"
-#include "tag_c.h"
-#include "kmeans.h"
+#include "audio_feeder.h"
+#include "track_loader.h"
+#include "playlist.h"
+#include "wav_source.h"
+#include "latency_probe.h"
+#include "alloc_probe.h"
+#include "palette_bench.h"
+#include "tag_bench.h"
+#include "library_index.h"
+#include "palette.h"
 
 #define GLSL_VERSION 330
 
 #define TWO_PI 6.28318530717959
 #define N (1 << 12)
 #define TARGET_FREQ_SIZE 10
+#define HISTORY_SIZE (1 << 15)      // Ring of recent samples, a power of 2 and well above N
+#define HISTORY_BLOCK_STAMPS 8
+#define AUDIO_DEVICE_PERIODS 3      // miniaudio's default number of device periods
+// Digital full scale of what the analyzer reads: MP3 streams and GetWavSample() are both 32-bit float, whatever the file's depth
+#define FULL_SCALE (20.0f * log10f(powf(2.0f, 32.0f) * sqrtf(3.0f / 2.0f)))
+#define SMOOTHING_FACTOR 90.0f      // Per second: how fast the bars follow the band levels
 
 
 #define SCREEN_HEIGHT 512
 #define SCREEN_WIDTH 512
 #define PROGRESS_BAR_HEIGHT 4
-#define ALBUM_COVER_SIZE 200
+#define INFO_BOX_HEIGHT 180
+#define INFO_LINE_SIZE 256          // Longer track info lines are cut; they overflow the box well before that
 #define FONTSIZE 15
 
 /*
@@ -34,16 +50,6 @@
  * 02/03/2024
  */
 
-typedef struct
-{
-    /* data */
-    char *title;
-    char *artist;
-    char *album;
-    char *genre;
-    unsigned int year;
-} MusicInfo;
-
 typedef struct
 {
     /* data */
@@ -56,19 +62,52 @@ typedef struct
 
 Data data;
 
+typedef struct
+{
+    uint64_t end_position;  // Sample position just past the block
+    double time;            // GetTime() when the block reached the processor
+} BlockStamp;
+
+/*
+ * Samples pushed by ProcessAudioStreamCallback (audio thread), tagged with
+ * their absolute sample position, so the analyzer (render thread) can pick
+ * the window that is actually audible instead of the newest one.
+ */
+typedef struct
+{
+    float samples[HISTORY_SIZE];
+    _Atomic uint64_t write_position;        // Position of the next sample pushed
+    BlockStamp stamps[HISTORY_BLOCK_STAMPS];
+    _Atomic unsigned int n_stamps;
+    _Atomic unsigned int period_frames;     // Frames the device pulls per callback, measured
+    unsigned int burst_frames;              // Audio thread only
+    double last_block_time;                 // Audio thread only
+} SampleHistory;
+
+SampleHistory history;
+
 /* Functions declaration. */
-void InitializeMusicInfo(const char *music_file_path, MusicInfo *music_info, Texture2D *album_cover_texture);
-void UninitializeMusicInfo(MusicInfo *music_info);
 void CleanUp();
-void PushSample(float sample);
+void PushSamples(float (*samples)[2], unsigned int frames);
+void AppendSamples(float (*samples)[2], unsigned int frames, double now);
+void PrimeHistory(void *bufferData, unsigned int frames);
+double GetAudioOutputLatency(unsigned int sample_rate);
+double GetNewestBlockTime(void);
+double SelectAnalysisWindow(unsigned int sample_rate);
 void ProcessAudioStreamCallback(void *bufferData, unsigned int frames);
 void ApplyHanningWindow();
+void ApplyHanningWindowFromWav(const WavSource *wav, uint64_t end_frame);
 void DoFFT();
 float GetAmp(float a, float b);
 void CalculateAmplitudes();
 void ApplyParsevalTheorem(float rms_values[], float target_frequencies[], unsigned int sample_rate);
 void RMS_TO_DBFS(float rms_values[], float full_scale, float dt, float smoothing_factor);
+void AnalyzeFrame(const WavSource *wav, uint64_t end_frame, double wav_output_time, unsigned int sample_rate, float dt);
 void VisualizeSpectrum();
+void RenderTrackInfoPanel(RenderTexture2D panel, Font font, float font_spacing, const MusicInfo *music_info);
+int QueueLibraryTracks(const LibraryIndex *library, Playlist *playlist);
+int AnalyzeWavOffline(const char *file_path);
+int CheckFrameAllocations(const char *file_path);
 
 
 // The default color theme
@@ -77,13 +116,69 @@ Color TEXT_COLOR = {255, 255, 255, 255};
 Color BOX_BORDER_COLOR = {255, 255, 255, 255};
 Color SPECTRUM_COLOR = {255, 255, 255, 255};
 
-const char *default_music_cover = "../../assets/img/default_cover.jpg"; // Default music album cover.
+float target_frequencies[TARGET_FREQ_SIZE] = {20.0f, 40.0f, 80.0f, 160.0f, 320.0f, 640.0f, 1280.0f, 2560.0f, 5120.0f, 10200.0f};
 
-int main(void)
+int main(int argc, char *argv[])
 {
+    // Offline analysis of a WAV capture: SonicSpectra --analyze capture.wav > bands.csv
+    if (argc == 3 && strcmp(argv[1], "--analyze") == 0)
+    {
+        return AnalyzeWavOffline(argv[2]);
+    }
+    // Heap calls of the per-frame path over a WAV file, debug builds only: SonicSpectra --alloc-check capture.wav
+    if (argc == 3 && strcmp(argv[1], "--alloc-check") == 0)
+    {
+        return CheckFrameAllocations(argv[2]);
+    }
+    // Palette extraction timings and tolerance check: SonicSpectra --bench-palette cover.jpg [more.jpg ...]
+    if (argc >= 3 && strcmp(argv[1], "--bench-palette") == 0)
+    {
+        return RunPaletteBenchmark(argc - 2, (const char **)&argv[2]);
+    }
+    // Tag reading timings, TagLib against the ID3v2 reader: SonicSpectra --bench-tags library/ [more.mp3 ...]
+    if (argc >= 3 && strcmp(argv[1], "--bench-tags") == 0)
+    {
+        return RunTagBenchmark(argc - 2, (const char **)&argv[2]);
+    }
+    // ID3v2 reader against TagLib on the tag fixtures: SonicSpectra --check-tags tests/tags
+    if (argc == 3 && strcmp(argv[1], "--check-tags") == 0)
+    {
+        return RunTagCheck(argv[2]);
+    }
+    // Library index built without opening a window: SonicSpectra --index-library <dir>
+    if (argc == 3 && strcmp(argv[1], "--index-library") == 0)
+    {
+        return IndexLibraryOffline(argv[2]);
+    }
+    bool start_latency_selftest = false;
+    const char *library_root = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        PaletteBackend backend;
+        if (strcmp(argv[i], "--latency-selftest") == 0)
+        {
+            start_latency_selftest = true;
+        }
+        else if (strcmp(argv[i], "--library") == 0 && i + 1 < argc)
+        {
+            library_root = argv[++i];
+        }
+        else if (strcmp(argv[i], "--palette") == 0 && i + 1 < argc)
+        {
+            if (!FindPaletteBackend(argv[++i], &backend))
+            {
+                printf("Unknown palette backend %s (kmeans, kmeans-oklab, octree or median-cut)\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            SetPaletteBackend(backend);
+        }
+    }
+
     // Initialization
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "SonicSpectra | © 2024 MacKenzie Regalado");
     InitAudioDevice(); // Initialize audio device driver.
+    StartAudioFeeder(ProcessAudioStreamCallback, PrimeHistory); // Music buffers are refilled off the render loop.
+    StartTrackLoader();                           // Dropped files are loaded off the render loop.
     SetTargetFPS(60);  // Set target FPS (maximum)
 
     //--------------------------------------------------------------------------------------
@@ -93,23 +188,52 @@ int main(void)
     UnloadImage(app_icon);
 
     //--------------------------------------------------------------------------------------
-    Music music_stream;
+    unsigned int sample_rate = 0;
+    WavSource *current_wav = NULL;         // Mapped WAV track on screen, read directly by the analyzer
     bool has_music_loaded = false;
 
+    //--------------------------------------------------------------------------------------
+    Playlist playlist = { 0 };
+    int current_index = -1;                // Playlist item on screen (and playing)
+    int loading_index = -1;                // Playlist item the track loader is working on
+    unsigned int loading_track_id = 0;
+    bool loading_starts_playback = false;  // Nothing is playing: start it instead of queueing it
+
+    // The track that plays after the current one: stream primed by the feeder, cover already in VRAM.
+    LoadedTrack next_track = { 0 };
+    Texture2D next_album_cover_texture = { 0 };
+    bool has_next_track = false;
+    int next_index = -1;
+
+    // --library: the index from the last run is listed straight away, then rescanned in the background.
+    LibraryIndex library = { 0 };
+    bool start_library = (library_root != NULL);   // Play the first track once the library is listed
+    char library_index_path[512];
+    snprintf(library_index_path, sizeof(library_index_path), "%s%s", GetApplicationDirectory(), LIBRARY_INDEX_FILE);
+    if (library_root != NULL)
+    {
+        double start = GetTime();
+        if (OpenLibraryIndex(library_index_path, &library))
+        {
+            int queued = QueueLibraryTracks(&library, &playlist);
+            TraceLog(LOG_INFO, "LIBRARY: %d tracks listed in %.2f ms", queued, (GetTime() - start) * 1000.0);
+        }
+        StartLibraryScan(library_root, library_index_path);
+    }
+
     //--------------------------------------------------------------------------------------
     Texture2D album_cover_texture;
     int album_cover_texture_posX = 32.0, album_cover_texture_posY = (SCREEN_HEIGHT/2 - ALBUM_COVER_SIZE) / 2.0;
     MusicInfo music_info = {NULL, NULL, NULL, NULL, 0};
-
-    //--------------------------------------------------------------------------------------
-    float target_frequencies[TARGET_FREQ_SIZE] = {20.0f, 40.0f, 80.0f, 160.0f, 320.0f, 640.0f, 1280.0f, 2560.0f, 5120.0f, 10200.0f};
-    float smoothing_factor = 90.0f;
-    float full_scale;   // digital full scale
+    Arena *music_arena = NULL;  // Holds music_info's strings
 
     //--------------------------------------------------------------------------------------
     float durations = 0.0f;
     float time_played = 0.0f;
 
+    //--------------------------------------------------------------------------------------
+    bool latency_selftest_pending = start_latency_selftest; // F4, or --latency-selftest at launch
+
     /* Shaders */ 
     // Load shader
     Shader shader = LoadShader(0, TextFormat("../../shaders/ripple_effect.fs", GLSL_VERSION));
@@ -137,11 +261,11 @@ int main(void)
     float font_spacing = 1.5f;
 
     // Instruction text
-    const char *instruction_text = "Drag & Drop an .mp3 file";
+    const char *instruction_text = "Drag & Drop .mp3 or .wav files";
     Vector2 instruction_text_measure = MeasureTextEx(pt_sans, instruction_text, FONTSIZE, font_spacing);
 
-    // Music information texts
-    Vector2 title_text_measure, artist_text_measure, album_text_measure, genre_text_measure, year_text_measure;
+    // Music information box: only changes with the track (and its palette), so it is drawn once and blitted every frame
+    RenderTexture2D info_panel = LoadRenderTexture(SCREEN_WIDTH - 64 + 2, INFO_BOX_HEIGHT + 2);
 
     //--------------------------------------------------------------------------------------
     // Animation
@@ -166,66 +290,37 @@ int main(void)
     }
     
 
+    RegisterAllocThread("render", true);
+
     // Main game loop
     while (!WindowShouldClose())  // Detect window close button or ESC key
     {
+        BeginAllocFrame();
 
         float dt = GetFrameTime(); // Get time in seconds for last frame drawn (delta time)
 
         /** Update */
         //----------------------------------------------------------------------------------
-        if (IsMusicReady(music_stream))
-        {
-            UpdateMusicStream(music_stream); // Update music buffer with new stream data
-        }
+        FeederStatus feeder_status = GetFeederStatus(); // Music buffers are refilled by the feeder thread.
 
         /** Handle drag & drop file. */
         //----------------------------------------------------------------------------------
         if (IsFileDropped())
         {
             FilePathList droppedFiles = LoadDroppedFiles(); // Load dropped filepaths
-            if (droppedFiles.count > 0)
+            for (unsigned int i = 0; i < droppedFiles.count; i++)
             {
-                const char *file_path = droppedFiles.paths[0]; // We are only interested in a single file.
-
-                if (IsPathFile(file_path) && IsFileExtension(file_path, ".mp3"))
-                { // Check if the file is a valid mp3 file.
-                    /**
-                     * Before loading a new music file, make sure to unload any existing ones.
-                     */
-                    if (has_music_loaded)
-                    {
-                        UninitializeMusicInfo(&music_info);                                          // Deallocate memory.
-                        StopMusicStream(music_stream);                                               // Stop music playing
-                        DetachAudioStreamProcessor(music_stream.stream, ProcessAudioStreamCallback); // Disconnect audio stream processor
-                        UnloadMusicStream(music_stream);                                             // Unload music stream buffers from RAM
-                        UnloadTexture(album_cover_texture);                                          // Texture unloading
-                    }
-                    //----------------------------------------------------------------------------------
-                    music_stream = LoadMusicStream(file_path); // Load music stream from file
-                    // ----------------------------------------------------------------------------------
-                    if (IsMusicReady(music_stream))   // Checks if the music stream is ready
+                const char *file_path = droppedFiles.paths[i];
+
+                if (IsPathFile(file_path) && IsFileExtension(file_path, ".mp3;.wav"))
+                { // Check if the file is a valid mp3 or wav file.
+                    int index = AddToPlaylist(&playlist, file_path); // Queued behind whatever is playing.
+
+                    if (index >= 0 && current_index < 0 && loading_index < 0)
                     {
-                        // ----------------------------------------------------------------------------------
-                        has_music_loaded = true;
-                        sonic_animation_current_frame = 0;
-                        durations = GetMusicTimeLength(music_stream);
-                        // ----------------------------------------------------------------------------------
-                        InitializeMusicInfo(file_path, &music_info, &album_cover_texture);
-                        // ----------------------------------------------------------------------------------
-                        full_scale = 20.0f * log10f(powf(2.0f, (float) music_stream.stream.sampleSize) * sqrtf(3.0f / 2.0f));
-                        // ----------------------------------------------------------------------------------
-                        CleanUp();
-                        // ----------------------------------------------------------------------------------
-                        PlayMusicStream(music_stream);                                               // Start music playing
-                        AttachAudioStreamProcessor(music_stream.stream, ProcessAudioStreamCallback); // Attach audio stream processor to stream, receives the samples as <float>s
-                        // ----------------------------------------------------------------------------------
-                        title_text_measure = MeasureTextEx(pt_sans, TextFormat("Title: %s", music_info.title), FONTSIZE, font_spacing);
-                        artist_text_measure = MeasureTextEx(pt_sans, TextFormat("Artist: %s", music_info.artist), FONTSIZE, font_spacing);
-                        album_text_measure = MeasureTextEx(pt_sans, TextFormat("Album: %s", music_info.album), FONTSIZE, font_spacing);
-                        genre_text_measure = MeasureTextEx(pt_sans, TextFormat("Genre: %s", music_info.genre), FONTSIZE, font_spacing);
-                        year_text_measure = MeasureTextEx(pt_sans, TextFormat("Year: %d", music_info.year), FONTSIZE, font_spacing);
-                        // ----------------------------------------------------------------------------------
+                        loading_index = index;
+                        loading_track_id = RequestTrackLoad(file_path); // Loaded on a worker thread.
+                        loading_starts_playback = true;
                     }
                 }
             }
@@ -233,28 +328,198 @@ int main(void)
             UnloadDroppedFiles(droppedFiles); // Unload dropped filepaths
         }
 
+        /** Library rescan finished: swap in the new index, queue the tracks it found. */
+        //----------------------------------------------------------------------------------
+        LibraryScanStats scan_stats;
+        if (PollLibraryScan(&scan_stats))
+        {
+            CloseLibraryIndex(&library);
+            if (ReplaceLibraryIndex(library_index_path) && OpenLibraryIndex(library_index_path, &library))
+            {
+                int queued = QueueLibraryTracks(&library, &playlist);
+                TraceLog(LOG_INFO, "LIBRARY: %d files scanned in %.1f ms (%d read, %d unchanged), %d new tracks queued",
+                         scan_stats.files, scan_stats.seconds * 1000.0, scan_stats.read, scan_stats.reused, queued);
+            }
+        }
+
+        if (start_library && playlist.count > 0 && current_index < 0 && loading_index < 0)
+        {
+            start_library = false;
+            loading_index = 0;  // Nothing dropped yet: start the library from the top
+            loading_track_id = RequestTrackLoad(GetPlaylistPath(&playlist, 0));
+            loading_starts_playback = true;
+        }
+
+        /** Preload the next playlist item well before the current one ends. */
+        //----------------------------------------------------------------------------------
+        if (current_index >= 0 && loading_index < 0 && !has_next_track)
+        {
+            int index = GetNextPlaylistIndex(&playlist, current_index);
+            if (index >= 0)
+            {
+                loading_index = index;
+                loading_track_id = RequestTrackLoad(GetPlaylistPath(&playlist, index));
+                loading_starts_playback = false;
+            }
+        }
+
+        /** Pick up tracks finished by the loader. */
         //----------------------------------------------------------------------------------
-        if (IsMusicReady(music_stream))
+        LoadedTrack loaded_track;
+        while (PollLoadedTrack(&loaded_track))
         {
-            /** Apply the hanning window. */
-            ApplyHanningWindow();
+            if (loaded_track.id != loading_track_id)
+            {
+                UnloadLoadedTrack(&loaded_track); // No longer wanted.
+                continue;
+            }
+            loading_track_id = 0;
 
-            /** Do FFT */
-            DoFFT();
+            if (!loaded_track.ok)
+            {
+                TraceLog(LOG_WARNING, "PLAYLIST: Unable to load %s", loaded_track.file_path);
+                UnloadLoadedTrack(&loaded_track);
+                MarkPlaylistItemFailed(&playlist, loading_index);  // Skipped from now on
+                int index = GetNextPlaylistIndex(&playlist, loading_index);
+                loading_index = -1;
+
+                // Nothing playing yet: try the next item. A failed preload is picked up again by the preload above.
+                if (loading_starts_playback && index >= 0)
+                {
+                    loading_index = index;
+                    loading_track_id = RequestTrackLoad(GetPlaylistPath(&playlist, index));
+                }
+                continue;
+            }
 
-            /** Calculate amplitudes. */
-            CalculateAmplitudes();
+            next_track = loaded_track;
+            next_index = loading_index;
+            has_next_track = true;
+            next_album_cover_texture = LoadTextureFromImage(next_track.album_cover);   // Image converted to texture, GPU memory (VRAM)
+            UnloadImage(next_track.album_cover);
+            next_track.album_cover = (Image) { 0 };
+            loading_index = -1;
 
+            if (next_track.wav != NULL)
+            {
+                if (loading_starts_playback) FeederPlayWav(next_track.wav, next_track.id);
+                else FeederQueueNextWav(next_track.wav, next_track.id);
+            }
+            else
+            {
+                if (loading_starts_playback) FeederPlay(next_track.music, next_track.mp3_index, next_track.id);  // Hand the stream to the feeder thread, which starts it
+                else FeederQueueNext(next_track.music, next_track.mp3_index, next_track.id);                     // Primed by the feeder, started at the end of the current track
+            }
+        }
+
+        /** Latency and heap call overlay (F3), click track self-test (F4). */
+        //----------------------------------------------------------------------------------
+        if (IsKeyPressed(KEY_F3)) SetLatencyReporting(!IsLatencyReporting());
+        if (IsKeyPressed(KEY_F4)) latency_selftest_pending = true;
+
+        /** Palette backend (F5), for the tracks loaded from now on. */
+        //----------------------------------------------------------------------------------
+        if (IsKeyPressed(KEY_F5))
+        {
+            PaletteBackend backend = (GetPaletteBackend() + 1) % PALETTE_BACKEND_COUNT;
+            SetPaletteBackend(backend);
+            TraceLog(LOG_INFO, "PALETTE: Backend %s, from the next track loaded", GetPaletteBackendName(backend));
+        }
+
+        if (latency_selftest_pending && !IsLatencySelfTestRunning())
+        {
+            latency_selftest_pending = false;
+            FeederPause();  // The clicks play alone
+            CleanUp();
+            if (!StartLatencySelfTest(ProcessAudioStreamCallback)) FeederResume();
+        }
+        bool latency_selftest = IsLatencySelfTestRunning();
+
+        /** Seek by clicking on the progress bar, where the sonic sprite runs. */
+        //----------------------------------------------------------------------------------
+        if (has_music_loaded && !latency_selftest && durations > 0.0f && IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
+        {
+            Vector2 mouse = GetMousePosition();
+            if (mouse.y >= SCREEN_HEIGHT - sonic_prog_bar_sprite.height && mouse.x >= 32 && mouse.x <= SCREEN_WIDTH - 32)
+            {
+                float position = (mouse.x - sonic_frame_rec.width / 2) / (SCREEN_WIDTH - 64) * durations;  // Sprite centered on the cursor
+                position = fminf(fmaxf(position, 0.0f), durations - 0.01f);
+
+                FeederSeek(position);   // The feeder primes the analyzer history with what leads up to it
+            }
+        }
+
+        /** Follow the feeder onto the next track (gapless switch, or skip with the right arrow key). */
+        //----------------------------------------------------------------------------------
+        if (has_next_track && feeder_status.has_next && IsKeyPressed(KEY_RIGHT))
+        {
+            FeederAdvance();
+        }
+
+        if (has_next_track && feeder_status.track_id == next_track.id)
+        {
+            /**
+             * Before switching to the new music file, make sure to unload any existing ones.
+             */
+            if (has_music_loaded)
+            {
+                ReleaseTrackArena(music_arena);                                              // Its strings, all at once
+                UnloadTexture(album_cover_texture);                                          // Texture unloading
+            }
+            else
+            {
+                CleanUp(); // Across a gapless switch the analyzer history carries over instead.
+            }
+            // ----------------------------------------------------------------------------------
+            has_music_loaded = true;
+            has_next_track = false;
+            current_index = next_index;
+            sonic_animation_current_frame = 0;
+            sample_rate = next_track.sample_rate;
+            if (current_wav != NULL)
+            {
+                CloseWavSource(current_wav);                                                 // The feeder has already moved off it
+                free(current_wav);
+            }
+            current_wav = next_track.wav;
+            durations = next_track.durations;
+            music_info = next_track.music_info;
+            music_arena = next_track.arena;                                                  // The path goes with it
+            album_cover_texture = next_album_cover_texture;
+            // ----------------------------------------------------------------------------------
+            BG_COLOR = next_track.palette[0];
+            TEXT_COLOR = next_track.palette[2];
+            SPECTRUM_COLOR = next_track.palette[1];
+            BOX_BORDER_COLOR = next_track.palette[3];
+            // ----------------------------------------------------------------------------------
+            RenderTrackInfoPanel(info_panel, pt_sans, font_spacing, &music_info);                 // New strings, new colors
+            // ----------------------------------------------------------------------------------
+        }
+
+        //----------------------------------------------------------------------------------
+        if (has_music_loaded || latency_selftest)
+        {
+            unsigned int analysis_rate = latency_selftest ? LATENCY_SELFTEST_SAMPLE_RATE : sample_rate;
+
+            BeginLatencyFrame();
+            /*
+             * A WAV is windowed straight from the mapping, centered on the sample being heard:
+             * the feeder reports what has been mixed, which the device plays the same latency
+             * later that SelectAnalysisWindow() allows for.
+             */
+            const WavSource *analysis_wav = latency_selftest ? NULL : current_wav;
+            double output_latency = GetAudioOutputLatency(sample_rate);
+            double heard = feeder_status.time_played - output_latency;
+            if (feeder_status.playing) heard += GetTime() - feeder_status.time;
+            uint64_t heard_frame = (heard > 0.0) ? (uint64_t)(heard * sample_rate) : 0;
+
+            // time_played was mixed at feeder_status.time; the window's center is heard that far from it, plus the latency.
+            double center_output = feeder_status.time + output_latency + ((double)heard_frame / sample_rate - feeder_status.time_played);
+            AnalyzeFrame(analysis_wav, heard_frame + N / 2, center_output, analysis_rate, dt);
             //----------------------------------------------------------------------------------
-            float rms_values[TARGET_FREQ_SIZE - 1] = {0.0};
-            //----------------------------------------------------------------------------------
-            ApplyParsevalTheorem(rms_values, target_frequencies, music_stream.stream.sampleRate);
-            //----------------------------------------------------------------------------------
-            RMS_TO_DBFS(rms_values, full_scale, dt, smoothing_factor);
-            //----------------------------------------------------------------------------------
-            if (durations > 0.0f)
+            if (has_music_loaded && durations > 0.0f)
             {
-                time_played = GetMusicTimePlayed(music_stream) / durations * (SCREEN_WIDTH - 64);
+                time_played = feeder_status.time_played / durations * (SCREEN_WIDTH - 64);
                 sonic_animation_pos.x = time_played;
             }
             //----------------------------------------------------------------------------------
@@ -290,6 +555,7 @@ int main(void)
         /** Draw */
         //----------------------------------------------------------------------------------
         BeginDrawing();
+        MarkLatencyStage(LATENCY_STAGE_DRAW_START, GetTime());
         //----------------------------------------------------------------------------------
         ClearBackground(BG_COLOR);
         //----------------------------------------------------------------------------------
@@ -312,28 +578,11 @@ int main(void)
             EndShaderMode();
 
             //----------------------------------------------------------------------------------
-            DrawRectangleLines(32, SCREEN_HEIGHT/2, SCREEN_WIDTH - 64, 180, BOX_BORDER_COLOR);
-
-            //----------------------------------------------------------------------------------
-            int total_text_height = title_text_measure.y + artist_text_measure.y + album_text_measure.y + genre_text_measure.y + year_text_measure.y;
-            int max_text_width = fmaxf(title_text_measure.x, artist_text_measure.x);
-                max_text_width = fmaxf(max_text_width, album_text_measure.x);
-                max_text_width = fmaxf(max_text_width, genre_text_measure.x);
-                max_text_width = fmaxf(max_text_width, year_text_measure.x);
-
-            //----------------------------------------------------------------------------------
-            int offSetY = (180 - total_text_height) / 2;
-            int offSetX = ((SCREEN_WIDTH - 64) - max_text_width) / 2;
-
-            //----------------------------------------------------------------------------------
-            DrawTextEx(pt_sans, TextFormat("Title: %s", music_info.title), (Vector2) {32 + offSetX, SCREEN_HEIGHT/2 + offSetY}, FONTSIZE, font_spacing, TEXT_COLOR);
-            DrawTextEx(pt_sans, TextFormat("Artist: %s", music_info.artist), (Vector2) {32 + offSetX, (SCREEN_HEIGHT/2 + FONTSIZE) + offSetY}, FONTSIZE, font_spacing, TEXT_COLOR);
-            DrawTextEx(pt_sans, TextFormat("Album: %s", music_info.album), (Vector2) {32 + offSetX, (SCREEN_HEIGHT/2 + (2 * FONTSIZE)) + offSetY}, FONTSIZE, font_spacing, TEXT_COLOR);
-            DrawTextEx(pt_sans, TextFormat("Genre: %s", music_info.genre), (Vector2) {32 + offSetX, (SCREEN_HEIGHT/2 + (3 * FONTSIZE)) + offSetY}, FONTSIZE, font_spacing, TEXT_COLOR);
-            DrawTextEx(pt_sans, TextFormat("Year: %d", music_info.year), (Vector2) {32 + offSetX, (SCREEN_HEIGHT/2 + (4 * FONTSIZE)) + offSetY}, FONTSIZE, font_spacing, TEXT_COLOR);
+            // Box and track info, as RenderTrackInfoPanel() left them (render textures are stored upside down)
+            DrawTextureRec(info_panel.texture, (Rectangle) {0, 0, info_panel.texture.width, -info_panel.texture.height}, (Vector2) {31, SCREEN_HEIGHT/2 - 1}, WHITE);
         }
         //----------------------------------------------------------------------------------
-        if (IsMusicReady(music_stream))
+        if (has_music_loaded)
         {
             //----------------------------------------------------------------------------------
             VisualizeSpectrum();
@@ -341,17 +590,63 @@ int main(void)
             DrawTextureRec(sonic_prog_bar_sprite, sonic_frame_rec, sonic_animation_pos, WHITE);  // Draw part of the texture
             DrawTextureRec(flag_prog_bar_sprite, flag_frame_rec, flag_animation_pos, WHITE);  // Draw part of the texture
         }
+        else if (latency_selftest)
+        {
+            VisualizeSpectrum();
+        }
+        MarkLatencyStage(LATENCY_STAGE_DRAW_END, GetTime());     // The overlay below isn't counted
+        //----------------------------------------------------------------------------------
+        if (IsLatencyReporting())
+        {
+            DrawLatencyOverlay(8, 8, 10, RAYWHITE);
+            DrawAllocOverlay(8, 8 + (LATENCY_INTERVAL_COUNT + 2) * 12, 10, RAYWHITE);
+        }
         //----------------------------------------------------------------------------------
         EndDrawing();
         //----------------------------------------------------------------------------------
+        double swap_time = GetTime();
+        MarkLatencyStage(LATENCY_STAGE_FRAME_SWAP, swap_time);
+        EndLatencyFrame();
+        EndAllocFrame();
+        if (latency_selftest && !UpdateLatencySelfTest(data.smooth_spectrum[2], swap_time, GetAudioOutputLatency(LATENCY_SELFTEST_SAMPLE_RATE)))
+        {
+            CleanUp();
+            if (has_music_loaded) FeederResume();
+        }
+        //----------------------------------------------------------------------------------
     }
 
     /** De-Initialization */
     //----------------------------------------------------------------------------------
+    StopLatencySelfTest();
+    //----------------------------------------------------------------------------------
+    StopLibraryScan();                                                              // Before the loader: the scan reads tags through it
+    CloseLibraryIndex(&library);
+    //----------------------------------------------------------------------------------
+    StopTrackLoader();                                                              // Joins the workers and drops unclaimed loads
+    //----------------------------------------------------------------------------------
+    StopAudioFeeder();                                                              // Stops and unloads the music streams it owns
+    //----------------------------------------------------------------------------------
+    if (has_next_track)
+    {
+        ReleaseTrackArena(next_track.arena);                                        // Its stream was owned by the feeder
+        UnloadTexture(next_album_cover_texture);
+        if (next_track.wav != NULL)
+        {
+            CloseWavSource(next_track.wav);
+            free(next_track.wav);
+        }
+    }
+    if (current_wav != NULL)
+    {
+        CloseWavSource(current_wav);
+        free(current_wav);
+    }
+    UnloadPlaylist(&playlist);
+    //----------------------------------------------------------------------------------
     if (has_music_loaded)
     {
-        DetachAudioStreamProcessor(music_stream.stream, ProcessAudioStreamCallback); // Disconnect audio stream processor
-        UnloadMusicStream(music_stream);                                             // Unload music stream buffers from RAM
+        ReleaseTrackArena(music_arena);                                             // Deallocate memory.
         UnloadTexture(album_cover_texture);                                         // Texture unloading
     }
     //----------------------------------------------------------------------------------
@@ -359,6 +654,8 @@ int main(void)
     //----------------------------------------------------------------------------------
     UnloadFont(pt_sans);
     //----------------------------------------------------------------------------------
+    UnloadRenderTexture(info_panel);
+    //----------------------------------------------------------------------------------
     UnloadTexture(sonic_prog_bar_sprite); 
     //----------------------------------------------------------------------------------
     UnloadTexture(flag_prog_bar_sprite);
@@ -371,152 +668,123 @@ int main(void)
     return EXIT_SUCCESS;
 }
 
-void InitializeMusicInfo(const char *music_file_path, MusicInfo *music_info, Texture2D *album_cover_texture)
+void CleanUp()
 {
-    taglib_set_strings_unicode(1);
-    TagLib_File *file;
-    TagLib_Tag *tag;
-
-    file = taglib_file_new(music_file_path);
-
-    if (file == NULL)
-    {
-        printf("Unable to create file!\n");
-        return;
-    }
-
-    tag = taglib_file_tag(file);
-    if (tag != NULL)
-    {
-        char *title  = taglib_tag_title(tag);
-        char *artist = taglib_tag_artist(tag);
-        char *album  = taglib_tag_album(tag);
-        char *genre  = taglib_tag_genre(tag);
-
-        /* Set the music file's basic information to the music_info struct. */
-        music_info->title  = calloc(strlen(title)  + 1, sizeof(char));
-        music_info->artist = calloc(strlen(artist) + 1, sizeof(char));
-        music_info->album  = calloc(strlen(album)  + 1, sizeof(char));
-        music_info->genre  = calloc(strlen(genre)  + 1, sizeof(char));
-        music_info->year   = taglib_tag_year(tag);
-
-        if (music_info->title != NULL)
-        {
-            strcpy(music_info->title, title);
-        }
-        if (music_info->artist != NULL)
-        {
-            strcpy(music_info->artist, artist);
-        }
-        if (music_info->album != NULL)
-        {
-            strcpy(music_info->album, album);
-        }
-        if (music_info->genre != NULL)
-        {
-            strcpy(music_info->genre, genre);
-        }
-    }
-
-    /* Extract album picture */
-    TagLib_Complex_Property_Attribute ***properties = taglib_complex_property_get(file, "PICTURE");
-    TagLib_Complex_Property_Picture_Data picture;
-    taglib_picture_from_complex_property(properties, &picture);
+    memset(history.samples, 0, HISTORY_SIZE * sizeof(float));
+    memset(data.input_raw_Data, 0, N * sizeof(float));
+    memset(data.input_data_with_windowing_function, 0, N * sizeof(float));
+    memset(data.output_raw_Data, 0, N * sizeof(float));
+    memset(data.amplitudes, 0, (N / 2) * sizeof(float));
+    memset(data.smooth_spectrum, 0, (TARGET_FREQ_SIZE - 1) * sizeof(float));
+}
 
-    /* Set album cover photo */
-    Image image = LoadImageFromMemory(".jpg", (unsigned char *)picture.data, picture.size); // Load image from memory buffer, fileType refers to extension: i.e. '.png'
+void PushSamples(float (*samples)[2], unsigned int frames)
+{
+    double now = GetTime();
 
-    if (!IsImageReady(image))
+    // Blocks arriving back to back belong to one device callback; its size is the device period.
+    if (now - history.last_block_time > 0.001)
     {
-        image = LoadImage(default_music_cover);
+        if (history.burst_frames > 0) atomic_store_explicit(&history.period_frames, history.burst_frames, memory_order_relaxed);
+        history.burst_frames = 0;
     }
+    history.burst_frames += frames;
+    history.last_block_time = now;
 
-    ImageResize(&image, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE); // Resize image (Bicubic scaling algorithm)
-
-    *album_cover_texture = LoadTextureFromImage(image); // Image converted to texture, GPU memory (VRAM)
-
-    int n_points = ALBUM_COVER_SIZE * ALBUM_COVER_SIZE;
+    AppendSamples(samples, frames, now);
+}
 
-    Color *color_data = malloc(n_points * sizeof(Color));
+void AppendSamples(float (*samples)[2], unsigned int frames, double now)
+{
+    uint64_t position = atomic_load_explicit(&history.write_position, memory_order_relaxed);
 
-    if (color_data != NULL) 
+    for (size_t frame = 0; frame < frames; frame++)
     {
-        // Fill with colors
-        for (int i = 0; i < n_points; i++)
-        {            
-            int row = (int) i / ALBUM_COVER_SIZE;
-            int col = (int) i % ALBUM_COVER_SIZE;
-            color_data[i] = GetImageColor(image, row, col);
-        }
-
-        /*
-         * Extract Color pallete of size 4 in an image.
-         * Color Quantization Using k-Means Clustering Algorithm.
-         */
-        int color_pallete_size = 4;
-        Color *color_pallete = malloc(color_pallete_size * sizeof(Color));        // Note: Size = 4 is fixed.
-        getDominantColors(n_points, color_data, color_pallete, color_pallete_size); // From kmeans.h
-
-        BG_COLOR = color_pallete[0];
-        TEXT_COLOR = color_pallete[2];
-        SPECTRUM_COLOR = color_pallete[1];
-        BOX_BORDER_COLOR = color_pallete[3];
-
-        free(color_pallete);
-        color_pallete = NULL;
+        /* code */
+        history.samples[(position + frame) & (HISTORY_SIZE - 1)] = samples[frame][0]; // We only interested in the left audio channel.
     }
+    position += frames;
+    atomic_store_explicit(&history.write_position, position, memory_order_release);
 
-    free(color_data);
-    UnloadImage(image);
+    unsigned int n_stamps = atomic_load_explicit(&history.n_stamps, memory_order_relaxed);
+    history.stamps[n_stamps % HISTORY_BLOCK_STAMPS] = (BlockStamp) { position, now };
+    atomic_store_explicit(&history.n_stamps, n_stamps + 1, memory_order_release);
+}
 
-    // free
-    taglib_complex_property_free(properties);
-    taglib_tag_free_strings();
-    taglib_file_free(file);
+void PrimeHistory(void *bufferData, unsigned int frames)
+{
+    /*
+     * Called by the feeder on a seek, with the frames leading up to the new
+     * position and the processor detached. They go in as a block reaching the
+     * processor now, so the next window is taken around the new position. The
+     * period measurement is left alone: this is not a device callback.
+     */
+    AppendSamples(bufferData, frames, GetTime());
 }
 
-void UninitializeMusicInfo(MusicInfo *music_info)
+void ProcessAudioStreamCallback(void *bufferData, unsigned int frames)
 {
-    free(music_info->title);
-    music_info->title = NULL;
-    free(music_info->artist);
-    music_info->artist = NULL;
-    free(music_info->album);
-    music_info->album = NULL;
-    free(music_info->genre);
-    music_info->genre = NULL;
-    music_info->year = 0;
+    /**
+     * https://cdecl.org/?q=float+%28*fs%29%5B2%5D
+     * Samples internally stored as <float>s
+     */
+    float(*samples)[2] = bufferData;
+
+    RegisterAllocThread("audio", true);   // Counted apart from the first block on
+    PushSamples(samples, frames);
+    return;
 }
 
-void CleanUp()
+double GetAudioOutputLatency(unsigned int sample_rate)
 {
-    memset(data.input_raw_Data, 0, N * sizeof(float));
-    memset(data.input_data_with_windowing_function, 0, N * sizeof(float));
-    memset(data.output_raw_Data, 0, N * sizeof(float));
-    memset(data.amplitudes, 0, (N / 2) * sizeof(float));
-    memset(data.smooth_spectrum, 0, (TARGET_FREQ_SIZE - 1) * sizeof(float));
+    /* Seconds between a block reaching the processor and being heard. */
+    return (double)atomic_load_explicit(&history.period_frames, memory_order_relaxed) * AUDIO_DEVICE_PERIODS / sample_rate;
 }
 
-void PushSample(float sample)
+double GetNewestBlockTime(void)
 {
-    memmove(data.input_raw_Data, data.input_raw_Data + 1, (N - 1) * sizeof(data.input_raw_Data[0])); // Moving history to the left
-    data.input_raw_Data[N - 1] = sample;                                                             // Adding last average value
+    unsigned int n_stamps = atomic_load_explicit(&history.n_stamps, memory_order_acquire);
+    if (n_stamps == 0) return GetTime();
+    return history.stamps[(n_stamps - 1) % HISTORY_BLOCK_STAMPS].time;
 }
 
-void ProcessAudioStreamCallback(void *bufferData, unsigned int frames)
+double SelectAnalysisWindow(unsigned int sample_rate)
 {
-    /**
-     * https://cdecl.org/?q=float+%28*fs%29%5B2%5D
-     * Samples internally stored as <float>s
+    /*
+     * Blocks reach the processor when they are mixed, and are heard only after
+     * the device has played the periods queued before them. Estimate the sample
+     * being output right now from the newest block stamp and that latency, and
+     * center the window on it (or take the newest N samples if it is too recent).
      */
-    float(*samples)[2] = bufferData;
+    uint64_t newest = atomic_load_explicit(&history.write_position, memory_order_acquire);
+    unsigned int n_stamps = atomic_load_explicit(&history.n_stamps, memory_order_acquire);
 
-    for (size_t frame = 0; frame < frames; frame++)
+    double now = GetTime();
+    BlockStamp stamp = { 0, now };
+    double latency = 0.0;
+
+    int64_t start = (int64_t)newest - N;
+    if (n_stamps > 0)
     {
-        /* code */
-        PushSample(samples[frame][0]); // We only interested in the left audio channel.
+        stamp = history.stamps[(n_stamps - 1) % HISTORY_BLOCK_STAMPS];
+        latency = (double)atomic_load_explicit(&history.period_frames, memory_order_relaxed) * AUDIO_DEVICE_PERIODS;
+        double playhead = (double)stamp.end_position - latency + (now - stamp.time) * sample_rate;
+
+        start = (int64_t)playhead - N / 2;
     }
-    return;
+
+    if (start > (int64_t)newest - N) start = (int64_t)newest - N;
+    if (start < (int64_t)newest - (HISTORY_SIZE - N)) start = (int64_t)newest - (HISTORY_SIZE - N); // Stay clear of the writer
+    if (start < 0) start = 0;
+
+    for (size_t n = 0; n < N; n++)
+    {
+        data.input_raw_Data[n] = history.samples[((uint64_t)start + n) & (HISTORY_SIZE - 1)];
+    }
+
+    // When the center of the window will be (or was) heard.
+    double center = (double)start + N / 2;
+    return stamp.time + (center - (double)stamp.end_position + latency) / sample_rate;
 }
 
 void ApplyHanningWindow()
@@ -530,6 +798,20 @@ void ApplyHanningWindow()
     }
 }
 
+void ApplyHanningWindowFromWav(const WavSource *wav, uint64_t end_frame)
+{
+    /* Same window as ApplyHanningWindow(), over the N frames before end_frame, read in place. */
+    uint64_t start_frame = (end_frame > N) ? end_frame - N : 0;
+
+    for (size_t n = 0; n < N; n++)
+    {
+        /* code */
+        float t = (float)n / (N - 1);
+        float h = (0.5 * (1.0 - cosf(TWO_PI * t)));
+        data.input_data_with_windowing_function[n] = GetWavSample(wav, start_frame + n, 0) * h; // Left channel, like the stream processor.
+    }
+}
+
 void DoFFT()
 {
     memcpy(data.output_raw_Data, data.input_data_with_windowing_function, N * sizeof(float));
@@ -613,6 +895,45 @@ void RMS_TO_DBFS(float rms_values[], float full_scale, float dt, float smoothing
     }
 }
 
+/*
+ * One frame's analysis, as the render loop runs it: the Hanning window over
+ * the newest samples from the audio thread or, with wav, over the mapped
+ * file up to end_frame; then the FFT and the band levels, smoothed into
+ * data.smooth_spectrum over dt. Stamps the analysis stages of the latency
+ * frame; for wav the output stage is wav_output_time, when the caller
+ * expects the window's center to be heard (negative when there is none).
+ */
+void AnalyzeFrame(const WavSource *wav, uint64_t end_frame, double wav_output_time, unsigned int sample_rate, float dt)
+{
+    double analysis_start = GetTime();
+    MarkLatencyStage(LATENCY_STAGE_SAMPLE_ARRIVAL, GetNewestBlockTime());
+    MarkLatencyStage(LATENCY_STAGE_ANALYSIS_START, analysis_start);
+
+    /** Apply the hanning window. */
+    if (wav != NULL)
+    {
+        ApplyHanningWindowFromWav(wav, end_frame);
+        if (wav_output_time >= 0.0) MarkLatencyStage(LATENCY_STAGE_AUDIO_OUTPUT, wav_output_time);
+    }
+    else
+    {
+        MarkLatencyStage(LATENCY_STAGE_AUDIO_OUTPUT, SelectAnalysisWindow(sample_rate));
+        ApplyHanningWindow();
+    }
+
+    /** Do FFT */
+    DoFFT();
+
+    /** Calculate amplitudes. */
+    CalculateAmplitudes();
+
+    float rms_values[TARGET_FREQ_SIZE - 1] = {0.0};
+    ApplyParsevalTheorem(rms_values, target_frequencies, sample_rate);
+    RMS_TO_DBFS(rms_values, FULL_SCALE, dt, SMOOTHING_FACTOR);
+
+    MarkLatencyStage(LATENCY_STAGE_ANALYSIS_END, GetTime());
+}
+
 void VisualizeSpectrum()
 {
     int h = FONTSIZE + 4 + ALBUM_COVER_SIZE;
@@ -627,3 +948,220 @@ void VisualizeSpectrum()
         }
     }
 }
+
+/* label_format with one string, cut at a UTF-8 character boundary when it doesn't fit. */
+static void FormatInfoLine(char *line, const char *label_format, const char *value)
+{
+    if (snprintf(line, INFO_LINE_SIZE, label_format, value) < INFO_LINE_SIZE) return;
+
+    int last = INFO_LINE_SIZE - 2;
+    while (last > 0 && ((unsigned char)line[last] & 0xC0) == 0x80) last--;     // Start of the last character
+    unsigned char lead = (unsigned char)line[last];
+    int length = (lead < 0x80) ? 1 : (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : 2;
+    if (last + length > INFO_LINE_SIZE - 1) line[last] = '\0';
+}
+
+void RenderTrackInfoPanel(RenderTexture2D panel, Font font, float font_spacing, const MusicInfo *music_info)
+{
+    /*
+     * The box and the five lines of track info, centered in it, drawn into the
+     * panel as they would be on screen with the panel's top left corner at
+     * (31, SCREEN_HEIGHT/2 - 1): one pixel of margin keeps the outline inside.
+     * The background is opaque and the alpha channel is brought back to one
+     * after the text, so a blit lands the same pixels the text used to draw
+     * directly.
+     */
+    double start = GetTime();
+
+    char lines[5][INFO_LINE_SIZE];      // TextFormat() only rotates through four buffers
+    FormatInfoLine(lines[0], "Title: %s", music_info->title);
+    FormatInfoLine(lines[1], "Artist: %s", music_info->artist);
+    FormatInfoLine(lines[2], "Album: %s", music_info->album);
+    FormatInfoLine(lines[3], "Genre: %s", music_info->genre);
+    snprintf(lines[4], sizeof(lines[4]), "Year: %u", music_info->year);
+
+    int total_text_height = 0;
+    int max_text_width = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        Vector2 measure = MeasureTextEx(font, lines[i], FONTSIZE, font_spacing);
+        total_text_height += measure.y;
+        max_text_width = fmaxf(max_text_width, measure.x);
+    }
+
+    int offSetY = (INFO_BOX_HEIGHT - total_text_height) / 2;
+    int offSetX = ((SCREEN_WIDTH - 64) - max_text_width) / 2;
+
+    BeginTextureMode(panel);
+    ClearBackground(BG_COLOR);
+
+    DrawRectangleLines(1, 1, SCREEN_WIDTH - 64, INFO_BOX_HEIGHT, BOX_BORDER_COLOR);
+    for (int i = 0; i < 5; i++)
+    {
+        DrawTextEx(font, lines[i], (Vector2) {1 + offSetX, 1 + i * FONTSIZE + offSetY}, FONTSIZE, font_spacing, TEXT_COLOR);
+    }
+
+    // BLEND_ALPHA blends alpha too, leaving the glyph edges see-through: adding opaque black keeps the colors and saturates alpha
+    BeginBlendMode(BLEND_ADD_COLORS);
+    DrawRectangle(0, 0, panel.texture.width, panel.texture.height, BLACK);
+    EndBlendMode();
+    EndTextureMode();
+
+    TraceLog(LOG_DEBUG, "UI: Track info panel drawn in %.3f ms", (GetTime() - start) * 1000.0);
+}
+
+int AnalyzeWavOffline(const char *file_path)
+{
+    /* Band levels (dBFS) of every half-overlapping window of a WAV file, as CSV on stdout. */
+    WavSource wav;
+    if (!OpenWavSource(file_path, &wav))
+    {
+        printf("Unable to open %s\n", file_path);
+        return EXIT_FAILURE;
+    }
+    WavReadAhead read_ahead = { 0 };    // Read front to back, once
+
+
+    printf("time");
+    for (int i = 0; i < TARGET_FREQ_SIZE - 1; i++)
+    {
+        printf(",%.0f-%.0fHz", target_frequencies[i], target_frequencies[i + 1]);
+    }
+    printf("\n");
+
+    for (uint64_t end_frame = N; end_frame <= wav.frame_count; end_frame += N / 2)
+    {
+        UpdateWavReadAhead(&wav, &read_ahead, end_frame - N);
+        ApplyHanningWindowFromWav(&wav, end_frame);
+        DoFFT();
+        CalculateAmplitudes();
+
+        float rms_values[TARGET_FREQ_SIZE - 1] = {0.0};
+        ApplyParsevalTheorem(rms_values, target_frequencies, wav.sample_rate);
+        memset(data.smooth_spectrum, 0, (TARGET_FREQ_SIZE - 1) * sizeof(float));
+        RMS_TO_DBFS(rms_values, FULL_SCALE, 1.0f, 1.0f); // No smoothing: dt * smoothing_factor = 1
+
+        printf("%.4f", (double)(end_frame - N / 2) / wav.sample_rate);
+        for (int i = 0; i < TARGET_FREQ_SIZE - 1; i++)
+        {
+            printf(",%.2f", data.smooth_spectrum[i]);
+        }
+        printf("\n");
+    }
+
+    CloseWavSource(&wav);
+    return EXIT_SUCCESS;
+}
+
+int CheckFrameAllocations(const char *file_path)
+{
+    /*
+     * The render loop's per-frame work over a WAV file, one 60 FPS frame at a
+     * time: the audio thread's block pushed into the history, AnalyzeFrame(),
+     * latency stamps and the overlay strings. The file is played twice, once
+     * analyzed from the sample history (as an MP3 or the self-test is) and
+     * once from its mapping (as a WAV is). Fails if a frame after the warm-up
+     * makes a heap call. Drawing needs a window, so it is only counted in the
+     * F3 overlay.
+     */
+    if (!IsAllocAccounting())
+    {
+        printf("Heap calls are only counted in debug builds (build_debug.bat)\n");
+        return EXIT_FAILURE;
+    }
+
+    WavSource wav;
+    if (!OpenWavSource(file_path, &wav))
+    {
+        printf("Unable to open %s\n", file_path);
+        return EXIT_FAILURE;
+    }
+    WavReadAhead read_ahead = { 0 };
+
+    RegisterAllocThread("render", true);    // Also the audio thread here
+
+    static float block[N][2];
+    unsigned int block_frames = wav.sample_rate / 60;
+    if (block_frames > N) block_frames = N;
+    if (block_frames == 0) block_frames = 1;
+
+    for (int from_wav = 0; from_wav <= 1; from_wav++)
+    {
+        CleanUp();
+
+        for (uint64_t position = 0; position + block_frames <= wav.frame_count; position += block_frames)
+        {
+            BeginAllocFrame();
+            BeginLatencyFrame();
+
+            UpdateWavReadAhead(&wav, &read_ahead, position);
+            for (unsigned int i = 0; i < block_frames; i++)
+            {
+                block[i][0] = GetWavSample(&wav, position + i, 0);
+                block[i][1] = GetWavSample(&wav, position + i, (wav.channels > 1) ? 1 : 0);
+            }
+            ProcessAudioStreamCallback(block, block_frames);
+
+            AnalyzeFrame(from_wav ? &wav : NULL, position + block_frames, -1.0, wav.sample_rate, 1.0f / 60.0f);   // Nothing is played here
+
+            for (int i = 0; i < LATENCY_INTERVAL_COUNT; i++)
+            {
+                TextFormat("%-18d %7.1f %7.1f %7.1f", i, GetLatencyPercentile(i, 0.50f), GetLatencyPercentile(i, 0.90f), GetLatencyPercentile(i, 0.99f));
+            }
+
+            MarkLatencyStage(LATENCY_STAGE_FRAME_SWAP, GetTime());
+            EndLatencyFrame();
+            int64_t heap_calls = EndAllocFrame();
+
+            AllocFrameStats stats = GetAllocFrameStats();
+            if (heap_calls > 0 && stats.frames > ALLOC_WARMUP_FRAMES && stats.steady_frames <= 10)
+            {
+                printf("frame %lld (%s): %lld heap calls\n", (long long)stats.last_steady_frame, from_wav ? "mapped WAV" : "sample history",
+                       (long long)heap_calls);
+            }
+        }
+    }
+
+    CloseWavSource(&wav);
+
+    AllocFrameStats stats = GetAllocFrameStats();
+    AllocCounts counts[ALLOC_THREADS + 1];
+    int n_counts = GetAllocThreadCounts(counts, false);
+    for (int i = 0; i < n_counts; i++)
+    {
+        printf("%-12s %lld allocations, %lld frees, %lld KB\n", counts[i].name, (long long)counts[i].allocations,
+               (long long)counts[i].frees, (long long)(counts[i].bytes / 1024));
+    }
+
+    if (stats.frames <= ALLOC_WARMUP_FRAMES)
+    {
+        printf("%s is too short: %lld frames, the warm-up alone is %d\n", file_path, (long long)stats.frames, ALLOC_WARMUP_FRAMES);
+        return EXIT_FAILURE;
+    }
+    printf("%lld frames after a %d frame warm-up: %lld made heap calls (%lld calls)\n", (long long)(stats.frames - ALLOC_WARMUP_FRAMES),
+           ALLOC_WARMUP_FRAMES, (long long)stats.steady_frames, (long long)stats.steady_heap_calls);
+
+    return (stats.steady_frames == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Appends the library's tracks that aren't in the playlist yet, in path order; returns how many. */
+int QueueLibraryTracks(const LibraryIndex *library, Playlist *playlist)
+{
+    bool *listed = calloc((library->count > 0) ? library->count : 1, sizeof(bool));
+    if (listed == NULL) return 0;
+
+    for (int i = 0; i < playlist->count; i++)
+    {
+        int entry = FindLibraryEntry(library, GetPlaylistPath(playlist, i));
+        if (entry >= 0) listed[entry] = true;
+    }
+
+    int queued = 0;
+    for (int i = 0; i < library->count; i++)
+    {
+        if (!listed[i] && AddToPlaylist(playlist, GetLibraryString(library, library->entries[i].path)) >= 0) queued++;
+    }
+
+    free(listed);
+    return queued;
+}
@@ -0,0 +1,133 @@
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define _WIN32_WINNT 0x0602         // PrefetchVirtualMemory (Windows 8)
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 200809L     // posix_madvise
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <string.h>
+
+#include "mapped_file.h"
+
+/*
+ * Memory-mapped files.
+ * -----------------------------------------------------------
+ * Used wherever a file is only read: large WAV captures are handed to the
+ * analyzer and the audio stream straight out of the page cache instead of
+ * going through decode buffers.
+ * -----------------------------------------------------------
+ */
+
+/* Maps the whole file. */
+bool OpenMappedFile(const char *file_path, MappedFile *file)
+{
+    return OpenMappedFileRange(file_path, 0, file);
+}
+
+/* Maps the first length bytes of the file (the whole file when length is 0 or past the end). */
+bool OpenMappedFileRange(const char *file_path, size_t length, MappedFile *file)
+{
+    memset(file, 0, sizeof(MappedFile));
+
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+    file->file_size = (uint64_t)size.QuadPart;
+    file->size = (length == 0 || length > file->file_size) ? (size_t)file->file_size : length;
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, file->size);
+    if (file->data == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        return false;
+    }
+
+    file->handle = handle;
+    file->mapping = mapping;
+#else
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    file->file_size = (uint64_t)st.st_size;
+    file->size = (length == 0 || length > file->file_size) ? (size_t)file->file_size : length;
+
+    void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps its own reference to the file.
+    if (data == MAP_FAILED) return false;
+
+    file->data = data;
+#endif
+
+    return true;
+}
+
+/* Access pattern hint for [offset, offset + length). Purely advisory. */
+void AdviseMappedFile(const MappedFile *file, size_t offset, size_t length, MappedFileAdvice advice)
+{
+    if (file->data == NULL || offset >= file->size) return;
+    if (length > file->size - offset) length = file->size - offset;
+
+#if defined(_WIN32)
+    // Windows has no per-range access pattern hints; the best it offers is prefetching.
+    if (advice == MAPPED_FILE_WILLNEED || advice == MAPPED_FILE_SEQUENTIAL)
+    {
+        WIN32_MEMORY_RANGE_ENTRY range = { (PVOID)(file->data + offset), length };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    // posix_madvise wants a page aligned address.
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t aligned = offset - (offset % (size_t)page_size);
+    int flag = POSIX_MADV_NORMAL;
+
+    switch (advice)
+    {
+        case MAPPED_FILE_NORMAL:     flag = POSIX_MADV_NORMAL;     break;
+        case MAPPED_FILE_SEQUENTIAL: flag = POSIX_MADV_SEQUENTIAL; break;
+        case MAPPED_FILE_RANDOM:     flag = POSIX_MADV_RANDOM;     break;
+        case MAPPED_FILE_WILLNEED:   flag = POSIX_MADV_WILLNEED;   break;
+    }
+    posix_madvise((void *)(file->data + aligned), length + (offset - aligned), flag);
+#endif
+}
+
+void CloseMappedFile(MappedFile *file)
+{
+    if (file->data == NULL) return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(file->data);
+    CloseHandle((HANDLE)file->mapping);
+    CloseHandle((HANDLE)file->handle);
+#else
+    munmap((void *)file->data, file->size);
+#endif
+
+    memset(file, 0, sizeof(MappedFile));
+}
@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raylib.h"
+#include "mapped_file.h"
+#include "mp3_index.h"
+
+/*
+ * MP3 seek index.
+ * -----------------------------------------------------------
+ * raylib decodes MP3 with dr_mp3, which seeks by decoding every frame from
+ * the start of the stream unless it is given a seek table. The track loader
+ * builds one here, from the mapped file, by walking the 4-byte frame headers:
+ * each header gives the frame's length, so the scan touches a few bytes per
+ * frame and never decodes anything.
+ *
+ * Every MP3_INDEX_FRAME_STRIDE frames a point is recorded that starts
+ * MP3_INDEX_LEADING_FRAMES frames early, since Layer III frames borrow bits
+ * from the ones before them. dr_mp3 decodes forward from the point to the
+ * exact PCM frame, so a seek costs at most stride + 2 frame decodes.
+ *
+ * The Xing/Info and VBRI headers some encoders put in the first frame carry
+ * a frame count and a coarse table of contents; the table is only used when
+ * the header walk finds fewer frames than the tag promises (damaged files).
+ * Its points land on the frame that starts at their PCM frame, without the
+ * leading frames: no reservoir, but no offset either.
+ * -----------------------------------------------------------
+ * http://www.mp3-tech.org/programmer/frame_header.html
+ * https://www.codeproject.com/Articles/8295/MPEG-Audio-Frame-Header
+ */
+
+typedef struct
+{
+    unsigned int size;          // Bytes, header included
+    unsigned int samples;       // PCM frames it decodes to
+    unsigned int sample_rate;
+    bool mpeg1;
+    bool mono;
+} Mp3FrameHeader;
+
+// dr_mp3 is compiled into raylib; only these entry points are needed.
+unsigned int drmp3_bind_seek_table(void *pMP3, uint32_t seekPointCount, Mp3SeekPoint *pSeekPoints);
+unsigned int drmp3_seek_to_pcm_frame(void *pMP3, uint64_t frameIndex);
+uint64_t drmp3_read_pcm_frames_f32(void *pMP3, uint64_t framesToRead, float *pBufferOut);
+
+#define MUSIC_AUDIO_MP3 4       // raylib's MusicContextType for dr_mp3 streams
+#define MP3_SYNC_WINDOW (64 * 1024)     // Bytes past the tag in which the first frame must be found
+
+static const unsigned short bitrates[2][3][15] = {
+    {   // MPEG-1: Layer I, II, III
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+    },
+    {   // MPEG-2 and 2.5
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    },
+};
+
+static const unsigned int sample_rates[3] = { 44100, 48000, 32000 };
+
+static uint32_t ReadU32BE(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static bool ParseFrameHeader(const unsigned char *p, size_t available, Mp3FrameHeader *header)
+{
+    if (available < 4 || p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return false;
+
+    unsigned int version = (p[1] >> 3) & 3;         // 0: MPEG-2.5, 2: MPEG-2, 3: MPEG-1
+    unsigned int layer = 4 - ((p[1] >> 1) & 3);     // 4 means reserved
+    unsigned int bitrate_index = p[2] >> 4;
+    unsigned int rate_index = (p[2] >> 2) & 3;
+    unsigned int padding = (p[2] >> 1) & 1;
+
+    if (version == 1 || layer == 4 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) return false; // Reserved or free format
+
+    header->mpeg1 = (version == 3);
+    header->mono = ((p[3] >> 6) == 3);
+    header->sample_rate = sample_rates[rate_index] >> (header->mpeg1 ? 0 : (version == 2 ? 1 : 2));
+
+    unsigned int bitrate = bitrates[header->mpeg1 ? 0 : 1][layer - 1][bitrate_index] * 1000;
+    if (layer == 1)
+    {
+        header->samples = 384;
+        header->size = (12 * bitrate / header->sample_rate + padding) * 4;
+    }
+    else
+    {
+        bool half = (layer == 3 && !header->mpeg1);
+        header->samples = half ? 576 : 1152;
+        header->size = (half ? 72 : 144) * bitrate / header->sample_rate + padding;
+    }
+
+    return header->size > 4;
+}
+
+static bool IsFrameAt(const MappedFile *file, size_t pos, bool in_sync, Mp3FrameHeader *header)
+{
+    // Out of sync, it takes two headers in a row (or one that ends the file) so stray 0xFF bytes in tags don't count.
+    if (!ParseFrameHeader(file->data + pos, file->size - pos, header)) return false;
+    if (pos + header->size > file->size) return false;
+    if (in_sync || pos + header->size == file->size) return true;
+
+    Mp3FrameHeader following;
+    return ParseFrameHeader(file->data + pos + header->size, file->size - pos - header->size, &following)
+        && following.sample_rate == header->sample_rate;
+}
+
+static bool PushSeekPoint(Mp3Index *index, unsigned int *capacity, Mp3SeekPoint point)
+{
+    if (index->count == *capacity)
+    {
+        unsigned int new_capacity = (*capacity == 0) ? 256 : *capacity * 2;
+        Mp3SeekPoint *points = realloc(index->points, new_capacity * sizeof(Mp3SeekPoint));
+        if (points == NULL) return false;
+        index->points = points;
+        *capacity = new_capacity;
+    }
+    index->points[index->count++] = point;
+    return true;
+}
+
+static void ReadEncoderTag(const MappedFile *file, size_t pos, const Mp3FrameHeader *first, Mp3Index *index, unsigned int *capacity, bool add_points)
+{
+    const unsigned char *frame = file->data + pos;
+    size_t side_info = first->mpeg1 ? (first->mono ? 17 : 32) : (first->mono ? 9 : 17);
+
+    // Xing (VBR) or Info (CBR), right after the side information.
+    const unsigned char *xing = frame + 4 + side_info;
+    if (side_info + 4 + 8 <= first->size && (memcmp(xing, "Xing", 4) == 0 || memcmp(xing, "Info", 4) == 0))
+    {
+        uint32_t flags = ReadU32BE(xing + 4);
+        const unsigned char *field = xing + 8;
+        uint32_t bytes = 0;
+
+        index->has_xing = true;
+        if (flags & 1) { index->tag_frame_count = ReadU32BE(field); field += 4; }
+        if (flags & 2) { bytes = ReadU32BE(field); field += 4; }
+        if (add_points && (flags & 4) && index->tag_frame_count > 0 && (size_t)(field + 100 - frame) <= first->size)
+        {
+            if (bytes == 0) bytes = (uint32_t)(file->size - pos);
+            // A table entry is where its PCM frame starts: decode from there, nothing to discard.
+            uint64_t total = (uint64_t)index->tag_frame_count * first->samples;
+            for (int percent = 1; percent < 100; percent++)
+            {
+                Mp3SeekPoint point = { pos + (uint64_t)field[percent] * bytes / 256, total * percent / 100, 0, 0 };
+                if (!PushSeekPoint(index, capacity, point)) return;
+            }
+        }
+        return;
+    }
+
+    // VBRI (Fraunhofer), at a fixed offset.
+    const unsigned char *vbri = frame + 36;
+    if (36 + 26 <= first->size && memcmp(vbri, "VBRI", 4) == 0)
+    {
+        unsigned int entries = (vbri[18] << 8) | vbri[19];
+        unsigned int scale = (vbri[20] << 8) | vbri[21];
+        unsigned int entry_size = (vbri[22] << 8) | vbri[23];
+        unsigned int frames_per_entry = (vbri[24] << 8) | vbri[25];
+
+        index->has_vbri = true;
+        index->tag_frame_count = ReadU32BE(vbri + 14);
+        if (!add_points || entry_size < 1 || entry_size > 4 || 36 + 26 + (size_t)entries * entry_size > first->size) return;
+
+        const unsigned char *entry = vbri + 26;
+        uint64_t offset = pos;
+        for (unsigned int i = 0; i + 1 < entries; i++, entry += entry_size)
+        {
+            uint32_t value = 0;
+            for (unsigned int b = 0; b < entry_size; b++) value = (value << 8) | entry[b];
+            offset += (uint64_t)value * scale;
+
+            Mp3SeekPoint point = { offset, (uint64_t)(i + 1) * frames_per_entry * first->samples, 0, 0 };
+            if (!PushSeekPoint(index, capacity, point)) return;
+        }
+    }
+}
+
+// Where the audio starts: past an ID3v2 tag (size is syncsafe, footer adds another 10 bytes).
+static size_t SkipId3Tag(const MappedFile *file)
+{
+    size_t pos = 0;
+    if (file->size >= 10 && memcmp(file->data, "ID3", 3) == 0)
+    {
+        const unsigned char *p = file->data;
+        pos = 10 + (((size_t)(p[6] & 0x7F) << 21) | ((size_t)(p[7] & 0x7F) << 14) | ((size_t)(p[8] & 0x7F) << 7) | (size_t)(p[9] & 0x7F));
+        if (p[5] & 0x10) pos += 10;
+    }
+    return pos;
+}
+
+bool BuildMp3Index(const char *file_path, Mp3Index *index)
+{
+    memset(index, 0, sizeof(Mp3Index));
+
+    MappedFile file;
+    if (!OpenMappedFile(file_path, &file)) return false;
+    AdviseMappedFile(&file, 0, file.size, MAPPED_FILE_SEQUENTIAL);
+
+    size_t pos = SkipId3Tag(&file);
+    size_t sync_limit = pos + MP3_SYNC_WINDOW;
+    size_t first_pos = 0;
+    Mp3FrameHeader first_header = { 0 };
+
+    unsigned int capacity = 0;
+    uint64_t offsets[MP3_INDEX_LEADING_FRAMES + 1];     // Byte offset and first PCM frame of the last few frames
+    uint64_t starts[MP3_INDEX_LEADING_FRAMES + 1];
+    bool first = true;
+    bool in_sync = false;
+
+    while (pos < file.size)
+    {
+        Mp3FrameHeader header;
+        if (!IsFrameAt(&file, pos, in_sync, &header) || (in_sync && header.sample_rate != index->sample_rate))
+        {
+            in_sync = false;
+            if (first && pos > sync_limit) break;       // No audio where it should start
+            pos++;                                      // Lost sync: look for the next frame, like the decoder does
+            continue;
+        }
+
+        if (first)
+        {
+            index->sample_rate = header.sample_rate;
+            ReadEncoderTag(&file, pos, &header, index, &capacity, false);
+            first_pos = pos;
+            first_header = header;
+            first = false;
+        }
+
+        uint64_t frame = index->frame_count;
+        offsets[frame % (MP3_INDEX_LEADING_FRAMES + 1)] = pos;
+        starts[frame % (MP3_INDEX_LEADING_FRAMES + 1)] = index->pcm_frame_count;
+
+        if (frame >= MP3_INDEX_LEADING_FRAMES && frame % MP3_INDEX_FRAME_STRIDE == 0)
+        {
+            uint64_t previous = starts[(frame - 1) % (MP3_INDEX_LEADING_FRAMES + 1)];
+            Mp3SeekPoint point = {
+                offsets[(frame - MP3_INDEX_LEADING_FRAMES) % (MP3_INDEX_LEADING_FRAMES + 1)],
+                index->pcm_frame_count,
+                MP3_INDEX_LEADING_FRAMES,
+                (uint16_t)(index->pcm_frame_count - previous),
+            };
+            if (!PushSeekPoint(index, &capacity, point)) break;
+        }
+
+        in_sync = true;
+        index->frame_count++;
+        index->pcm_frame_count += header.samples;
+        pos += header.size;
+    }
+
+    index->complete = !first && index->frame_count >= index->tag_frame_count;   // The Xing count leaves out its own frame
+
+    if (!index->complete && index->tag_frame_count > 0)
+    {
+        // Fall back to the encoder's table of contents.
+        index->count = 0;
+        ReadEncoderTag(&file, first_pos, &first_header, index, &capacity, true);
+    }
+
+    CloseMappedFile(&file);
+    return index->count > 0;
+}
+
+/*
+ * Duration without walking the frames: the Xing/Info or VBRI frame count
+ * when the first frame carries one, else the file size over the first
+ * frame's size (exact for CBR). Only the pages around the first frame are
+ * read. 0 if no frame is found.
+ */
+float EstimateMp3Duration(const char *file_path)
+{
+    MappedFile file;
+    if (!OpenMappedFile(file_path, &file)) return 0.0f;
+
+    size_t start = SkipId3Tag(&file);
+    float duration = 0.0f;
+
+    for (size_t pos = start; pos < file.size && pos <= start + MP3_SYNC_WINDOW; pos++)
+    {
+        Mp3FrameHeader header;
+        if (!IsFrameAt(&file, pos, false, &header)) continue;
+
+        Mp3Index tag = { 0 };
+        unsigned int capacity = 0;
+        ReadEncoderTag(&file, pos, &header, &tag, &capacity, false);
+
+        uint64_t frames = (tag.tag_frame_count > 0) ? tag.tag_frame_count : (file.size - pos) / header.size;
+        duration = (float)((double)frames * header.samples / header.sample_rate);
+        break;
+    }
+
+    CloseMappedFile(&file);
+    return duration;
+}
+
+bool BindMp3Index(Music music, Mp3Index *index)
+{
+    if (music.ctxType != MUSIC_AUDIO_MP3 || index->count == 0) return false;
+
+    if (index->complete && index->pcm_frame_count != music.frameCount)
+    {
+        // Some decoders drop the Xing/Info frame, which decodes to silence; any other mismatch means the walk disagrees with dr_mp3.
+        uint64_t info_frame = index->pcm_frame_count - music.frameCount;
+        if (!index->has_xing || index->pcm_frame_count < music.frameCount || info_frame > 1152)
+        {
+            TraceLog(LOG_WARNING, "MP3INDEX: %llu PCM frames indexed, decoder reports %u, seek table not used",
+                     (unsigned long long)index->pcm_frame_count, music.frameCount);
+            return false;
+        }
+        for (unsigned int i = 0; i < index->count; i++) index->points[i].pcm_frame -= info_frame;
+        index->pcm_frame_count = music.frameCount;
+    }
+
+    return drmp3_bind_seek_table(music.ctxData, index->count, index->points) != 0;
+}
+
+bool IsMp3Music(Music music)
+{
+    return music.ctxType == MUSIC_AUDIO_MP3;
+}
+
+/*
+ * Direct access to the decoder behind an MP3 Music, for callers that refill
+ * its stream themselves instead of through UpdateMusicStream(). Neither
+ * touches the stream: its played frame count stays what it was.
+ */
+bool SeekMp3Frame(Music music, uint64_t frame)
+{
+    if (music.ctxType != MUSIC_AUDIO_MP3) return false;
+    return drmp3_seek_to_pcm_frame(music.ctxData, frame) != 0;
+}
+
+unsigned int ReadMp3Frames(Music music, float *frames, unsigned int frame_count)
+{
+    if (music.ctxType != MUSIC_AUDIO_MP3) return 0;
+    return (unsigned int)drmp3_read_pcm_frames_f32(music.ctxData, frame_count, frames);
+}
+
+void UnloadMp3Index(Mp3Index *index)
+{
+    free(index->points);
+    memset(index, 0, sizeof(Mp3Index));
+}
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "raylib.h"
+#include "kmeans.h"
+#include "oklab.h"
+
+/*
+ * sRGB to OKLab through lookup tables.
+ * -----------------------------------------------------------
+ * The exact conversion costs two matrix products, three cube roots and
+ * three pow() calls per pixel. Instead, a table of the 256 linear sRGB
+ * values builds, once, a 33x33x33 grid of OKLab values (a node every 8 sRGB
+ * levels, the last one past 255 so every color has a cell). Pixels are
+ * interpolated tetrahedrally in fixed point, as color management engines
+ * do: the order of the cell fractions picks four of its eight corners,
+ * weighted by the differences of the sorted fractions. A node packs L, a
+ * and b into one 64-bit word, PACK_SHIFT bits apart; they are never negative
+ * and a weighted sum of them never carries into the next one, so a
+ * conversion is four table reads and four multiply-adds for all three
+ * channels at once. The cube root is too steep
+ * near black for the grid, so colors with every channel under DARK_SIDE
+ * come from an exact table instead.
+ *
+ * Centroids go back to sRGB with the exact inverse, once per cluster.
+ * -----------------------------------------------------------
+ */
+
+#define GRID_SIDE ((1 << OKLAB_GRID_BITS) + 1)
+#define GRID_SHIFT (8 - OKLAB_GRID_BITS)
+#define GRID_STEP (1 << GRID_SHIFT)             // Corner weights sum to this
+#define GRID_UNITS 16                           // Grid values in 1/16 of a plane unit
+#define ROUND_SHIFT (GRID_SHIFT + 4)            // Weighted sums back to plane units (4 = log2(GRID_UNITS))
+#define DARK_SIDE 32                            // Exact below this on every channel
+#define NODE_R (GRID_SIDE * GRID_SIDE)          // Node offsets of one step along each axis
+#define NODE_G GRID_SIDE
+#define NODE_B 1
+#define PACK_SHIFT 21                           // Node fields: 12 bits of value, room for the weights' 3 and a carry
+#define PACK_MASK ((1u << (PACK_SHIFT - ROUND_SHIFT)) - 1)     // A field once shifted back to plane units
+
+/*
+ * Second and third corners of the tetrahedron, indexed by
+ * (r >= g) << 2 | (g >= b) << 1 | (r >= b): one step along the axis with the
+ * largest fraction, then along the next. Indices 1 and 6 can't happen.
+ */
+static const int tetrahedra[8][2] = {
+    { NODE_B, NODE_B + NODE_G },    // b > g > r
+    { 0, 0 },
+    { NODE_G, NODE_G + NODE_B },    // g >= b > r
+    { NODE_G, NODE_G + NODE_R },    // g > r >= b
+    { NODE_B, NODE_B + NODE_R },    // b > r >= g
+    { NODE_R, NODE_R + NODE_B },    // r >= b > g
+    { 0, 0 },
+    { NODE_R, NODE_R + NODE_G },    // r >= g >= b
+};
+
+static float srgb_to_linear[256];
+static uint64_t grid[GRID_SIDE * GRID_SIDE * GRID_SIDE];
+static unsigned char dark[DARK_SIDE][DARK_SIDE][DARK_SIDE][4];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static float SrgbToLinear(float c)
+{
+    return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float c)
+{
+    return (c <= 0.0031308f) ? 12.92f * c : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+/* OKLab in plane units: L, a, b times OKLAB_SCALE, a and b offset by OKLAB_OFFSET. */
+static void LinearToOklab(float r, float g, float b, float *lab)
+{
+    float l = cbrtf(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+    float m = cbrtf(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+    float s = cbrtf(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+
+    lab[0] = (0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s) * OKLAB_SCALE;
+    lab[1] = (1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s) * OKLAB_SCALE + OKLAB_OFFSET;
+    lab[2] = (0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s) * OKLAB_SCALE + OKLAB_OFFSET;
+}
+
+static unsigned char ClampPlane(long value)
+{
+    return (unsigned char)((value < 0) ? 0 : (value > 255) ? 255 : value);
+}
+
+static void BuildTables(void)
+{
+    for (int c = 0; c < 256; c++) srgb_to_linear[c] = SrgbToLinear(c / 255.0f);
+
+    float node_linear[GRID_SIDE];
+    for (int i = 0; i < GRID_SIDE; i++)
+    {
+        int c = i * GRID_STEP;
+        node_linear[i] = (c < 256) ? srgb_to_linear[c] : SrgbToLinear(c / 255.0f);    // The last node extrapolates past white
+    }
+
+    for (int r = 0; r < GRID_SIDE; r++)
+    {
+        for (int g = 0; g < GRID_SIDE; g++)
+        {
+            for (int b = 0; b < GRID_SIDE; b++)
+            {
+                float lab[3];
+                LinearToOklab(node_linear[r], node_linear[g], node_linear[b], lab);
+
+                uint64_t node = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    long value = lrintf(lab[c] * GRID_UNITS);
+                    node |= (uint64_t)((value < 0) ? 0 : value) << (c * PACK_SHIFT);
+                }
+                grid[r * NODE_R + g * NODE_G + b * NODE_B] = node;
+            }
+        }
+    }
+
+    for (int r = 0; r < DARK_SIDE; r++)
+    {
+        for (int g = 0; g < DARK_SIDE; g++)
+        {
+            for (int b = 0; b < DARK_SIDE; b++)
+            {
+                float lab[3];
+                LinearToOklab(srgb_to_linear[r], srgb_to_linear[g], srgb_to_linear[b], lab);
+                for (int c = 0; c < 3; c++) dark[r][g][b][c] = ClampPlane(lrintf(lab[c]));
+            }
+        }
+    }
+}
+
+bool LoadOklabPlanes(const ColorPlanes *rgb, ColorPlanes *oklab, Arena *arena)
+{
+    pthread_once(&tables_once, BuildTables);
+
+    int count = rgb->count;
+    unsigned char *block = ScratchAlloc(arena, 3 * (size_t)count + 1);     // One block, as LoadColorPlanes() allocates
+    if (block == NULL) return false;
+
+    oklab->r = block;
+    oklab->g = block + count;
+    oklab->b = block + 2 * (size_t)count;
+    oklab->count = count;
+    oklab->arena = arena;
+
+    // Half a plane unit in each field
+    const uint64_t half = (uint64_t)1 << (ROUND_SHIFT - 1);
+    const uint64_t rounding = half | half << PACK_SHIFT | half << (2 * PACK_SHIFT);
+
+    for (int point = 0; point < count; point++)
+    {
+        int r = rgb->r[point], g = rgb->g[point], b = rgb->b[point];
+
+        if ((r | g | b) < DARK_SIDE)
+        {
+            const unsigned char *lab = dark[r][g][b];
+            oklab->r[point] = lab[0];
+            oklab->g[point] = lab[1];
+            oklab->b[point] = lab[2];
+            continue;
+        }
+
+        int rf = r & (GRID_STEP - 1), gf = g & (GRID_STEP - 1), bf = b & (GRID_STEP - 1);
+        int high = (rf > gf) ? rf : gf, low = (rf < gf) ? rf : gf;
+        high = (bf > high) ? bf : high;
+        low = (bf < low) ? bf : low;
+        int middle = rf + gf + bf - high - low;
+
+        const uint64_t *base = &grid[(r >> GRID_SHIFT) * NODE_R + (g >> GRID_SHIFT) * NODE_G + (b >> GRID_SHIFT) * NODE_B];
+        const int *corners = tetrahedra[(rf >= gf) << 2 | (gf >= bf) << 1 | (rf >= bf)];
+
+        uint64_t sum = rounding + (uint64_t)(GRID_STEP - high) * base[0] + (uint64_t)(high - middle) * base[corners[0]] +
+                       (uint64_t)(middle - low) * base[corners[1]] + (uint64_t)low * base[NODE_R + NODE_G + NODE_B];
+        oklab->r[point] = ClampPlane((long)((sum >> ROUND_SHIFT) & PACK_MASK));
+        oklab->g[point] = ClampPlane((long)((sum >> (PACK_SHIFT + ROUND_SHIFT)) & PACK_MASK));
+        oklab->b[point] = ClampPlane((long)((sum >> (2 * PACK_SHIFT + ROUND_SHIFT)) & PACK_MASK));
+    }
+
+    return true;
+}
+
+Color OklabToColor(int L, int a, int b)
+{
+    float lightness = L / OKLAB_SCALE, green_red = (a - OKLAB_OFFSET) / OKLAB_SCALE, blue_yellow = (b - OKLAB_OFFSET) / OKLAB_SCALE;
+
+    float l = lightness + 0.3963377774f * green_red + 0.2158037573f * blue_yellow;
+    float m = lightness - 0.1055613458f * green_red - 0.0638541728f * blue_yellow;
+    float s = lightness - 0.0894841775f * green_red - 1.2914855480f * blue_yellow;
+    l = l*l*l;
+    m = m*m*m;
+    s = s*s*s;
+
+    float linear[3] = {
+        +4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s,
+        -1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s,
+        -0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s,
+    };
+
+    unsigned char srgb[3];
+    for (int c = 0; c < 3; c++)
+    {
+        float value = (linear[c] < 0.0f) ? 0.0f : (linear[c] > 1.0f) ? 1.0f : linear[c];
+        srgb[c] = ClampPlane(lrintf(LinearToSrgb(value) * 255.0f));
+    }
+
+    return (Color){ srgb[0], srgb[1], srgb[2], 255 };
+}
@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "raylib.h"
+#include "kmeans.h"
+#include "palette.h"
+
+/*
+ * Palette backends.
+ * -----------------------------------------------------------
+ * k-means       getDominantColorsFromPlanes() over a PALETTE_HISTOGRAM_BITS
+ *               histogram, seeded with PALETTE_SEED, in sRGB or OKLab.
+ *
+ * The two quantizers start with the same single pass over the pixels, into a
+ * 5:5:5 histogram keeping the count and channel sums of every bin. What
+ * follows only touches the occupied bins, so its cost is bounded whatever
+ * the cover's size.
+ *
+ * octree        (Gervautz & Purgathofer) Each occupied bin walks down an
+ *               octree indexed by one bit of each channel per level, one
+ *               level per histogram bit. Whenever it holds more than
+ *               OCTREE_MAX_LEAVES colors, the deepest node with the fewest
+ *               pixels absorbs its children. The nodes come from a fixed
+ *               pool: the tree never holds more than OCTREE_MAX_LEAVES + 1
+ *               leaves with OCTREE_DEPTH ancestors each. The leaves left
+ *               are then merged pairwise, at the least added squared error
+ *               (Ward), down to the palette size.
+ *
+ * median cut    (Heckbert) Boxes of bins are split until there are enough of
+ *               them: the box with the most squared error, along its channel
+ *               of largest variance, at the cut leaving the least error on
+ *               that channel (Wan, Wong & Prusinkiewicz) rather than at the
+ *               median, which leaves about twice the error k-means does on
+ *               covers. A split is one pass over the box's bins.
+ *
+ * Both give the mean color of their leaves or boxes. Covers with fewer
+ * distinct colors than the palette repeat the last one.
+ * -----------------------------------------------------------
+ */
+
+#define QUANTIZER_BITS 5                                // Histogram bits per channel
+#define QUANTIZER_SIDE (1 << QUANTIZER_BITS)
+#define QUANTIZER_BINS (1 << (3 * QUANTIZER_BITS))
+#define OCTREE_POOL_SIZE (1 + (OCTREE_MAX_LEAVES + 1) * OCTREE_DEPTH)
+#define NO_NODE -1
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t sum[3];                    // r, g, b
+} ColorBin;
+
+typedef struct
+{
+    ColorBin bin;                       // Pixels of the leaf, or of the whole subtree once reduced
+    int children[8];
+    int next_reducible;                 // Next inner node of the same level
+    bool leaf;
+} OctreeNode;
+
+typedef struct
+{
+    OctreeNode nodes[OCTREE_POOL_SIZE];
+    int free_nodes;                     // Head of the recycled nodes, chained through next_reducible
+    int n_used;
+    int reducible[OCTREE_DEPTH];        // Inner nodes per level
+    int n_leaves;
+} Octree;
+
+typedef struct
+{
+    uint16_t bin;
+    unsigned char coordinates[3];       // r, g, b bin coordinates, QUANTIZER_BITS each
+} HistogramEntry;
+
+typedef struct
+{
+    int start;                          // Entries [start, end) of the occupied bins
+    int end;
+    int axis;                           // Channel of largest variance the bins differ on
+    double error;                       // Squared error around the box's mean color
+} ColorBox;
+
+typedef void (*PaletteQuantizer)(ColorPlanes planes, Color *palette, int n_colors, Arena *arena);
+
+typedef struct
+{
+    const char *name;
+    PaletteQuantizer quantize;
+} PaletteEngine;
+
+static void QuantizeKMeans(ColorPlanes planes, Color *palette, int n_colors, Arena *arena);
+static void QuantizeKMeansOklab(ColorPlanes planes, Color *palette, int n_colors, Arena *arena);
+static void QuantizeOctree(ColorPlanes planes, Color *palette, int n_colors, Arena *arena);
+static void QuantizeMedianCut(ColorPlanes planes, Color *palette, int n_colors, Arena *arena);
+
+static const PaletteEngine engines[PALETTE_BACKEND_COUNT] = {
+    [PALETTE_BACKEND_KMEANS]       = { "kmeans", QuantizeKMeans },
+    [PALETTE_BACKEND_KMEANS_OKLAB] = { "kmeans-oklab", QuantizeKMeansOklab },
+    [PALETTE_BACKEND_OCTREE]       = { "octree", QuantizeOctree },
+    [PALETTE_BACKEND_MEDIAN_CUT]   = { "median-cut", QuantizeMedianCut },
+};
+
+static _Atomic int current_backend = PALETTE_BACKEND_KMEANS;   // Read by the track loader workers
+
+void QuantizePalette(PaletteBackend backend, ColorPlanes planes, Color *palette, int n_colors, Arena *arena)
+{
+    if (backend < 0 || backend >= PALETTE_BACKEND_COUNT || planes.count <= 0 || n_colors <= 0) return;
+    engines[backend].quantize(planes, palette, n_colors, arena);
+}
+
+void SetPaletteBackend(PaletteBackend backend)
+{
+    if (backend >= 0 && backend < PALETTE_BACKEND_COUNT) atomic_store(&current_backend, (int)backend);
+}
+
+PaletteBackend GetPaletteBackend(void)
+{
+    return (PaletteBackend)atomic_load(&current_backend);
+}
+
+const char *GetPaletteBackendName(PaletteBackend backend)
+{
+    return (backend >= 0 && backend < PALETTE_BACKEND_COUNT) ? engines[backend].name : "unknown";
+}
+
+bool FindPaletteBackend(const char *name, PaletteBackend *backend)
+{
+    for (int i = 0; i < PALETTE_BACKEND_COUNT; i++)
+    {
+        if (strcmp(name, engines[i].name) == 0)
+        {
+            *backend = (PaletteBackend)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------------
+// Shared by the quantizers
+//------------------------------------------------------------------------------------
+static Color BinColor(const ColorBin *bin)
+{
+    if (bin->count == 0) return (Color){ 0, 0, 0, 255 };
+    return (Color){
+        (unsigned char)((bin->sum[0] + bin->count / 2) / bin->count),
+        (unsigned char)((bin->sum[1] + bin->count / 2) / bin->count),
+        (unsigned char)((bin->sum[2] + bin->count / 2) / bin->count),
+        255
+    };
+}
+
+static void MergeBins(ColorBin *into, const ColorBin *from)
+{
+    into->count += from->count;
+    for (int c = 0; c < 3; c++) into->sum[c] += from->sum[c];
+}
+
+// The one pass over the pixels: QUANTIZER_BINS bins, indexed r:g:b.
+static ColorBin *LoadHistogram(ColorPlanes planes, Arena *arena)
+{
+    ColorBin *histogram = ScratchCalloc(arena, QUANTIZER_BINS, sizeof(ColorBin));
+    if (histogram == NULL) return NULL;
+
+    int shift = 8 - QUANTIZER_BITS;
+    for (int point = 0; point < planes.count; point++)
+    {
+        int r = planes.r[point], g = planes.g[point], b = planes.b[point];
+        ColorBin *bin = &histogram[((r >> shift) << (2 * QUANTIZER_BITS)) | ((g >> shift) << QUANTIZER_BITS) | (b >> shift)];
+        bin->count++;
+        bin->sum[0] += r;
+        bin->sum[1] += g;
+        bin->sum[2] += b;
+    }
+    return histogram;
+}
+
+// Writes n_colors colors from n_bins bins: the most common first, then each next the farthest from those before.
+static void OrderPalette(const ColorBin *bins, int n_bins, Color *palette, int n_colors, Arena *arena)
+{
+    bool *used = ScratchCalloc(arena, n_bins, sizeof(bool));
+    if (used == NULL) return;
+    int chosen = 0;
+
+    for (int i = 1; i < n_bins; i++)
+    {
+        if (bins[i].count > bins[chosen].count) chosen = i;
+    }
+
+    for (int i = 0; i < n_colors; i++)
+    {
+        if (i >= n_bins)
+        {
+            palette[i] = palette[i - 1];
+            continue;
+        }
+
+        used[chosen] = true;
+        palette[i] = BinColor(&bins[chosen]);
+
+        // Next: the unused bin farthest from every color so far
+        int max_distance = -1;
+        for (int j = 0; j < n_bins; j++)
+        {
+            if (used[j]) continue;
+
+            Color color = BinColor(&bins[j]);
+            int nearest = INT_MAX;
+            for (int k = 0; k <= i; k++)
+            {
+                int d = distanceSquared(&color, &palette[k]);
+                if (d < nearest) nearest = d;
+            }
+            if (nearest > max_distance)
+            {
+                max_distance = nearest;
+                chosen = j;
+            }
+        }
+    }
+
+    ScratchFree(arena, used);
+}
+
+//------------------------------------------------------------------------------------
+// k-means
+//------------------------------------------------------------------------------------
+static void QuantizeKMeans(ColorPlanes planes, Color *palette, int n_colors, Arena *arena)
+{
+    getDominantColorsFromPlanes(planes, palette, n_colors, (KMeansOptions) { .histogram_bits = PALETTE_HISTOGRAM_BITS, .seed = PALETTE_SEED, .arena = arena });
+}
+
+static void QuantizeKMeansOklab(ColorPlanes planes, Color *palette, int n_colors, Arena *arena)
+{
+    getDominantColorsFromPlanes(planes, palette, n_colors, (KMeansOptions) { .histogram_bits = PALETTE_HISTOGRAM_BITS, .seed = PALETTE_SEED, .color_space = KMEANS_OKLAB, .arena = arena });
+}
+
+//------------------------------------------------------------------------------------
+// Octree
+//------------------------------------------------------------------------------------
+static int NewOctreeNode(Octree *tree, int level)
+{
+    int index;
+    if (tree->free_nodes != NO_NODE)
+    {
+        index = tree->free_nodes;
+        tree->free_nodes = tree->nodes[index].next_reducible;
+    }
+    else
+    {
+        index = tree->n_used++;         // Never past OCTREE_POOL_SIZE, see the note above
+    }
+
+    OctreeNode *node = &tree->nodes[index];
+    memset(node, 0, sizeof(OctreeNode));
+    for (int i = 0; i < 8; i++) node->children[i] = NO_NODE;
+    node->leaf = (level == OCTREE_DEPTH);
+
+    if (node->leaf)
+    {
+        tree->n_leaves++;
+    }
+    else
+    {
+        node->next_reducible = tree->reducible[level];
+        tree->reducible[level] = index;
+    }
+    return index;
+}
+
+static void AddOctreeBin(Octree *tree, const ColorBin *bin)
+{
+    Color color = BinColor(bin);
+    int index = 0;
+    for (int level = 0; !tree->nodes[index].leaf; level++)
+    {
+        int shift = 7 - level;
+        int child = (((color.r >> shift) & 1) << 2) | (((color.g >> shift) & 1) << 1) | ((color.b >> shift) & 1);
+
+        if (tree->nodes[index].children[child] == NO_NODE)
+        {
+            int new_node = NewOctreeNode(tree, level + 1);
+            tree->nodes[index].children[child] = new_node;
+        }
+        index = tree->nodes[index].children[child];
+    }
+
+    MergeBins(&tree->nodes[index].bin, bin);
+}
+
+// Fold the deepest inner node with the fewest pixels into a leaf. Its children are all leaves.
+static void ReduceOctree(Octree *tree)
+{
+    int level = OCTREE_DEPTH - 1;
+    while (level > 0 && tree->reducible[level] == NO_NODE) level--;
+
+    int best = NO_NODE, best_prev = NO_NODE;
+    uint64_t best_count = UINT64_MAX;
+    for (int index = tree->reducible[level], prev = NO_NODE; index != NO_NODE; prev = index, index = tree->nodes[index].next_reducible)
+    {
+        uint64_t count = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            int child = tree->nodes[index].children[i];
+            if (child != NO_NODE) count += tree->nodes[child].bin.count;
+        }
+        if (count < best_count)
+        {
+            best_count = count;
+            best = index;
+            best_prev = prev;
+        }
+    }
+
+    OctreeNode *node = &tree->nodes[best];
+    if (best_prev == NO_NODE) tree->reducible[level] = node->next_reducible;
+    else tree->nodes[best_prev].next_reducible = node->next_reducible;
+
+    for (int i = 0; i < 8; i++)
+    {
+        int child = node->children[i];
+        if (child == NO_NODE) continue;
+
+        MergeBins(&node->bin, &tree->nodes[child].bin);
+        tree->nodes[child].next_reducible = tree->free_nodes;
+        tree->free_nodes = child;
+        tree->n_leaves--;
+        node->children[i] = NO_NODE;
+    }
+
+    node->leaf = true;
+    tree->n_leaves++;
+}
+
+static void CollectOctreeLeaves(const Octree *tree, int index, ColorBin *bins, int *n_bins)
+{
+    const OctreeNode *node = &tree->nodes[index];
+    if (node->leaf)
+    {
+        if (node->bin.count > 0) bins[(*n_bins)++] = node->bin;
+        return;
+    }
+    for (int i = 0; i < 8; i++)
+    {
+        if (node->children[i] != NO_NODE) CollectOctreeLeaves(tree, node->children[i], bins, n_bins);
+    }
+}
+
+// Squared error added by merging two bins (Ward)
+static double MergeCost(const ColorBin *a, const ColorBin *b)
+{
+    double distance = 0.0;
+    for (int c = 0; c < 3; c++)
+    {
+        double d = (double)a->sum[c] / a->count - (double)b->sum[c] / b->count;
+        distance += d*d;
+    }
+    return distance * ((double)a->count * b->count / (a->count + b->count));
+}
+
+static void QuantizeOctree(ColorPlanes planes, Color *palette, int n_colors, Arena *arena)
+{
+    ColorBin *histogram = LoadHistogram(planes, arena);
+    Octree *tree = ScratchAlloc(arena, sizeof(Octree));
+    if (histogram == NULL || tree == NULL)
+    {
+        ScratchFree(arena, histogram);
+        ScratchFree(arena, tree);
+        return;
+    }
+
+    tree->free_nodes = NO_NODE;
+    tree->n_used = 0;
+    tree->n_leaves = 0;
+    for (int level = 0; level < OCTREE_DEPTH; level++) tree->reducible[level] = NO_NODE;
+    NewOctreeNode(tree, 0);
+
+    for (int bin = 0; bin < QUANTIZER_BINS; bin++)
+    {
+        if (histogram[bin].count == 0) continue;
+
+        AddOctreeBin(tree, &histogram[bin]);
+        while (tree->n_leaves > OCTREE_MAX_LEAVES) ReduceOctree(tree);     // A node with one child frees no leaf
+    }
+
+    ColorBin bins[OCTREE_MAX_LEAVES];
+    int n_bins = 0;
+    CollectOctreeLeaves(tree, 0, bins, &n_bins);
+    ScratchFree(arena, tree);
+    ScratchFree(arena, histogram);
+
+    // Merge the closest pair (least added error) until the palette size is left.
+    while (n_bins > n_colors)
+    {
+        int best_a = 0, best_b = 1;
+        double best_cost = -1.0;
+        for (int a = 0; a < n_bins; a++)
+        {
+            for (int b = a + 1; b < n_bins; b++)
+            {
+                double cost = MergeCost(&bins[a], &bins[b]);
+                if (best_cost < 0.0 || cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+        }
+        MergeBins(&bins[best_a], &bins[best_b]);
+        bins[best_b] = bins[--n_bins];
+    }
+
+    OrderPalette(bins, n_bins, palette, n_colors, arena);
+}
+
+//------------------------------------------------------------------------------------
+// Median cut
+//------------------------------------------------------------------------------------
+// Squared error of a box, counting each bin's pixels at the bin's mean color
+static void MeasureBox(ColorBox *box, const HistogramEntry *entries, const ColorBin *histogram)
+{
+    double count = 0.0, sum[3] = { 0 }, squares[3] = { 0 };
+    int low[3] = { QUANTIZER_SIDE, QUANTIZER_SIDE, QUANTIZER_SIDE }, high[3] = { -1, -1, -1 };
+    for (int i = box->start; i < box->end; i++)
+    {
+        const ColorBin *bin = &histogram[entries[i].bin];
+        count += bin->count;
+        for (int c = 0; c < 3; c++)
+        {
+            sum[c] += bin->sum[c];
+            squares[c] += (double)bin->sum[c] * bin->sum[c] / bin->count;
+            if (entries[i].coordinates[c] < low[c]) low[c] = entries[i].coordinates[c];
+            if (entries[i].coordinates[c] > high[c]) high[c] = entries[i].coordinates[c];
+        }
+    }
+
+    // Only a channel the bins differ on can be cut; a box of several bins always has one.
+    box->error = 0.0;
+    box->axis = 0;
+    double largest = -1.0;
+    for (int c = 0; c < 3; c++)
+    {
+        double variance = squares[c] - sum[c] * sum[c] / count;
+        box->error += variance;
+        if (high[c] > low[c] && variance > largest)
+        {
+            largest = variance;
+            box->axis = c;
+        }
+    }
+}
+
+// Splits the box in two along its axis, at the cut leaving the least error on it; returns the start of the second half.
+static int SplitBox(const ColorBox *box, HistogramEntry *entries, const ColorBin *histogram)
+{
+    int axis = box->axis;
+    double count[QUANTIZER_SIDE] = { 0 }, sum[QUANTIZER_SIDE] = { 0 };
+    double total_count = 0.0, total_sum = 0.0;
+    int low = QUANTIZER_SIDE - 1, high = 0;
+    for (int i = box->start; i < box->end; i++)
+    {
+        const ColorBin *bin = &histogram[entries[i].bin];
+        int value = entries[i].coordinates[axis];
+        count[value] += bin->count;
+        sum[value] += bin->sum[axis];
+        total_count += bin->count;
+        total_sum += bin->sum[axis];
+        if (value < low) low = value;
+        if (value > high) high = value;
+    }
+
+    // Least error left on the axis = most of sum^2 / count kept by the two halves
+    int cut = low;
+    double best = -1.0, below_count = 0.0, below_sum = 0.0;
+    for (int value = low; value < high; value++)
+    {
+        below_count += count[value];
+        below_sum += sum[value];
+        if (below_count == 0.0 || below_count == total_count) continue;
+
+        double above_count = total_count - below_count, above_sum = total_sum - below_sum;
+        double kept = below_sum * below_sum / below_count + above_sum * above_sum / above_count;
+        if (kept > best)
+        {
+            best = kept;
+            cut = value;
+        }
+    }
+
+    int middle = box->start;
+    for (int i = box->start; i < box->end; i++)
+    {
+        if (entries[i].coordinates[axis] > cut) continue;
+        HistogramEntry swap = entries[middle];
+        entries[middle++] = entries[i];
+        entries[i] = swap;
+    }
+    return middle;
+}
+
+static void QuantizeMedianCut(ColorPlanes planes, Color *palette, int n_colors, Arena *arena)
+{
+    ColorBin *histogram = LoadHistogram(planes, arena);
+    HistogramEntry *entries = ScratchAlloc(arena, QUANTIZER_BINS * sizeof(HistogramEntry));
+    ColorBox *boxes = ScratchAlloc(arena, n_colors * sizeof(ColorBox));
+    ColorBin *colors = ScratchAlloc(arena, n_colors * sizeof(ColorBin));
+
+    if (histogram == NULL || entries == NULL || boxes == NULL || colors == NULL)
+    {
+        ScratchFree(arena, histogram);
+        ScratchFree(arena, entries);
+        ScratchFree(arena, boxes);
+        ScratchFree(arena, colors);
+        return;
+    }
+
+    int n_entries = 0;
+    for (int bin = 0; bin < QUANTIZER_BINS; bin++)
+    {
+        if (histogram[bin].count == 0) continue;
+        entries[n_entries++] = (HistogramEntry){
+            .bin = (uint16_t)bin,
+            .coordinates = { bin >> (2 * QUANTIZER_BITS), (bin >> QUANTIZER_BITS) & (QUANTIZER_SIDE - 1), bin & (QUANTIZER_SIDE - 1) },
+        };
+    }
+
+    int n_boxes = 1;
+    boxes[0] = (ColorBox){ .start = 0, .end = n_entries };
+    MeasureBox(&boxes[0], entries, histogram);
+
+    while (n_boxes < n_colors)
+    {
+        // Boxes of a single bin can't be split.
+        int split = -1;
+        for (int i = 0; i < n_boxes; i++)
+        {
+            if (boxes[i].end - boxes[i].start > 1 && (split < 0 || boxes[i].error > boxes[split].error)) split = i;
+        }
+        if (split < 0) break;
+
+        ColorBox *box = &boxes[split];
+        int middle = SplitBox(box, entries, histogram);
+
+        boxes[n_boxes] = (ColorBox){ .start = middle, .end = box->end };
+        box->end = middle;
+        MeasureBox(box, entries, histogram);
+        MeasureBox(&boxes[n_boxes], entries, histogram);
+        n_boxes++;
+    }
+
+    for (int i = 0; i < n_boxes; i++)
+    {
+        colors[i] = (ColorBin){ 0 };
+        for (int e = boxes[i].start; e < boxes[i].end; e++) MergeBins(&colors[i], &histogram[entries[e].bin]);
+    }
+
+    OrderPalette(colors, n_boxes, palette, n_colors, arena);
+
+    ScratchFree(arena, histogram);
+    ScratchFree(arena, entries);
+    ScratchFree(arena, boxes);
+    ScratchFree(arena, colors);
+}
@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+
+#include "raylib.h"
+#include "kmeans.h"
+#include "palette.h"
+#include "oklab.h"
+#include "jpeg_scaled.h"
+#include "resample.h"
+#include "track_loader.h"
+#include "palette_bench.h"
+
+/*
+ * Palette benchmark.
+ * -----------------------------------------------------------
+ * Runs without a window, so times come from timespec_get() rather than
+ * GetTime(). Every variant gets the same KMeansOptions.seed; the reference
+ * is the scalar per-pixel k-means over the full-size image, which the SIMD
+ * kernels, every thread count and the Hamerly bounds must match exactly.
+ * "distance" is the worst distance from a color to the nearest reference
+ * color and must stay within PALETTE_TOLERANCE; "sse" is how much more
+ * squared error than the reference a palette leaves over the full image,
+ * which is what the approximate mini-batch runs are held to, as they may
+ * land on another optimum. "skipped" is the share of a plain Lloyd pass's
+ * distance evaluations that the Hamerly bounds avoided. The thumbnail and
+ * k-means++ runs are there for timing only: they start from other centroids
+ * and may settle on another local optimum. So may the "backend" rows, which
+ * run QuantizePalette() as the track loader does: k-means with PALETTE_SEED,
+ * then the octree and median-cut quantizers, whose distance and sse are
+ * reported for comparison only.
+ *
+ * The OKLab rows cluster by perceptual distance, so their sse (taken in RGB)
+ * is expected to be higher. The histogram one, what the kmeans-oklab backend
+ * runs, is held to cost: conversion plus clustering within
+ * PALETTE_COST_BUDGET times the same run in RGB, the row above it. The
+ * per-pixel one converts every pixel, as much work as a few Lloyd passes on
+ * a large cover, and is timed only. The ingest line times the OKLab
+ * conversion of the full image on its own.
+ *
+ * For JPEG files, a decode line compares what the track loader did before
+ * and does now with a cover: a full decode then ImageResize(), against the
+ * reduced decode then ResampleImage(), with the size of each decoded image.
+ * The resize line takes the full image down to ALBUM_COVER_SIZE with
+ * ImageResize() and ResampleImage() with each filter; the SIMD and threaded
+ * bicubic runs must reproduce the scalar one exactly.
+ *
+ * Given several images, a corpus summary follows: total time, speedup over
+ * the default getDominantColors() (per-pixel SIMD), worst distance and mean
+ * extra squared error per variant.
+ * -----------------------------------------------------------
+ */
+
+typedef enum
+{
+    CHECK_EXACT,                // Must reproduce the reference palette bit for bit
+    CHECK_TOLERANCE,            // Within PALETTE_TOLERANCE of the reference
+    CHECK_ERROR,                // Within PALETTE_ERROR_TOLERANCE of the reference's squared error; may find another optimum
+    CHECK_COST,                 // Within PALETTE_COST_BUDGET times the time of the row above (OKLab against RGB)
+    CHECK_NONE,                 // Timed only
+} PaletteCheck;
+
+typedef struct
+{
+    const char *name;
+    bool thumbnail;             // Run on the ALBUM_COVER_SIZE thumbnail instead
+    PaletteCheck check;
+    KMeansOptions options;
+    bool quantizer;             // Run QuantizePalette() with the backend below instead, as the track loader does
+    PaletteBackend backend;
+} PaletteVariant;
+
+typedef struct
+{
+    double seconds;
+    float worst_distance;
+    double extra_error;         // Summed over the images, as a fraction of the reference's error
+    int failures;
+} VariantTotals;
+
+static const PaletteVariant variants[] = {
+    { "per-pixel scalar", false, CHECK_EXACT, { .scalar = true }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel SIMD", false, CHECK_EXACT, { 0 }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel OKLab", false, CHECK_NONE, { .color_space = KMEANS_OKLAB }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel SIMD, 2 threads", false, CHECK_EXACT, { .threads = 2 }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel SIMD, 4 threads", false, CHECK_EXACT, { .threads = 4 }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel SIMD, 8 threads", false, CHECK_EXACT, { .threads = 8 }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel SIMD, 16 threads", false, CHECK_EXACT, { .threads = 16 }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel Hamerly", false, CHECK_EXACT, { .algorithm = KMEANS_HAMERLY }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel Hamerly, 4 threads", false, CHECK_EXACT, { .algorithm = KMEANS_HAMERLY, .threads = 4 }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel k-means++", false, CHECK_NONE, { .init = KMEANS_INIT_PLUSPLUS }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel mini-batch", false, CHECK_ERROR, { .algorithm = KMEANS_MINIBATCH }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel mini-batch 4096", false, CHECK_ERROR, { .algorithm = KMEANS_MINIBATCH, .batch_size = 4096 }, false, PALETTE_BACKEND_KMEANS },
+    { "per-pixel (thumbnail)", true, CHECK_NONE, { 0 }, false, PALETTE_BACKEND_KMEANS },
+    { "histogram 15-bit", false, CHECK_TOLERANCE, { .histogram_bits = 15 }, false, PALETTE_BACKEND_KMEANS },
+    { "histogram 15-bit OKLab", false, CHECK_COST, { .histogram_bits = 15, .color_space = KMEANS_OKLAB }, false, PALETTE_BACKEND_KMEANS },
+    { "histogram 18-bit", false, CHECK_TOLERANCE, { .histogram_bits = 18 }, false, PALETTE_BACKEND_KMEANS },
+    { "histogram 18-bit Hamerly", false, CHECK_TOLERANCE, { .histogram_bits = 18, .algorithm = KMEANS_HAMERLY }, false, PALETTE_BACKEND_KMEANS },
+    { "histogram 15-bit k-means++", false, CHECK_NONE, { .histogram_bits = 15, .init = KMEANS_INIT_PLUSPLUS }, false, PALETTE_BACKEND_KMEANS },
+    { "histogram 15-bit mini-batch", false, CHECK_ERROR, { .histogram_bits = 15, .algorithm = KMEANS_MINIBATCH }, false, PALETTE_BACKEND_KMEANS },
+    { "backend kmeans", false, CHECK_NONE, { 0 }, true, PALETTE_BACKEND_KMEANS },
+    { "backend kmeans-oklab", false, CHECK_NONE, { 0 }, true, PALETTE_BACKEND_KMEANS_OKLAB },
+    { "backend octree", false, CHECK_NONE, { 0 }, true, PALETTE_BACKEND_OCTREE },
+    { "backend median-cut", false, CHECK_NONE, { 0 }, true, PALETTE_BACKEND_MEDIAN_CUT },
+};
+
+#define N_VARIANTS (int)(sizeof(variants) / sizeof(variants[0]))
+#define DEFAULT_VARIANT 1       // What getDominantColors() runs
+
+static double Now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Color *LoadColors(Image image, int *n_points)
+{
+    *n_points = image.width * image.height;
+    Color *colors = malloc(*n_points * sizeof(Color));
+    if (colors == NULL) return NULL;
+
+    for (int y = 0; y < image.height; y++)
+    {
+        for (int x = 0; x < image.width; x++) colors[y * image.width + x] = GetImageColor(image, x, y);
+    }
+    return colors;
+}
+
+static float PaletteDistance(const Color *palette, const Color *reference)
+{
+    float worst = 0.0f;
+    for (int i = 0; i < PALETTE_SIZE; i++)
+    {
+        float nearest = INFINITY;
+        for (int j = 0; j < PALETTE_SIZE; j++)
+        {
+            Color a = palette[i], b = reference[j];
+            float d = sqrtf((float)distanceSquared(&a, &b));
+            if (d < nearest) nearest = d;
+        }
+        if (nearest > worst) worst = nearest;
+    }
+    return worst;
+}
+
+/* Sum over the pixels of the squared distance to the nearest palette color. */
+static double PaletteError(ColorPlanes planes, const Color *palette)
+{
+    double error = 0.0;
+    for (int point = 0; point < planes.count; point++)
+    {
+        int nearest = INT_MAX;
+        for (int i = 0; i < PALETTE_SIZE; i++)
+        {
+            int r = planes.r[point] - palette[i].r;
+            int g = planes.g[point] - palette[i].g;
+            int b = planes.b[point] - palette[i].b;
+            int d = r*r + g*g + b*b;
+            if (d < nearest) nearest = d;
+        }
+        error += nearest;
+    }
+    return error;
+}
+
+static double TimeVariant(const PaletteVariant *variant, ColorPlanes planes, Color *palette, KMeansStats *stats)
+{
+    KMeansOptions options = variant->options;
+    options.seed = PALETTE_BENCH_SEED;
+    options.stats = stats;
+
+    double best = INFINITY;
+    for (int run = 0; run < PALETTE_BENCH_RUNS; run++)
+    {
+        double start = Now();
+        if (variant->quantizer) QuantizePalette(variant->backend, planes, palette, PALETTE_SIZE, NULL);
+        else getDominantColorsFromPlanes(planes, palette, PALETTE_SIZE, options);
+        double elapsed = Now() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static void BenchmarkDecode(const char *image_path)
+{
+    int size = 0;
+    unsigned char *data = LoadFileData(image_path, &size);
+
+    if (IsJpegData(data, size))
+    {
+        double full_seconds = INFINITY, scaled_seconds = INFINITY;
+        Image full = { 0 }, scaled = { 0 };
+        for (int run = 0; run < PALETTE_BENCH_RUNS; run++)
+        {
+            UnloadImage(full);
+            UnloadImage(scaled);
+
+            double start = Now();
+            full = LoadImageFromMemory(".jpg", data, size);
+            Image thumbnail = ImageCopy(full);
+            ImageResize(&thumbnail, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE);
+            double elapsed = Now() - start;
+            if (elapsed < full_seconds) full_seconds = elapsed;
+            UnloadImage(thumbnail);
+
+            start = Now();
+            scaled = LoadJpegScaled(data, size, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE);
+            thumbnail = ImageCopy(scaled);
+            ResampleImage(&thumbnail, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE, COVER_RESAMPLE_OPTIONS);
+            elapsed = Now() - start;
+            if (elapsed < scaled_seconds) scaled_seconds = elapsed;
+            UnloadImage(thumbnail);
+        }
+
+        if (IsImageReady(scaled))
+        {
+            printf("decode: full %.2f ms (%dx%d, %d KB), scaled %.2f ms (%dx%d, %d KB)\n",
+                   full_seconds * 1000.0, full.width, full.height, GetPixelDataSize(full.width, full.height, full.format) / 1024,
+                   scaled_seconds * 1000.0, scaled.width, scaled.height, GetPixelDataSize(scaled.width, scaled.height, scaled.format) / 1024);
+        }
+        else printf("decode: full %.2f ms, not a baseline JPEG\n", full_seconds * 1000.0);
+
+        UnloadImage(full);
+        UnloadImage(scaled);
+    }
+
+    UnloadFileData(data);
+}
+
+/* Best of PALETTE_BENCH_RUNS resizes of the image to the thumbnail size; ImageResize() when options is NULL. */
+static double TimeResize(Image image, const ResampleOptions *options, Image *result)
+{
+    double best = INFINITY;
+    for (int run = 0; run < PALETTE_BENCH_RUNS; run++)
+    {
+        UnloadImage(*result);
+        *result = ImageCopy(image);
+
+        double start = Now();
+        if (options != NULL) ResampleImage(result, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE, *options);
+        else ImageResize(result, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE);
+        double elapsed = Now() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static bool BenchmarkResize(Image image)
+{
+    const ResampleOptions scalar = { RESAMPLE_BICUBIC, 1, true }, simd = { RESAMPLE_BICUBIC, 1, false };
+    const ResampleOptions box = { RESAMPLE_BOX, 1, false }, lanczos = { RESAMPLE_LANCZOS3, 1, false };
+
+    Image results[6] = { 0 };
+    double seconds[6] = {
+        TimeResize(image, NULL, &results[0]),
+        TimeResize(image, &scalar, &results[1]),
+        TimeResize(image, &simd, &results[2]),
+        TimeResize(image, &COVER_RESAMPLE_OPTIONS, &results[3]),
+        TimeResize(image, &box, &results[4]),
+        TimeResize(image, &lanczos, &results[5]),
+    };
+
+    bool identical = true;
+    int size = GetPixelDataSize(results[1].width, results[1].height, results[1].format);
+    for (int i = 2; i <= 3; i++)
+    {
+        if ((results[i].format != results[1].format) || (memcmp(results[i].data, results[1].data, size) != 0)) identical = false;
+    }
+
+    printf("resize: ImageResize %.2f ms, %s scalar %.2f ms, SIMD %.2f ms, %d threads %.2f ms%s, %s %.2f ms, %s %.2f ms\n",
+           seconds[0] * 1000.0, GetResampleFilterName(RESAMPLE_BICUBIC), seconds[1] * 1000.0, seconds[2] * 1000.0,
+           COVER_RESAMPLE_THREADS, seconds[3] * 1000.0, identical ? "" : " NOT IDENTICAL",
+           GetResampleFilterName(RESAMPLE_BOX), seconds[4] * 1000.0, GetResampleFilterName(RESAMPLE_LANCZOS3), seconds[5] * 1000.0);
+
+    for (int i = 0; i < 6; i++) UnloadImage(results[i]);
+    return identical;
+}
+
+static bool BenchmarkImage(const char *image_path, VariantTotals *totals, int *resize_failures)
+{
+    Image image = LoadImage(image_path);
+    if (!IsImageReady(image))
+    {
+        printf("Unable to load %s\n", image_path);
+        return false;
+    }
+
+    Image thumbnail = ImageCopy(image);
+    ImageResize(&thumbnail, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE);
+
+    // Pixel ingest: one GetImageColor() call per pixel against reading the image buffer into planes.
+    int n_full = 0;
+    double start = Now();
+    Color *colors = LoadColors(image, &n_full);
+    double get_color_seconds = Now() - start;
+
+    ColorPlanes full = { 0 }, thumb = { 0 };
+    start = Now();
+    LoadColorPlanes(image, &full, NULL);
+    double planes_seconds = Now() - start;
+    LoadColorPlanes(thumbnail, &thumb, NULL);
+    free(colors);
+
+    ColorPlanes oklab = { 0 };
+    LoadOklabPlanes(&full, &oklab, NULL);     // Builds the tables, so the timed conversion below doesn't
+    UnloadColorPlanes(&oklab);
+    start = Now();
+    LoadOklabPlanes(&full, &oklab, NULL);
+    double oklab_seconds = Now() - start;
+    UnloadColorPlanes(&oklab);
+
+    Color reference[PALETTE_SIZE];
+    double reference_error = 0.0;
+
+    printf("%s: %dx%d, %d pixels\n", image_path, image.width, image.height, n_full);
+    printf("ingest: GetImageColor %.2f ms, image buffer to planes %.2f ms, planes to OKLab %.2f ms\n",
+           get_color_seconds * 1000.0, planes_seconds * 1000.0, oklab_seconds * 1000.0);
+    BenchmarkDecode(image_path);
+    if (!BenchmarkResize(image)) (*resize_failures)++;
+    printf("%-28s %10s %6s %8s %10s %7s  palette\n", "variant", "ms", "iters", "skipped", "distance", "sse");
+
+    bool loaded = (full.count > 0 && thumb.count > 0);
+    double previous_seconds = 0.0;
+
+    for (int v = 0; v < N_VARIANTS && loaded; v++)
+    {
+        const PaletteVariant *variant = &variants[v];
+        Color palette[PALETTE_SIZE];
+
+        KMeansStats stats = { 0 };
+        double seconds = TimeVariant(variant, variant->thumbnail ? thumb : full, palette, &stats);
+        int64_t lloyd_evaluations = stats.distance_evaluations + stats.distances_skipped;
+        double skipped = (lloyd_evaluations > 0) ? 100.0 * stats.distances_skipped / lloyd_evaluations : 0.0;
+
+        double error = PaletteError(full, palette);
+        if (v == 0)
+        {
+            memcpy(reference, palette, sizeof(reference));
+            reference_error = error;
+        }
+        double extra_error = (reference_error > 0.0) ? error / reference_error - 1.0 : 0.0;
+
+        float distance = PaletteDistance(palette, reference);
+        bool pass = (variant->check == CHECK_EXACT) ? (memcmp(palette, reference, sizeof(reference)) == 0) :
+                    (variant->check == CHECK_TOLERANCE) ? (distance <= PALETTE_TOLERANCE) :
+                    (variant->check == CHECK_ERROR) ? (extra_error <= PALETTE_ERROR_TOLERANCE) :
+                    (variant->check == CHECK_COST) ? (seconds <= PALETTE_COST_BUDGET * previous_seconds) : true;
+        previous_seconds = seconds;
+
+        VariantTotals *total = &totals[v];
+        total->seconds += seconds;
+        total->extra_error += extra_error;
+        if (distance > total->worst_distance) total->worst_distance = distance;
+        if (!pass) total->failures++;
+
+        printf("%-28s %10.2f %6d %7.1f%% %10.1f %+6.1f%%  ", variant->name, seconds * 1000.0, stats.iterations, skipped, distance, extra_error * 100.0);
+        for (int i = 0; i < PALETTE_SIZE; i++) printf("#%02X%02X%02X ", palette[i].r, palette[i].g, palette[i].b);
+        printf("%s\n", pass ? "" : (variant->check == CHECK_EXACT) ? "NOT IDENTICAL" : (variant->check == CHECK_COST) ? "OVER BUDGET" : "OUT OF TOLERANCE");
+    }
+    printf("\n");
+
+    UnloadColorPlanes(&full);
+    UnloadColorPlanes(&thumb);
+    UnloadImage(thumbnail);
+    UnloadImage(image);
+
+    return loaded;
+}
+
+int RunPaletteBenchmark(int n_images, const char **image_paths)
+{
+    VariantTotals totals[N_VARIANTS] = { 0 };
+    int n_benchmarked = 0, resize_failures = 0;
+    bool all_loaded = true;
+
+    for (int i = 0; i < n_images; i++)
+    {
+        if (BenchmarkImage(image_paths[i], totals, &resize_failures)) n_benchmarked++;
+        else all_loaded = false;
+    }
+
+    int failures = resize_failures;
+    for (int v = 0; v < N_VARIANTS; v++) failures += totals[v].failures;
+
+    if (n_benchmarked > 1)
+    {
+        printf("corpus: %d images\n", n_benchmarked);
+        printf("%-28s %10s %8s %10s %9s %9s\n", "variant", "total ms", "speedup", "worst", "mean sse", "failures");
+        for (int v = 0; v < N_VARIANTS; v++)
+        {
+            const VariantTotals *total = &totals[v];
+            printf("%-28s %10.2f %7.2fx %10.1f %+8.1f%% %9d\n", variants[v].name, total->seconds * 1000.0,
+                   totals[DEFAULT_VARIANT].seconds / total->seconds, total->worst_distance,
+                   total->extra_error / n_benchmarked * 100.0, total->failures);
+        }
+    }
+
+    return (all_loaded && failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
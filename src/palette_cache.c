@@ -0,0 +1,282 @@
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#define _POSIX_C_SOURCE 200809L     // mkdir
+#include <sys/stat.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "raylib.h"
+#include "palette.h"
+#include "palette_cache.h"
+
+/*
+ * Palette cache.
+ * -----------------------------------------------------------
+ * PALETTE_CACHE_DIRECTORY holds an index and one QOI thumbnail per cover:
+ *
+ *   index.bin         header, then CacheRecords appended as covers are
+ *                     stored; on open the last record of each slot wins,
+ *                     and the file is rewritten once it holds more than
+ *                     twice PALETTE_CACHE_SLOTS records,
+ *   <key>.qoi         the ALBUM_COVER_SIZE thumbnail, removed when its
+ *                     record is evicted.
+ *
+ * The key is a 64-bit hash of the encoded cover, eight bytes per step: a
+ * 1 MB JPEG hashes in a fraction of a millisecond, against tens of
+ * milliseconds to decode and cluster it. Records are written in the
+ * machine's layout; the header's version and record size reject an index
+ * from another build.
+ * -----------------------------------------------------------
+ */
+
+#define CACHE_MAGIC "SSPC"
+#define CACHE_PATH_SIZE 512
+#define EMPTY_KEY 0
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+} CacheHeader;
+
+typedef struct
+{
+    uint64_t key;
+    uint32_t backends;                                  // Bit per PaletteBackend with a palette below
+    uint32_t has_thumbnail;
+    Color palettes[PALETTE_BACKEND_COUNT][PALETTE_SIZE];
+} CacheRecord;
+
+static struct
+{
+    pthread_mutex_t lock;
+    bool open;
+    char directory[CACHE_PATH_SIZE - 32];
+    FILE *index;                                        // Appended to, one record per store
+    CacheRecord slots[PALETTE_CACHE_SLOTS];
+} cache = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void CachePath(char *path, const char *file_name)
+{
+    snprintf(path, CACHE_PATH_SIZE, "%s/%s", cache.directory, file_name);
+}
+
+static void ThumbnailPath(char *path, uint64_t key)
+{
+    snprintf(path, CACHE_PATH_SIZE, "%s/%016llx.qoi", cache.directory, (unsigned long long)key);
+}
+
+static bool MakeCacheDirectory(const char *directory)
+{
+    if (DirectoryExists(directory)) return true;
+#if defined(_WIN32)
+    return _mkdir(directory) == 0;
+#else
+    return mkdir(directory, 0755) == 0;
+#endif
+}
+
+static bool WriteIndexHeader(FILE *index)
+{
+    CacheHeader header = { .version = PALETTE_CACHE_VERSION, .record_size = sizeof(CacheRecord) };
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    return fwrite(&header, sizeof(header), 1, index) == 1;
+}
+
+// Replays the index into the slots; returns the number of records, or -1 if the file is missing or unusable.
+static int ReadIndex(const char *path)
+{
+    FILE *index = fopen(path, "rb");
+    if (index == NULL) return -1;
+
+    CacheHeader header;
+    if (fread(&header, sizeof(header), 1, index) != 1 || memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PALETTE_CACHE_VERSION || header.record_size != sizeof(CacheRecord))
+    {
+        fclose(index);
+        return -1;
+    }
+
+    int n_records = 0;
+    CacheRecord record;
+    while (fread(&record, sizeof(record), 1, index) == 1)
+    {
+        if (record.key != EMPTY_KEY) cache.slots[record.key % PALETTE_CACHE_SLOTS] = record;
+        n_records++;
+    }
+
+    fclose(index);
+    return n_records;
+}
+
+static bool RewriteIndex(const char *path)
+{
+    FILE *index = fopen(path, "wb");
+    if (index == NULL) return false;
+
+    bool ok = WriteIndexHeader(index);
+    for (int i = 0; i < PALETTE_CACHE_SLOTS && ok; i++)
+    {
+        if (cache.slots[i].key != EMPTY_KEY) ok = (fwrite(&cache.slots[i], sizeof(CacheRecord), 1, index) == 1);
+    }
+    return (fclose(index) == 0) && ok;
+}
+
+bool OpenPaletteCache(const char *directory)
+{
+    pthread_mutex_lock(&cache.lock);
+
+    memset(cache.slots, 0, sizeof(cache.slots));
+    snprintf(cache.directory, sizeof(cache.directory), "%s", directory);
+
+    char path[CACHE_PATH_SIZE];
+    CachePath(path, "index.bin");
+
+    if (MakeCacheDirectory(directory))
+    {
+        int n_records = ReadIndex(path);
+        bool ok = (n_records >= 0 && n_records <= 2 * PALETTE_CACHE_SLOTS) || RewriteIndex(path);
+        if (ok) cache.index = fopen(path, "ab");
+    }
+
+    cache.open = (cache.index != NULL);
+    if (!cache.open) TraceLog(LOG_WARNING, "PALETTE: Unable to open the palette cache in %s", directory);
+
+    pthread_mutex_unlock(&cache.lock);
+    return cache.open;
+}
+
+void ClosePaletteCache(void)
+{
+    pthread_mutex_lock(&cache.lock);
+    if (cache.index != NULL) fclose(cache.index);
+    cache.index = NULL;
+    cache.open = false;
+    pthread_mutex_unlock(&cache.lock);
+}
+
+uint64_t HashCoverData(const unsigned char *data, int size)
+{
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    uint64_t hash = prime ^ (uint64_t)size;
+    int i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+
+    uint64_t tail = 0;
+    for (int shift = 0; i < size; i++, shift += 8) tail |= (uint64_t)data[i] << shift;
+    hash = (hash ^ tail) * prime;
+
+    // Final avalanche (MurmurHash3 fmix64), so the low bits pick slots evenly
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+
+    return (hash == EMPTY_KEY) ? 1 : hash;
+}
+
+bool LoadCachedCover(uint64_t key, PaletteBackend backend, Color *palette, Image *thumbnail)
+{
+    bool hit = false;
+
+    pthread_mutex_lock(&cache.lock);
+    const CacheRecord *record = &cache.slots[key % PALETTE_CACHE_SLOTS];
+    if (cache.open && record->key == key && record->has_thumbnail && (record->backends & (1u << backend)))
+    {
+        char path[CACHE_PATH_SIZE];
+        ThumbnailPath(path, key);
+
+        Image image = LoadImage(path);
+        if (IsImageReady(image) && image.width == ALBUM_COVER_SIZE && image.height == ALBUM_COVER_SIZE)
+        {
+            memcpy(palette, record->palettes[backend], sizeof(record->palettes[backend]));
+            *thumbnail = image;
+            hit = true;
+        }
+        else
+        {
+            UnloadImage(image);
+        }
+    }
+    pthread_mutex_unlock(&cache.lock);
+
+    return hit;
+}
+
+bool LoadCachedPalette(uint64_t key, PaletteBackend backend, Color *palette)
+{
+    bool hit = false;
+
+    pthread_mutex_lock(&cache.lock);
+    const CacheRecord *record = &cache.slots[key % PALETTE_CACHE_SLOTS];
+    if (cache.open && record->key == key && (record->backends & (1u << backend)))
+    {
+        memcpy(palette, record->palettes[backend], sizeof(record->palettes[backend]));
+        hit = true;
+    }
+    pthread_mutex_unlock(&cache.lock);
+
+    return hit;
+}
+
+void StoreCachedCover(uint64_t key, PaletteBackend backend, const Color *palette, Image thumbnail)
+{
+    char path[CACHE_PATH_SIZE];
+
+    pthread_mutex_lock(&cache.lock);
+    if (!cache.open)
+    {
+        pthread_mutex_unlock(&cache.lock);
+        return;
+    }
+
+    CacheRecord *record = &cache.slots[key % PALETTE_CACHE_SLOTS];
+    if (record->key != key)
+    {
+        if (record->key != EMPTY_KEY && record->has_thumbnail)
+        {
+            ThumbnailPath(path, record->key);
+            remove(path);
+        }
+        memset(record, 0, sizeof(CacheRecord));
+        record->key = key;
+    }
+
+    if (!record->has_thumbnail)
+    {
+        // QOI takes 3 or 4 channels; grayscale covers are expanded.
+        Image copy = thumbnail;
+        bool converted = (thumbnail.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8 && thumbnail.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+        if (converted)
+        {
+            copy = ImageCopy(thumbnail);
+            ImageFormat(&copy, PIXELFORMAT_UNCOMPRESSED_R8G8B8);
+        }
+
+        ThumbnailPath(path, key);
+        record->has_thumbnail = ExportImage(copy, path);
+        if (converted) UnloadImage(copy);
+    }
+
+    memcpy(record->palettes[backend], palette, sizeof(record->palettes[backend]));
+    record->backends |= 1u << backend;
+
+    fwrite(record, sizeof(CacheRecord), 1, cache.index);
+    fflush(cache.index);
+
+    pthread_mutex_unlock(&cache.lock);
+}
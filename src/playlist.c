@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "playlist.h"
+
+/* Appends a copy of file_path; returns its index, or -1 when out of memory. */
+int AddToPlaylist(Playlist *playlist, const char *file_path)
+{
+    if (playlist->count == playlist->capacity)
+    {
+        int capacity = (playlist->capacity == 0) ? 16 : playlist->capacity * 2;
+        char **paths = realloc(playlist->paths, capacity * sizeof(char *));
+        if (paths == NULL) return -1;
+        playlist->paths = paths;
+
+        bool *failed = realloc(playlist->failed, capacity * sizeof(bool));
+        if (failed == NULL) return -1;
+        playlist->failed = failed;
+
+        playlist->capacity = capacity;
+    }
+
+    char *path = malloc(strlen(file_path) + 1);
+    if (path == NULL) return -1;
+    strcpy(path, file_path);
+
+    playlist->paths[playlist->count] = path;
+    playlist->failed[playlist->count] = false;
+    return playlist->count++;
+}
+
+const char *GetPlaylistPath(const Playlist *playlist, int index)
+{
+    if (index < 0 || index >= playlist->count) return NULL;
+    return playlist->paths[index];
+}
+
+/* Index that plays after index, wrapping around past failed items; -1 when there is nothing else to play. */
+int GetNextPlaylistIndex(const Playlist *playlist, int index)
+{
+    if (index < 0) return -1;
+
+    for (int i = 1; i < playlist->count; i++)
+    {
+        int next = (index + i) % playlist->count;
+        if (!playlist->failed[next]) return next;
+    }
+    return -1;
+}
+
+void MarkPlaylistItemFailed(Playlist *playlist, int index)
+{
+    if (index >= 0 && index < playlist->count) playlist->failed[index] = true;
+}
+
+void UnloadPlaylist(Playlist *playlist)
+{
+    for (int i = 0; i < playlist->count; i++)
+    {
+        free(playlist->paths[i]);
+    }
+    free(playlist->paths);
+    free(playlist->failed);
+
+    playlist->paths = NULL;
+    playlist->failed = NULL;
+    playlist->count = 0;
+    playlist->capacity = 0;
+}
@@ -0,0 +1,493 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "raylib.h"
+#include "resample.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define RESAMPLE_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Separable resampling.
+ * -----------------------------------------------------------
+ * Each output column (and row) is a weighted sum of a window of source
+ * columns (rows): the filter, stretched by the shrink factor, centred on the
+ * output pixel. The windows and their weights are computed once per axis,
+ * in Q14 fixed point and rounded so that they sum to exactly 1 (flat areas
+ * stay flat), with every window padded to the same even number of taps.
+ *
+ * Both kernels take taps two at a time: interleaving the bytes of two
+ * pixels (or rows) as 16-bit pairs lets one madd multiply both by their
+ * weights and add them. The vertical one runs down whole rows, 16 (SSE2) or
+ * 32 (AVX2) bytes per step; the horizontal one gets 3 or 4 useful lanes out
+ * of each madd, so a tap costs it several times as much (ROW_PASS_COST).
+ * Which pass goes first is picked from that: when shrinking, filtering the
+ * columns first leaves the horizontal pass only the output rows, rather
+ * than every source row. Either way the intermediate rows go to a scratch
+ * buffer and the second pass writes the destination image, which is
+ * allocated once and handed back as the image's data.
+ *
+ * Threads get contiguous bands of output rows. Rows first, source rows at
+ * the edge of two bands are filtered by both, a window's worth per band;
+ * columns first, bands share nothing. Every output byte is computed the
+ * same way whatever the band, so any thread count gives the same image.
+ * -----------------------------------------------------------
+ */
+
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+#define WEIGHT_ROUND (1 << (WEIGHT_BITS - 1))
+#define MIN_PIXELS_PER_BAND (128 * 1024)        // Source pixels; fewer and starting the thread costs more than the work
+#define ROW_PASS_COST 4                         // Horizontal kernel's cost per byte and tap, against the vertical one's
+
+typedef struct
+{
+    int *first;                 // First source index of each output index's window
+    int16_t *weights;           // taps per output index
+    int taps;                   // Even
+} ResampleAxis;
+
+typedef void (*HorizontalKernel)(const unsigned char *row, unsigned char *out, const ResampleAxis *axis, int width, int channels);
+typedef void (*VerticalKernel)(const unsigned char **rows, const int16_t *weights, int taps, unsigned char *out, int n_bytes);
+
+typedef struct
+{
+    const unsigned char *source;
+    int source_width, source_height;
+    int channels;
+    unsigned char *destination;
+    int width;
+    const ResampleAxis *horizontal, *vertical;
+    HorizontalKernel filter_row;
+    VerticalKernel filter_column;
+    int start, end;             // Output rows [start, end)
+    bool columns_first;         // Vertical pass first
+    bool ok;
+} ResampleBand;
+
+static double BoxFilter(double x)
+{
+    return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+}
+
+static double BicubicFilter(double x)
+{
+    const double a = -0.5;
+    x = fabs(x);
+    if (x < 1.0) return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+    if (x < 2.0) return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+    return 0.0;
+}
+
+static double Sinc(double x)
+{
+    if (x == 0.0) return 1.0;
+    x *= PI;
+    return sin(x) / x;
+}
+
+static double Lanczos3Filter(double x)
+{
+    return (x > -3.0 && x < 3.0) ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+}
+
+static const struct
+{
+    const char *name;
+    double (*function)(double x);
+    double support;             // Radius at scale 1
+} filters[] = {
+    [RESAMPLE_BOX] = { "box", BoxFilter, 0.5 },
+    [RESAMPLE_BICUBIC] = { "bicubic", BicubicFilter, 2.0 },
+    [RESAMPLE_LANCZOS3] = { "lanczos3", Lanczos3Filter, 3.0 },
+};
+
+#define N_FILTERS (int)(sizeof(filters) / sizeof(filters[0]))
+
+static void UnloadAxis(ResampleAxis *axis)
+{
+    free(axis->first);
+    free(axis->weights);
+    memset(axis, 0, sizeof(ResampleAxis));
+}
+
+static bool LoadAxis(ResampleAxis *axis, int in_size, int out_size, ResampleFilter filter)
+{
+    double scale = (double)in_size / out_size;
+    double stretch = (scale > 1.0) ? scale : 1.0;           // Shrinking widens the filter; enlarging doesn't narrow it
+    double support = filters[filter].support * stretch;
+
+    int taps = (int)ceil(support) * 2 + 1;
+    if (taps > in_size) taps = in_size;
+    taps += taps & 1;
+
+    axis->taps = taps;
+    axis->first = malloc(out_size * sizeof(int));
+    axis->weights = calloc((size_t)out_size * taps, sizeof(int16_t));
+    double *window = malloc(taps * sizeof(double));
+    if (axis->first == NULL || axis->weights == NULL || window == NULL)
+    {
+        free(window);
+        UnloadAxis(axis);
+        return false;
+    }
+
+    for (int i = 0; i < out_size; i++)
+    {
+        double center = (i + 0.5) * scale;
+        int low = (int)floor(center - support + 0.5), high = (int)floor(center + support + 0.5);
+        if (low < 0) low = 0;
+        if (high > in_size) high = in_size;
+        if (high - low > taps) high = low + taps;
+
+        // Slide the window inside the source where possible; taps past the end keep a weight of 0.
+        int first = (low + taps > in_size) ? in_size - taps : low;
+        if (first < 0) first = 0;
+
+        double total = 0.0;
+        for (int k = 0; k < taps; k++)
+        {
+            int source = first + k;
+            window[k] = (source >= low && source < high) ? filters[filter].function((source + 0.5 - center) / stretch) : 0.0;
+            total += window[k];
+        }
+
+        int16_t *weights = axis->weights + (size_t)i * taps;
+        int sum = 0, largest = 0;
+        for (int k = 0; k < taps; k++)
+        {
+            weights[k] = (int16_t)lrint((total != 0.0) ? window[k] / total * WEIGHT_ONE : 0.0);
+            sum += weights[k];
+            if (abs(weights[k]) > abs(weights[largest])) largest = k;
+        }
+        if (total == 0.0)
+        {
+            // A box narrower than the pixel spacing can miss every source pixel: take the nearest one.
+            int nearest = (int)center - first;
+            if (nearest > in_size - 1 - first) nearest = in_size - 1 - first;
+            weights[(nearest < 0) ? 0 : nearest] = WEIGHT_ONE;
+        }
+        else weights[largest] += WEIGHT_ONE - sum;  // Rounding left over, on the largest tap
+
+        axis->first[i] = first;
+    }
+
+    free(window);
+    return true;
+}
+
+static unsigned char ClampByte(int value)
+{
+    return (unsigned char)((value < 0) ? 0 : (value > 255) ? 255 : value);
+}
+
+/* Scalar kernels */
+//----------------------------------------------------------------------------------
+static void FilterRowScalar(const unsigned char *row, unsigned char *out, const ResampleAxis *axis, int width, int channels)
+{
+    for (int x = 0; x < width; x++)
+    {
+        const unsigned char *pixel = row + (size_t)axis->first[x] * channels;
+        const int16_t *weights = axis->weights + (size_t)x * axis->taps;
+
+        for (int c = 0; c < channels; c++)
+        {
+            int sum = WEIGHT_ROUND;
+            for (int k = 0; k < axis->taps; k++) sum += weights[k] * pixel[k * channels + c];
+            out[x * channels + c] = ClampByte(sum >> WEIGHT_BITS);
+        }
+    }
+}
+
+static void FilterColumnRange(const unsigned char **rows, const int16_t *weights, int taps, unsigned char *out, int start, int end)
+{
+    for (int i = start; i < end; i++)
+    {
+        int sum = WEIGHT_ROUND;
+        for (int k = 0; k < taps; k++) sum += weights[k] * rows[k][i];
+        out[i] = ClampByte(sum >> WEIGHT_BITS);
+    }
+}
+
+static void FilterColumnsScalar(const unsigned char **rows, const int16_t *weights, int taps, unsigned char *out, int n_bytes)
+{
+    FilterColumnRange(rows, weights, taps, out, 0, n_bytes);
+}
+
+/* SIMD kernels */
+//----------------------------------------------------------------------------------
+#ifdef RESAMPLE_X86
+static __m128i LoadPixel(const unsigned char *pixel)
+{
+    int32_t value;
+    memcpy(&value, pixel, sizeof(value));       // 3-channel rows are padded, so the fourth byte is readable
+    return _mm_cvtsi32_si128(value);
+}
+
+static __m128i WeightPair(const int16_t *weights)
+{
+    return _mm_set1_epi32((int32_t)((uint32_t)(uint16_t)weights[0] | (uint32_t)(uint16_t)weights[1] << 16));
+}
+
+/* 3 or 4 channels: two taps' pixels interleaved as r0 r1 g0 g1 b0 b1 a0 a1, one madd for both. */
+static void FilterRowSSE2(const unsigned char *row, unsigned char *out, const ResampleAxis *axis, int width, int channels)
+{
+    if (channels < 3)
+    {
+        FilterRowScalar(row, out, axis, width, channels);
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    for (int x = 0; x < width; x++)
+    {
+        const unsigned char *pixel = row + (size_t)axis->first[x] * channels;
+        const int16_t *weights = axis->weights + (size_t)x * axis->taps;
+
+        __m128i sum = _mm_set1_epi32(WEIGHT_ROUND);
+        for (int k = 0; k < axis->taps; k += 2)
+        {
+            __m128i pair = _mm_unpacklo_epi8(_mm_unpacklo_epi8(LoadPixel(pixel + k * channels), LoadPixel(pixel + (k + 1) * channels)), zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, WeightPair(weights + k)));
+        }
+
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(_mm_srai_epi32(sum, WEIGHT_BITS), zero), zero);
+        int32_t bytes = _mm_cvtsi128_si32(packed);
+        memcpy(out + x * channels, &bytes, channels);
+    }
+}
+
+static void FilterColumnsSSE2(const unsigned char **rows, const int16_t *weights, int taps, unsigned char *out, int n_bytes)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+
+    for (; i + 16 <= n_bytes; i += 16)
+    {
+        __m128i sum0 = _mm_set1_epi32(WEIGHT_ROUND), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+        for (int k = 0; k < taps; k += 2)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(rows[k + 1] + i));
+            __m128i weight = WeightPair(weights + k);
+            __m128i lo = _mm_unpacklo_epi8(a, b), hi = _mm_unpackhi_epi8(a, b);    // a0 b0 a1 b1 ...
+
+            sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), weight));
+            sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), weight));
+            sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), weight));
+            sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), weight));
+        }
+
+        __m128i lo = _mm_packs_epi32(_mm_srai_epi32(sum0, WEIGHT_BITS), _mm_srai_epi32(sum1, WEIGHT_BITS));
+        __m128i hi = _mm_packs_epi32(_mm_srai_epi32(sum2, WEIGHT_BITS), _mm_srai_epi32(sum3, WEIGHT_BITS));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(lo, hi));
+    }
+
+    FilterColumnRange(rows, weights, taps, out, i, n_bytes);
+}
+
+/* Same as FilterColumnsSSE2() on 32 bytes. The unpacks and packs all stay within 128-bit lanes, so the bytes come back in order. */
+__attribute__((target("avx2")))
+static void FilterColumnsAVX2(const unsigned char **rows, const int16_t *weights, int taps, unsigned char *out, int n_bytes)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 32 <= n_bytes; i += 32)
+    {
+        __m256i sum0 = _mm256_set1_epi32(WEIGHT_ROUND), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+        for (int k = 0; k < taps; k += 2)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(rows[k] + i));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(rows[k + 1] + i));
+            __m256i weight = _mm256_set1_epi32((int32_t)((uint32_t)(uint16_t)weights[k] | (uint32_t)(uint16_t)weights[k + 1] << 16));
+            __m256i lo = _mm256_unpacklo_epi8(a, b), hi = _mm256_unpackhi_epi8(a, b);
+
+            sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), weight));
+            sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), weight));
+            sum2 = _mm256_add_epi32(sum2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), weight));
+            sum3 = _mm256_add_epi32(sum3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), weight));
+        }
+
+        __m256i lo = _mm256_packs_epi32(_mm256_srai_epi32(sum0, WEIGHT_BITS), _mm256_srai_epi32(sum1, WEIGHT_BITS));
+        __m256i hi = _mm256_packs_epi32(_mm256_srai_epi32(sum2, WEIGHT_BITS), _mm256_srai_epi32(sum3, WEIGHT_BITS));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_packus_epi16(lo, hi));
+    }
+
+    FilterColumnRange(rows, weights, taps, out, i, n_bytes);
+}
+#endif
+
+/* Bands */
+//----------------------------------------------------------------------------------
+/* Rows first: each source row the band's windows reach is filtered to the output width, then the columns of those. */
+static bool ResampleRowsFirst(ResampleBand *band)
+{
+    const ResampleAxis *vertical = band->vertical;
+    int channels = band->channels, row_bytes = band->width * channels;
+
+    int low = vertical->first[band->start], high = vertical->first[band->end - 1] + vertical->taps;
+    if (high > band->source_height) high = band->source_height;
+
+    // Source rows are copied into a padded row first: windows may run past the edge (with 0 weights) and the SSE2 kernel reads 4 bytes per pixel.
+    size_t source_stride = (size_t)band->source_width * channels;
+    unsigned char *padded = calloc(source_stride + ((size_t)band->horizontal->taps + 1) * channels, 1);
+    unsigned char *filtered = malloc((size_t)(high - low) * row_bytes);
+    const unsigned char **rows = malloc(vertical->taps * sizeof(unsigned char *));
+    bool ok = (padded != NULL && filtered != NULL && rows != NULL);
+
+    for (int y = low; y < high && ok; y++)
+    {
+        memcpy(padded, band->source + y * source_stride, source_stride);
+        band->filter_row(padded, filtered + (size_t)(y - low) * row_bytes, band->horizontal, band->width, channels);
+    }
+
+    for (int y = band->start; y < band->end && ok; y++)
+    {
+        for (int k = 0; k < vertical->taps; k++)
+        {
+            int source = vertical->first[y] + k;
+            if (source > high - 1) source = high - 1;           // Past the last row: weight 0
+            rows[k] = filtered + (size_t)(source - low) * row_bytes;
+        }
+        band->filter_column(rows, vertical->weights + (size_t)y * vertical->taps, vertical->taps, band->destination + (size_t)y * row_bytes, row_bytes);
+    }
+
+    free(rows);
+    free(filtered);
+    free(padded);
+    return ok;
+}
+
+/* Columns first: each output row is filtered from the source rows at full width, then to the output width. */
+static bool ResampleColumnsFirst(ResampleBand *band)
+{
+    const ResampleAxis *vertical = band->vertical;
+    int channels = band->channels, row_bytes = band->width * channels;
+
+    size_t source_stride = (size_t)band->source_width * channels;
+    unsigned char *padded = calloc(source_stride + ((size_t)band->horizontal->taps + 1) * channels, 1);
+    const unsigned char **rows = malloc(vertical->taps * sizeof(unsigned char *));
+    bool ok = (padded != NULL && rows != NULL);
+
+    for (int y = band->start; y < band->end && ok; y++)
+    {
+        for (int k = 0; k < vertical->taps; k++)
+        {
+            int source = vertical->first[y] + k;
+            if (source > band->source_height - 1) source = band->source_height - 1;
+            rows[k] = band->source + source * source_stride;
+        }
+        band->filter_column(rows, vertical->weights + (size_t)y * vertical->taps, vertical->taps, padded, (int)source_stride);
+        band->filter_row(padded, band->destination + (size_t)y * row_bytes, band->horizontal, band->width, channels);
+    }
+
+    free(rows);
+    free(padded);
+    return ok;
+}
+
+static void ResampleRows(ResampleBand *band)
+{
+    band->ok = band->columns_first ? ResampleColumnsFirst(band) : ResampleRowsFirst(band);
+}
+
+static void *ResampleThread(void *arg)
+{
+    ResampleRows(arg);
+    return NULL;
+}
+
+static int GetChannelCount(int format)
+{
+    switch (format)
+    {
+        case PIXELFORMAT_UNCOMPRESSED_GRAYSCALE: return 1;
+        case PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA: return 2;
+        case PIXELFORMAT_UNCOMPRESSED_R8G8B8: return 3;
+        case PIXELFORMAT_UNCOMPRESSED_R8G8B8A8: return 4;
+        default: return 0;
+    }
+}
+
+/* Module functions */
+//----------------------------------------------------------------------------------
+const char *GetResampleFilterName(ResampleFilter filter)
+{
+    return (filter >= 0 && filter < N_FILTERS) ? filters[filter].name : "unknown";
+}
+
+bool ResampleImage(Image *image, int width, int height, ResampleOptions options)
+{
+    int channels = GetChannelCount(image->format);
+    if (channels == 0 || image->data == NULL || image->mipmaps > 1 || width <= 0 || height <= 0) return false;
+    if (options.filter < 0 || options.filter >= N_FILTERS) return false;
+
+    ResampleAxis horizontal = { 0 }, vertical = { 0 };
+    unsigned char *destination = RL_MALLOC((size_t)width * height * channels);
+    bool ok = (destination != NULL) && LoadAxis(&horizontal, image->width, width, options.filter) && LoadAxis(&vertical, image->height, height, options.filter);
+
+    HorizontalKernel filter_row = FilterRowScalar;
+    VerticalKernel filter_column = FilterColumnsScalar;
+#ifdef RESAMPLE_X86
+    if (!options.scalar)
+    {
+        __builtin_cpu_init();
+        filter_row = FilterRowSSE2;
+        filter_column = __builtin_cpu_supports("avx2") ? FilterColumnsAVX2 : FilterColumnsSSE2;
+    }
+#endif
+
+    // Byte-taps of each order; the same choice with or without SIMD, so the results match.
+    int64_t row_taps = (int64_t)width * channels * horizontal.taps * ROW_PASS_COST, column_taps = (int64_t)vertical.taps * channels;
+    bool columns_first = ok && (int64_t)height * (image->width * column_taps + row_taps) < (int64_t)image->height * row_taps + (int64_t)height * width * column_taps;
+
+    // As many bands as threads asked for, as long as each gets enough work.
+    int64_t n_pixels = (int64_t)image->width * image->height;
+    int n_bands = (options.threads < 1) ? 1 : (options.threads > RESAMPLE_MAX_THREADS) ? RESAMPLE_MAX_THREADS : options.threads;
+    while (n_bands > 1 && (n_pixels / n_bands < MIN_PIXELS_PER_BAND || height / n_bands < 1)) n_bands--;
+
+    ResampleBand bands[RESAMPLE_MAX_THREADS];
+    pthread_t threads[RESAMPLE_MAX_THREADS];
+    bool started[RESAMPLE_MAX_THREADS] = { 0 };
+
+    for (int i = 0; i < n_bands && ok; i++)
+    {
+        bands[i] = (ResampleBand){
+            image->data, image->width, image->height, channels, destination, width, &horizontal, &vertical,
+            filter_row, filter_column, (int)((int64_t)height * i / n_bands), (int)((int64_t)height * (i + 1) / n_bands), columns_first, false
+        };
+        if (i > 0) started[i] = (pthread_create(&threads[i], NULL, ResampleThread, &bands[i]) == 0);
+    }
+
+    // The calling thread takes band 0 and any band whose thread didn't start.
+    for (int i = 0; i < n_bands && ok; i++)
+    {
+        if (!started[i]) ResampleRows(&bands[i]);
+    }
+    for (int i = 0; i < n_bands && ok; i++)
+    {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < n_bands && ok; i++) ok = bands[i].ok;
+
+    UnloadAxis(&horizontal);
+    UnloadAxis(&vertical);
+
+    if (!ok)
+    {
+        RL_FREE(destination);
+        return false;
+    }
+
+    RL_FREE(image->data);
+    image->data = destination;
+    image->width = width;
+    image->height = height;
+    return true;
+}
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "raylib.h"
+#include "id3v2.h"
+#include "track_loader.h"
+#include "tag_bench.h"
+
+/*
+ * Tag reading benchmark.
+ * -----------------------------------------------------------
+ * Runs without a window, so times come from timespec_get(). Each pass reads
+ * every file once with one reader: InitializeMusicInfo() (TagLib, as the
+ * track loader did for every file) or OpenId3v2Tag(), each keeping the
+ * cover where it read it. The first pass only warms the page cache, so the
+ * times are those of files already in memory, where the parsing is all
+ * there is to compare. The loader row is what a load costs now: the
+ * reader's time, plus TagLib's for the files it leaves to TagLib. Strings go
+ * into one arena, reset after every file, as in the loader.
+ *
+ * Strings, year and cover bytes must be the same from both readers for
+ * every file the ID3v2 reader takes; the first TAG_BENCH_REPORTED that
+ * aren't are listed.
+ *
+ * The check runs the same comparison over fixtures (tests/tags, written by
+ * make_fixtures.py there) sorted by who must read them: the reader must
+ * take every file under id3v2/ and leave every one under taglib/, whose
+ * tags lack a field or use what the reader doesn't handle.
+ * -----------------------------------------------------------
+ */
+
+typedef struct
+{
+    double taglib_seconds;
+    double id3_seconds;
+    bool id3;                   // Taken by the ID3v2 reader
+} TagTimes;
+
+static double Now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double ReadWithTagLib(const char *file_path, Arena *arena)
+{
+    double start = Now();
+    MusicInfo info = { 0 };
+    CoverPicture cover = { 0 };
+    InitializeMusicInfo(file_path, &info, &cover, arena);
+    UnloadCoverPicture(&cover);
+    ResetArena(arena);
+    return Now() - start;
+}
+
+static double ReadWithId3v2(const char *file_path, bool *taken, Arena *arena)
+{
+    double start = Now();
+    Id3v2Tag tag;
+    *taken = OpenId3v2Tag(file_path, &tag, arena);
+    if (*taken) CloseId3v2Tag(&tag);
+    ResetArena(arena);
+    return Now() - start;
+}
+
+static const char *SafeString(const char *text)
+{
+    return (text != NULL) ? text : "";
+}
+
+/* Both readers' strings, year and cover for one file; false and a line on stdout if they differ. */
+static bool CompareReaders(const char *file_path, bool report, Arena *arena)
+{
+    Id3v2Tag tag;
+    if (!OpenId3v2Tag(file_path, &tag, arena)) return true;
+
+    MusicInfo info = { 0 };
+    CoverPicture cover = { 0 };
+    InitializeMusicInfo(file_path, &info, &cover, arena);
+
+    const char *field = NULL;
+    if (strcmp(SafeString(info.title), tag.title) != 0) field = "title";
+    else if (strcmp(SafeString(info.artist), tag.artist) != 0) field = "artist";
+    else if (strcmp(SafeString(info.album), tag.album) != 0) field = "album";
+    else if (strcmp(SafeString(info.genre), tag.genre) != 0) field = "genre";
+    else if (info.year != tag.year) field = "year";
+    else if ((size_t)cover.size != tag.picture_size || (cover.size > 0 && memcmp(cover.data, tag.picture, cover.size) != 0)) field = "cover";
+
+    if (field != NULL && report) printf("mismatch: %s (%s)\n", file_path, field);
+
+    UnloadCoverPicture(&cover);
+    CloseId3v2Tag(&tag);
+    ResetArena(arena);
+    return field == NULL;
+}
+
+int RunTagBenchmark(int n_paths, const char **paths)
+{
+    // Every MP3 given, or found under a directory given
+    int n_files = 0, capacity = 0;
+    char **files = NULL;
+    for (int i = 0; i < n_paths; i++)
+    {
+        FilePathList found = { 0 };
+        bool directory = DirectoryExists(paths[i]);
+        if (directory) found = LoadDirectoryFilesEx(paths[i], ".mp3", true);
+
+        int count = directory ? (int)found.count : 1;
+        for (int f = 0; f < count; f++)
+        {
+            const char *path = directory ? found.paths[f] : paths[i];
+            if (!IsFileExtension(path, ".mp3")) continue;
+
+            if (n_files == capacity)
+            {
+                capacity = (capacity == 0) ? 256 : capacity * 2;
+                char **grown = realloc(files, capacity * sizeof(char *));
+                if (grown == NULL) break;
+                files = grown;
+            }
+            files[n_files] = malloc(strlen(path) + 1);
+            if (files[n_files] != NULL) strcpy(files[n_files++], path);
+        }
+
+        if (directory) UnloadDirectoryFiles(found);
+    }
+
+    if (n_files == 0)
+    {
+        printf("No MP3 files found\n");
+        free(files);
+        return EXIT_FAILURE;
+    }
+
+    TagTimes *times = calloc(n_files, sizeof(TagTimes));
+    if (times == NULL)
+    {
+        for (int f = 0; f < n_files; f++) free(files[f]);
+        free(files);
+        return EXIT_FAILURE;
+    }
+
+    Arena arena;
+    InitArena(&arena, TRACK_ARENA_SIZE);
+
+    // Warm-up pass, then the best of TAG_BENCH_RUNS per file and reader
+    for (int f = 0; f < n_files; f++) ReadWithTagLib(files[f], &arena);
+    for (int f = 0; f < n_files; f++)
+    {
+        times[f].taglib_seconds = INFINITY;
+        times[f].id3_seconds = INFINITY;
+    }
+    for (int run = 0; run < TAG_BENCH_RUNS; run++)
+    {
+        for (int f = 0; f < n_files; f++)
+        {
+            double seconds = ReadWithTagLib(files[f], &arena);
+            if (seconds < times[f].taglib_seconds) times[f].taglib_seconds = seconds;
+        }
+        for (int f = 0; f < n_files; f++)
+        {
+            double seconds = ReadWithId3v2(files[f], &times[f].id3, &arena);
+            if (seconds < times[f].id3_seconds) times[f].id3_seconds = seconds;
+        }
+    }
+
+    double taglib_total = 0.0, taken_taglib = 0.0, taken_id3 = 0.0, loader_total = 0.0;
+    int n_taken = 0, mismatches = 0;
+    for (int f = 0; f < n_files; f++)
+    {
+        taglib_total += times[f].taglib_seconds;
+        loader_total += times[f].id3_seconds + (times[f].id3 ? 0.0 : times[f].taglib_seconds);
+        if (times[f].id3)
+        {
+            n_taken++;
+            taken_taglib += times[f].taglib_seconds;
+            taken_id3 += times[f].id3_seconds;
+            if (!CompareReaders(files[f], mismatches < TAG_BENCH_REPORTED, &arena)) mismatches++;
+        }
+    }
+
+    printf("files: %d MP3, %d read by the ID3v2 reader, %d left to TagLib, %d mismatching\n", n_files, n_taken, n_files - n_taken, mismatches);
+    printf("%-34s %10s %12s\n", "reader", "total ms", "per file us");
+    printf("%-34s %10.2f %12.1f\n", "TagLib", taglib_total * 1000.0, taglib_total / n_files * 1e6);
+    printf("%-34s %10.2f %12.1f\n", "loader (ID3v2 reader, else TagLib)", loader_total * 1000.0, loader_total / n_files * 1e6);
+    if (n_taken > 0)
+    {
+        printf("%-34s %10.2f %12.1f\n", "TagLib, files the reader takes", taken_taglib * 1000.0, taken_taglib / n_taken * 1e6);
+        printf("%-34s %10.2f %12.1f\n", "ID3v2 reader, same files", taken_id3 * 1000.0, taken_id3 / n_taken * 1e6);
+    }
+
+    FreeArena(&arena);
+    for (int f = 0; f < n_files; f++) free(files[f]);
+    free(files);
+    free(times);
+
+    return (mismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Every MP3 under root/folder must be taken by the ID3v2 reader (or left to TagLib) and read as TagLib does; returns how many aren't. */
+static int CheckTagFixtures(const char *root, const char *folder, bool id3, Arena *arena)
+{
+    const char *path = TextFormat("%s/%s", root, folder);
+    if (!DirectoryExists(path))
+    {
+        printf("FAIL %s: no such folder\n", path);
+        return 1;
+    }
+
+    FilePathList files = LoadDirectoryFilesEx(path, ".mp3", true);
+    int failures = 0;
+    for (unsigned int f = 0; f < files.count; f++)
+    {
+        Id3v2Tag tag;
+        bool taken = OpenId3v2Tag(files.paths[f], &tag, arena);
+        if (taken) CloseId3v2Tag(&tag);
+        ResetArena(arena);
+
+        if (taken != id3)
+        {
+            printf("FAIL %s: %s\n", files.paths[f], taken ? "read by the ID3v2 reader" : "left to TagLib");
+            failures++;
+        }
+        else if (!CompareReaders(files.paths[f], true, arena)) failures++;
+        else printf("ok   %s (%s)\n", files.paths[f], taken ? "ID3v2 reader" : "TagLib");
+    }
+    if (files.count == 0)
+    {
+        printf("FAIL %s: no MP3 files\n", path);
+        failures++;
+    }
+
+    UnloadDirectoryFiles(files);
+    return failures;
+}
+
+int RunTagCheck(const char *fixtures)
+{
+    Arena arena;
+    InitArena(&arena, TRACK_ARENA_SIZE);
+
+    int failures = CheckTagFixtures(fixtures, "id3v2", true, &arena);
+    failures += CheckTagFixtures(fixtures, "taglib", false, &arena);
+    printf("%s: %d failed\n", (failures == 0) ? "passed" : "FAILED", failures);
+
+    FreeArena(&arena);
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
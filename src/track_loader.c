@@ -0,0 +1,692 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "raylib.h"
+#include "tag_c.h"
+#include "kmeans.h"
+#include "palette.h"
+#include "palette_cache.h"
+#include "jpeg_scaled.h"
+#include "track_loader.h"
+#include "alloc_probe.h"
+
+/*
+ * Track loader.
+ * -----------------------------------------------------------
+ * Loading a dropped file used to freeze a frame: TagLib parsing, JPEG decode,
+ * ImageResize, 40,000 GetImageColor calls and a 50-iteration k-means all ran
+ * before the next BeginDrawing(). Each request is now a job that a worker
+ * thread takes through three stages:
+ *
+ *   1. open the music stream (or map the file, for WAV captures) and index
+ *      the MP3 frames for seeking,
+ *   2. read the tags and the embedded picture, left where it was read (the
+ *      mapped ID3v2 tag of an MP3, else TagLib's buffer) with the decoder
+ *      its magic bytes (or MIME type) call for,
+ *   3. look the cover up in the palette cache; on a miss, decode it (baseline
+ *      JPEGs at 1/8 to full scale, whichever still covers ALBUM_COVER_SIZE),
+ *      extract the color palette, resample it to ALBUM_COVER_SIZE (bicubic,
+ *      SIMD, in bands over COVER_RESAMPLE_THREADS) and store both. Tracks
+ *      without a picture raylib can decode share the default cover, decoded
+ *      once when the loader starts, and its palettes, extracted once per
+ *      backend,
+ *
+ * and then pushes onto the completion queue. The render thread keeps drawing
+ * (and the old track keeps playing) until it polls the finished job.
+ *
+ * The path and tags are copied into an arena that goes with the track, the
+ * color planes, histograms and k-means buffers come from the worker's
+ * scratch arena, and both are reset in one step instead of being freed
+ * field by field. Polled jobs and released track arenas are kept for the
+ * next requests, so once a few tracks have been loaded our own code no
+ * longer calls malloc() per load; what remains is inside raylib, TagLib and
+ * the image decoders, plus the stream's Mp3Index or WavSource, which the
+ * feeder keeps after the track is gone.
+ * -----------------------------------------------------------
+ */
+
+typedef struct TrackJob
+{
+    LoadedTrack track;
+    ArenaStats arena_start;         // Of the track's arena when it was handed out, for GetTrackLoaderStats()
+    struct TrackJob *next;
+} TrackJob;
+
+typedef struct
+{
+    TrackJob *head;
+    TrackJob *tail;
+} TrackJobQueue;
+
+static struct
+{
+    pthread_t workers[TRACK_LOADER_WORKERS];
+    int n_workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work;            // Signalled when a job is queued or on shutdown
+    pthread_mutex_t taglib_lock;    // TagLib's C string bookkeeping is global
+    pthread_mutex_t default_lock;   // Guards the default cover's palettes
+
+    TrackJobQueue pending;
+    TrackJobQueue completed;
+    TrackJobQueue spare;            // Handed back by PollLoadedTrack(), for RequestTrackLoad() to reuse
+    Arena *spare_arenas[TRACK_ARENA_SPARES];
+    int n_spare_arenas;
+    unsigned int next_id;
+    _Atomic bool running;           // Written under lock; ReleaseTrackArena() reads it without, as lock may be gone
+    TrackLoaderStats stats;
+
+    Image default_cover;            // As LoadCoverImage() decodes it; read-only once the workers run
+    Image default_thumbnail;        // ALBUM_COVER_SIZE copy handed to tracks
+    Color default_palettes[PALETTE_BACKEND_COUNT][PALETTE_SIZE];
+    bool default_extracted[PALETTE_BACKEND_COUNT];
+} loader;
+
+const char *default_music_cover = "../../assets/img/default_cover.jpg"; // Default music album cover.
+
+static void PushJob(TrackJobQueue *queue, TrackJob *job);
+static TrackJob *PopJob(TrackJobQueue *queue);
+static void *TrackLoaderThread(void *arg);
+static bool ReadMp3Info(const char *music_file_path, MusicInfo *music_info, CoverPicture *cover, Arena *arena);
+static const char *GetCoverFileType(const unsigned char *data, int size, const char *mime_type);
+static Image LoadCoverImage(const unsigned char *data, int size, const char *file_type);
+static void ResizeCover(Image *image);
+static bool LoadEmbeddedCover(const CoverPicture *cover, PaletteBackend backend, Color *palette, Image *album_cover, Arena *scratch);
+static void LoadDefaultCover(PaletteBackend backend, Color *palette, Image *album_cover, Arena *scratch);
+
+bool StartTrackLoader(void)
+{
+    memset(&loader, 0, sizeof(loader));
+    atomic_store(&loader.running, true);
+    loader.next_id = 1;
+
+    pthread_mutex_init(&loader.lock, NULL);
+    pthread_mutex_init(&loader.taglib_lock, NULL);
+    pthread_mutex_init(&loader.default_lock, NULL);
+    pthread_cond_init(&loader.work, NULL);
+
+    int default_size = 0;
+    unsigned char *default_data = LoadFileData(default_music_cover, &default_size);
+    loader.default_cover = LoadCoverImage(default_data, default_size, GetCoverFileType(default_data, default_size, NULL));
+    UnloadFileData(default_data);
+    if (IsImageReady(loader.default_cover))
+    {
+        loader.default_thumbnail = ImageCopy(loader.default_cover);
+        ResizeCover(&loader.default_thumbnail);
+    }
+    else TraceLog(LOG_WARNING, "LOADER: Unable to load default cover %s", default_music_cover);
+
+    char cache_directory[512];
+    snprintf(cache_directory, sizeof(cache_directory), "%s%s", GetApplicationDirectory(), PALETTE_CACHE_DIRECTORY);
+    OpenPaletteCache(cache_directory);      // Palettes are extracted every time without it
+
+    for (int i = 0; i < TRACK_LOADER_WORKERS; i++)
+    {
+        if (pthread_create(&loader.workers[loader.n_workers], NULL, TrackLoaderThread, NULL) != 0)
+        {
+            TraceLog(LOG_WARNING, "LOADER: Unable to create worker thread %d", i);
+            continue;
+        }
+        loader.n_workers++;
+    }
+
+    return loader.n_workers > 0;
+}
+
+void StopTrackLoader(void)
+{
+    pthread_mutex_lock(&loader.lock);
+    atomic_store(&loader.running, false);
+    pthread_cond_broadcast(&loader.work);
+    pthread_mutex_unlock(&loader.lock);
+
+    for (int i = 0; i < loader.n_workers; i++)
+    {
+        pthread_join(loader.workers[i], NULL);
+    }
+    loader.n_workers = 0;
+
+    // Release anything nobody picked up.
+    TrackJob *job;
+    while ((job = PopJob(&loader.pending)) != NULL || (job = PopJob(&loader.completed)) != NULL)
+    {
+        UnloadLoadedTrack(&job->track);
+        free(job);
+    }
+    while ((job = PopJob(&loader.spare)) != NULL) free(job);
+    for (int i = 0; i < loader.n_spare_arenas; i++)
+    {
+        FreeArena(loader.spare_arenas[i]);
+        free(loader.spare_arenas[i]);
+    }
+    loader.n_spare_arenas = 0;
+
+    ClosePaletteCache();
+    UnloadImage(loader.default_cover);
+    UnloadImage(loader.default_thumbnail);
+    pthread_cond_destroy(&loader.work);
+    pthread_mutex_destroy(&loader.default_lock);
+    pthread_mutex_destroy(&loader.taglib_lock);
+    pthread_mutex_destroy(&loader.lock);
+}
+
+unsigned int RequestTrackLoad(const char *file_path)
+{
+    pthread_mutex_lock(&loader.lock);
+    TrackJob *job = PopJob(&loader.spare);
+    Arena *arena = (loader.n_spare_arenas > 0) ? loader.spare_arenas[--loader.n_spare_arenas] : NULL;
+    pthread_mutex_unlock(&loader.lock);
+
+    // Only the first few requests find nothing to reuse.
+    int heap_allocations = 0;
+    if (job == NULL && (job = malloc(sizeof(TrackJob))) != NULL) heap_allocations++;
+    if (arena == NULL && (arena = malloc(sizeof(Arena))) != NULL)
+    {
+        InitArena(arena, TRACK_ARENA_SIZE);
+        heap_allocations++;
+    }
+    if (job == NULL || arena == NULL)
+    {
+        free(job);
+        ReleaseTrackArena(arena);
+        return 0;
+    }
+
+    memset(job, 0, sizeof(TrackJob));
+    job->arena_start = arena->stats;
+    job->track.arena = arena;
+    job->track.file_path = ArenaCopyString(arena, file_path);
+    if (job->track.file_path == NULL)
+    {
+        free(job);
+        ReleaseTrackArena(arena);
+        return 0;
+    }
+
+    pthread_mutex_lock(&loader.lock);
+    loader.stats.heap_allocations += heap_allocations;
+    job->track.id = loader.next_id++;
+    unsigned int id = job->track.id;
+    PushJob(&loader.pending, job);
+    pthread_cond_signal(&loader.work);
+    pthread_mutex_unlock(&loader.lock);
+
+    return id;
+}
+
+bool PollLoadedTrack(LoadedTrack *track)
+{
+    pthread_mutex_lock(&loader.lock);
+    TrackJob *job = PopJob(&loader.completed);
+    if (job != NULL)
+    {
+        *track = job->track;    // Ownership of the stream, arena and image moves to the caller.
+        PushJob(&loader.spare, job);
+    }
+    pthread_mutex_unlock(&loader.lock);
+
+    return job != NULL;
+}
+
+void UnloadLoadedTrack(LoadedTrack *track)
+{
+    if (track->wav != NULL)
+    {
+        CloseWavSource(track->wav);
+        free(track->wav);
+    }
+    else if (track->ok)
+    {
+        UnloadMusicStream(track->music);
+        if (track->mp3_index != NULL)
+        {
+            UnloadMp3Index(track->mp3_index);
+            free(track->mp3_index);
+        }
+    }
+    if (track->album_cover.data != NULL) UnloadImage(track->album_cover);
+    ReleaseTrackArena(track->arena);
+    memset(track, 0, sizeof(LoadedTrack));
+}
+
+/* Resets a track's arena and keeps it for a later request, unless TRACK_ARENA_SPARES are already waiting. */
+void ReleaseTrackArena(Arena *arena)
+{
+    if (arena == NULL) return;
+
+    ResetArena(arena);
+    bool kept = false;
+    if (atomic_load(&loader.running))      // After StopTrackLoader() there's no lock, and nothing to keep it for
+    {
+        pthread_mutex_lock(&loader.lock);
+        if (loader.n_spare_arenas < TRACK_ARENA_SPARES)
+        {
+            loader.spare_arenas[loader.n_spare_arenas++] = arena;
+            kept = true;
+        }
+        pthread_mutex_unlock(&loader.lock);
+    }
+
+    if (!kept)
+    {
+        FreeArena(arena);
+        free(arena);
+    }
+}
+
+TrackLoaderStats GetTrackLoaderStats(void)
+{
+    pthread_mutex_lock(&loader.lock);
+    TrackLoaderStats stats = loader.stats;
+    pthread_mutex_unlock(&loader.lock);
+    return stats;
+}
+
+static void PushJob(TrackJobQueue *queue, TrackJob *job)
+{
+    job->next = NULL;
+    if (queue->tail != NULL) queue->tail->next = job;
+    else queue->head = job;
+    queue->tail = job;
+}
+
+static TrackJob *PopJob(TrackJobQueue *queue)
+{
+    TrackJob *job = queue->head;
+    if (job != NULL)
+    {
+        queue->head = job->next;
+        if (queue->head == NULL) queue->tail = NULL;
+        job->next = NULL;
+    }
+    return job;
+}
+
+static void *TrackLoaderThread(void *arg)
+{
+    (void)arg;
+    RegisterAllocThread("loader", false);
+    Arena scratch;      // Cover planes and palette working memory, reset after every job
+    InitArena(&scratch, TRACK_SCRATCH_SIZE);
+
+    pthread_mutex_lock(&loader.lock);
+    while (true)
+    {
+        while (loader.running && loader.pending.head == NULL)
+        {
+            pthread_cond_wait(&loader.work, &loader.lock);
+        }
+        if (!loader.running) break;
+
+        TrackJob *job = PopJob(&loader.pending);
+        pthread_mutex_unlock(&loader.lock);
+
+        LoadedTrack *track = &job->track;
+        ArenaStats scratch_start = scratch.stats;
+
+        /* Stage 1: music stream */
+        //----------------------------------------------------------------------------------
+        if (HasFileExtension(track->file_path, ".wav"))
+        {
+            track->wav = malloc(sizeof(WavSource));
+            track->ok = (track->wav != NULL) && OpenWavSource(track->file_path, track->wav);  // Mapped, nothing decoded
+
+            if (track->ok)
+            {
+                track->sample_rate = track->wav->sample_rate;
+                track->sample_size = track->wav->bits_per_sample;
+                track->durations = (float)((double)track->wav->frame_count / track->wav->sample_rate);
+            }
+            else
+            {
+                free(track->wav);
+                track->wav = NULL;
+            }
+        }
+        else
+        {
+            track->music = LoadMusicStream(track->file_path); // Load music stream from file
+            track->ok = IsMusicReady(track->music);           // Checks if the music stream is ready
+
+            if (track->ok)
+            {
+                track->sample_rate = track->music.stream.sampleRate;
+                track->sample_size = track->music.stream.sampleSize;
+                track->durations = GetMusicTimeLength(track->music);
+            }
+
+            if (track->ok && HasFileExtension(track->file_path, ".mp3"))
+            {
+                // Without a seek table, dr_mp3 seeks by decoding from the start of the file.
+                track->mp3_index = malloc(sizeof(Mp3Index));
+                if (track->mp3_index != NULL && !(BuildMp3Index(track->file_path, track->mp3_index) && BindMp3Index(track->music, track->mp3_index)))
+                {
+                    UnloadMp3Index(track->mp3_index);
+                    free(track->mp3_index);
+                    track->mp3_index = NULL;
+                }
+            }
+        }
+
+        if (track->ok)
+        {
+            /* Stage 2: tags and album cover */
+            //----------------------------------------------------------------------------------
+            CoverPicture cover;
+            ReadTrackTags(track->file_path, &track->music_info, &cover, track->arena);
+
+            /* Stage 3: color palette, unless this cover was seen before */
+            //----------------------------------------------------------------------------------
+            LoadTrackCover(&cover, GetPaletteBackend(), track->palette, &track->album_cover, &scratch);
+            UnloadCoverPicture(&cover);
+        }
+
+        /* What the load took from the arenas, and how much of it from the heap */
+        //----------------------------------------------------------------------------------
+        const ArenaStats *strings = &track->arena->stats;
+        int64_t allocations = (strings->allocations - job->arena_start.allocations) + (scratch.stats.allocations - scratch_start.allocations);
+        int64_t heap_allocations = (strings->heap_blocks - job->arena_start.heap_blocks) + (scratch.stats.heap_blocks - scratch_start.heap_blocks);
+        size_t scratch_used = scratch.stats.used;
+        ResetArena(&scratch);
+        TraceLog(LOG_DEBUG, "LOADER: %s: %lld arena allocations, %lld from the heap, %zu KB of scratch", track->file_path,
+                 (long long)allocations, (long long)heap_allocations, scratch_used / 1024);
+
+        pthread_mutex_lock(&loader.lock);
+        loader.stats.loads++;
+        loader.stats.arena_allocations += allocations;
+        loader.stats.heap_allocations += heap_allocations;
+        if (scratch_used > loader.stats.scratch_peak) loader.stats.scratch_peak = scratch_used;
+        PushJob(&loader.completed, job);
+    }
+    pthread_mutex_unlock(&loader.lock);
+
+    FreeArena(&scratch);
+    return NULL;
+}
+
+/* Tags and picture: MP3s through the ID3v2 reader, anything it leaves through TagLib, one thread at a time. */
+void ReadTrackTags(const char *music_file_path, MusicInfo *music_info, CoverPicture *cover, Arena *arena)
+{
+    if (ReadMp3Info(music_file_path, music_info, cover, arena)) return;     // No TagLib, so no lock
+
+    pthread_mutex_lock(&loader.taglib_lock);
+    InitializeMusicInfo(music_file_path, music_info, cover, arena);
+    pthread_mutex_unlock(&loader.taglib_lock);
+}
+
+/*
+ * Palette and ALBUM_COVER_SIZE thumbnail of a track's cover, or of the
+ * default cover when it has none raylib can decode. With album_cover NULL
+ * (the library indexer) only the palette is wanted: a cache hit doesn't
+ * read the thumbnail and a miss stores nothing, so indexing a library
+ * doesn't push the covers in rotation out of the cache.
+ * Returns the cover's palette cache key, 0 for the default cover.
+ */
+uint64_t LoadTrackCover(const CoverPicture *cover, PaletteBackend backend, Color *palette, Image *album_cover, Arena *scratch)
+{
+    if (LoadEmbeddedCover(cover, backend, palette, album_cover, scratch)) return HashCoverData(cover->data, cover->size);
+
+    LoadDefaultCover(backend, palette, album_cover, scratch);
+    return 0;
+}
+
+void InitializeMusicInfo(const char *music_file_path, MusicInfo *music_info, CoverPicture *cover, Arena *arena)
+{
+    taglib_set_strings_unicode(1);
+    TagLib_File *file;
+    TagLib_Tag *tag;
+    memset(cover, 0, sizeof(CoverPicture));
+
+    file = taglib_file_new(music_file_path);
+
+    if (file == NULL)
+    {
+        printf("Unable to create file!\n");
+    }
+    else
+    {
+        tag = taglib_file_tag(file);
+        if (tag != NULL)
+        {
+            char *title  = taglib_tag_title(tag);
+            char *artist = taglib_tag_artist(tag);
+            char *album  = taglib_tag_album(tag);
+            char *genre  = taglib_tag_genre(tag);
+
+            /* Set the music file's basic information to the music_info struct, copied into the track's arena. */
+            music_info->title  = ArenaCopyString(arena, title);
+            music_info->artist = ArenaCopyString(arena, artist);
+            music_info->album  = ArenaCopyString(arena, album);
+            music_info->genre  = ArenaCopyString(arena, genre);
+            music_info->year   = taglib_tag_year(tag);
+        }
+
+        /* Extract album picture */
+        TagLib_Complex_Property_Attribute ***properties = taglib_complex_property_get(file, "PICTURE");
+        TagLib_Complex_Property_Picture_Data picture;
+        taglib_picture_from_complex_property(properties, &picture);
+
+        /*
+         * Keep the encoded album cover photo where TagLib put it, the properties
+         * with it: its hash is the palette cache key and it is decoded from there.
+         * They are plain allocations, not TagLib's global strings, so they are
+         * released after the lock is dropped.
+         */
+        if (picture.data != NULL && picture.size > 0 && picture.size <= INT_MAX)
+        {
+            cover->data = (const unsigned char *)picture.data;
+            cover->size = (int)picture.size;
+            cover->file_type = GetCoverFileType(cover->data, cover->size, picture.mimeType);
+            cover->properties = properties;
+        }
+        else taglib_complex_property_free(properties);
+
+        // free
+        taglib_tag_free_strings();
+        taglib_file_free(file);
+    }
+}
+
+void UnloadCoverPicture(CoverPicture *cover)
+{
+    if (cover->properties != NULL) taglib_complex_property_free(cover->properties);
+    CloseId3v2Tag(&cover->id3);
+    memset(cover, 0, sizeof(CoverPicture));
+}
+
+/*
+ * The ID3v2 tag of an MP3, read from a mapping of the tag alone (id3v2.c):
+ * the strings, decoded into arena, move to music_info and the picture stays
+ * in the mapping. False for TagLib to read the file instead.
+ */
+static bool ReadMp3Info(const char *music_file_path, MusicInfo *music_info, CoverPicture *cover, Arena *arena)
+{
+    memset(cover, 0, sizeof(CoverPicture));
+    if (!HasFileExtension(music_file_path, ".mp3") || !OpenId3v2Tag(music_file_path, &cover->id3, arena)) return false;
+
+    Id3v2Tag *tag = &cover->id3;
+    music_info->title = tag->title;
+    music_info->artist = tag->artist;
+    music_info->album = tag->album;
+    music_info->genre = tag->genre;
+    music_info->year = tag->year;
+    tag->title = tag->artist = tag->album = tag->genre = NULL;
+
+    if (tag->picture != NULL && tag->picture_size <= INT_MAX)
+    {
+        cover->data = tag->picture;
+        cover->size = (int)tag->picture_size;
+        cover->file_type = GetCoverFileType(cover->data, cover->size, tag->picture_mime);
+    }
+
+    return true;
+}
+
+/*
+ * Picks the decoder for a picture by its magic bytes: taggers label PNGs
+ * image/jpeg often enough that the MIME type only decides for formats
+ * without a signature (TGA). NULL if raylib can't decode it either way.
+ */
+static const char *GetCoverFileType(const unsigned char *data, int size, const char *mime_type)
+{
+    static const struct { const char *magic; int length; const char *file_type; } signatures[] = {
+        { "\xFF\xD8\xFF", 3, ".jpg" },
+        { "\x89PNG\r\n\x1A\n", 8, ".png" },
+        { "GIF87a", 6, ".gif" },
+        { "GIF89a", 6, ".gif" },
+        { "qoif", 4, ".qoi" },
+        { "BM", 2, ".bmp" },
+    };
+    static const struct { const char *mime_type; const char *file_type; } mime_types[] = {
+        { "image/jpeg", ".jpg" },
+        { "image/jpg", ".jpg" },
+        { "image/png", ".png" },
+        { "image/gif", ".gif" },
+        { "image/qoi", ".qoi" },
+        { "image/bmp", ".bmp" },
+        { "image/x-ms-bmp", ".bmp" },
+        { "image/tga", ".tga" },
+        { "image/x-tga", ".tga" },
+        { "image/x-targa", ".tga" },
+    };
+
+    if (data == NULL || size <= 0) return NULL;
+
+    for (size_t i = 0; i < sizeof(signatures) / sizeof(signatures[0]); i++)
+    {
+        if (size >= signatures[i].length && memcmp(data, signatures[i].magic, signatures[i].length) == 0) return signatures[i].file_type;
+    }
+
+    if (mime_type == NULL) return NULL;
+
+    for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++)
+    {
+        const char *a = mime_types[i].mime_type, *b = mime_type;
+        while (*a != '\0' && *a == tolower((unsigned char)*b)) a++, b++;
+        if (*a == '\0' && *b == '\0') return mime_types[i].file_type;
+    }
+
+    return NULL;
+}
+
+/*
+ * Decodes an encoded cover with the decoder its file type names. The palette
+ * is taken before the resize: baseline JPEGs are decoded straight to no less
+ * than ALBUM_COVER_SIZE, anything else at full size.
+ */
+static Image LoadCoverImage(const unsigned char *data, int size, const char *file_type)
+{
+    Image image = { 0 };
+    if (file_type == NULL) return image;
+
+    if (IsJpegData(data, size)) image = LoadJpegScaled(data, size, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE);
+    if (!IsImageReady(image)) image = LoadImageFromMemory(file_type, data, size); // Load image from memory buffer, fileType refers to extension: i.e. '.png'
+    return image;
+}
+
+static void ResizeCover(Image *image)
+{
+    if (!ResampleImage(image, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE, COVER_RESAMPLE_OPTIONS))
+    {
+        ImageResize(image, ALBUM_COVER_SIZE, ALBUM_COVER_SIZE); // Formats the resampler doesn't take
+    }
+}
+
+/* The embedded picture's thumbnail and palette, from the cache or decoded; false if there is no picture or it can't be decoded. */
+static bool LoadEmbeddedCover(const CoverPicture *cover, PaletteBackend backend, Color *palette, Image *album_cover, Arena *scratch)
+{
+    if (cover->file_type == NULL) return false;
+
+    uint64_t cover_key = HashCoverData(cover->data, cover->size);
+    if ((album_cover != NULL) ? LoadCachedCover(cover_key, backend, palette, album_cover) : LoadCachedPalette(cover_key, backend, palette)) return true;
+
+    Image image = LoadCoverImage(cover->data, cover->size, cover->file_type);
+    if (!IsImageReady(image))
+    {
+        TraceLog(LOG_WARNING, "LOADER: Unable to decode a %s cover (%d bytes)", cover->file_type, cover->size);
+        return false;
+    }
+
+    ExtractPalette(image, backend, palette, scratch);
+    if (album_cover == NULL)
+    {
+        UnloadImage(image);
+        return true;
+    }
+
+    ResizeCover(&image);
+    StoreCachedCover(cover_key, backend, palette, image);
+    *album_cover = image;
+    return true;
+}
+
+/* A copy of the default cover's thumbnail and its palette, extracted the first time each backend asks for it. */
+static void LoadDefaultCover(PaletteBackend backend, Color *palette, Image *album_cover, Arena *scratch)
+{
+    if (!IsImageReady(loader.default_cover)) return;
+
+    pthread_mutex_lock(&loader.default_lock);
+    if (!loader.default_extracted[backend])
+    {
+        ExtractPalette(loader.default_cover, backend, loader.default_palettes[backend], scratch);
+        loader.default_extracted[backend] = true;
+    }
+    memcpy(palette, loader.default_palettes[backend], PALETTE_SIZE * sizeof(Color));
+    pthread_mutex_unlock(&loader.default_lock);
+
+    if (album_cover != NULL) *album_cover = ImageCopy(loader.default_thumbnail);
+}
+
+void ExtractPalette(Image album_cover, PaletteBackend backend, Color *palette, Arena *scratch)
+{
+    ColorPlanes color_data = { 0 };
+
+    if (LoadColorPlanes(album_cover, &color_data, scratch)) // Straight from the image buffer, one plane per channel
+    {
+
+        /*
+         * Extract Color pallete of size 4 in an image, with the backend chosen by
+         * --palette or F5 (k-means over the occupied bins of a color histogram
+         * by default: a decoded cover has up to millions of pixels but only a few
+         * thousand distinct colors at 5 bits per channel).
+         */
+        QuantizePalette(backend, color_data, palette, PALETTE_SIZE, scratch); // From palette.h
+    }
+
+    UnloadColorPlanes(&color_data);
+}
+
+/*
+ * IsFileExtension() goes through TextSplit() and TextToLower(), which share
+ * static buffers; this one only reads its arguments, so the workers can call
+ * it. extensions is a ';' separated list (".mp3;.wav"), matched in any case.
+ */
+bool HasFileExtension(const char *file_path, const char *extensions)
+{
+    const char *dot = strrchr(file_path, '.');
+    if (dot == NULL) return false;
+
+    size_t length = strlen(dot);
+    const char *extension = extensions;
+    while (*extension != '\0')
+    {
+        const char *separator = strchr(extension, ';');
+        size_t extension_length = (separator != NULL) ? (size_t)(separator - extension) : strlen(extension);
+
+        if (extension_length == length)
+        {
+            size_t i = 0;
+            while (i < length && tolower((unsigned char)dot[i]) == tolower((unsigned char)extension[i])) i++;
+            if (i == length) return true;
+        }
+
+        extension += extension_length;
+        if (*extension == ';') extension++;
+    }
+    return false;
+}
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "wav_source.h"
+
+/*
+ * WAV source.
+ * -----------------------------------------------------------
+ * Lab captures are multi-gigabyte uncompressed WAV files. Decoding them into
+ * a buffer first would cost as much memory as the file, so the file is mapped
+ * and the windowing stage (and the audio stream) read samples directly from
+ * the data chunk. RF64 is accepted for captures past the 4 GiB RIFF limit.
+ * -----------------------------------------------------------
+ * https://www.mmsp.ece.mcgill.ca/Documents/AudioFormats/WAVE/WAVE.html
+ * https://tech.ebu.ch/docs/tech/tech3306v1_1.pdf (RF64)
+ */
+
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint16_t ReadU16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadU32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t ReadU64(const unsigned char *p)
+{
+    return (uint64_t)ReadU32(p) | ((uint64_t)ReadU32(p + 4) << 32);
+}
+
+bool OpenWavSource(const char *file_path, WavSource *source)
+{
+    memset(source, 0, sizeof(WavSource));
+
+    if (!OpenMappedFile(file_path, &source->file)) return false;
+
+    const unsigned char *data = source->file.data;
+    size_t size = source->file.size;
+
+    if (size < 12 || (memcmp(data, "RIFF", 4) != 0 && memcmp(data, "RF64", 4) != 0) || memcmp(data + 8, "WAVE", 4) != 0)
+    {
+        CloseWavSource(source);
+        return false;
+    }
+
+    bool is_rf64 = (memcmp(data, "RF64", 4) == 0);
+    uint64_t rf64_data_size = 0;
+    bool has_format = false;
+    uint16_t format = 0;
+
+    // Walk the chunks: 4-byte id, 4-byte little-endian size, payload padded to an even size.
+    size_t offset = 12;
+    while (offset + 8 <= size)
+    {
+        const unsigned char *chunk = data + offset;
+        uint64_t chunk_size = ReadU32(chunk + 4);
+
+        if (memcmp(chunk, "ds64", 4) == 0 && chunk_size >= 16)
+        {
+            rf64_data_size = ReadU64(chunk + 16);
+        }
+        else if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16)
+        {
+            format = ReadU16(chunk + 8);
+            source->channels = ReadU16(chunk + 10);
+            source->sample_rate = ReadU32(chunk + 12);
+            source->bits_per_sample = ReadU16(chunk + 22);
+
+            if (format == WAVE_FORMAT_EXTENSIBLE && chunk_size >= 40)
+            {
+                format = ReadU16(chunk + 32);   // First two bytes of the sub-format GUID
+            }
+            has_format = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (is_rf64 && chunk_size == 0xFFFFFFFF) chunk_size = rf64_data_size;
+            if (chunk_size > size - offset - 8) chunk_size = size - offset - 8;   // Truncated capture: use what is there.
+
+            if (!has_format) break;
+
+            source->is_float = (format == WAVE_FORMAT_IEEE_FLOAT);
+            bool supported = (format == WAVE_FORMAT_PCM && (source->bits_per_sample == 8 || source->bits_per_sample == 16 ||
+                                                            source->bits_per_sample == 24 || source->bits_per_sample == 32)) ||
+                             (format == WAVE_FORMAT_IEEE_FLOAT && source->bits_per_sample == 32);
+            if (!supported || source->channels == 0 || source->sample_rate == 0) break;
+
+            source->frame_size = source->channels * (source->bits_per_sample / 8);
+            source->frames = chunk + 8;
+            source->frame_count = chunk_size / source->frame_size;
+            return source->frame_count > 0;
+        }
+
+        uint64_t next = offset + 8 + chunk_size + (chunk_size & 1);
+        if (next <= offset || next > size) break;
+        offset = (size_t)next;
+    }
+
+    printf("Unsupported or malformed WAV file: %s\n", file_path);
+    CloseWavSource(source);
+    return false;
+}
+
+void CloseWavSource(WavSource *source)
+{
+    CloseMappedFile(&source->file);
+    memset(source, 0, sizeof(WavSource));
+}
+
+/* One sample, normalized to [-1, 1). Frames outside the file read as silence. */
+float GetWavSample(const WavSource *source, uint64_t frame, unsigned int channel)
+{
+    if (frame >= source->frame_count || channel >= source->channels) return 0.0f;
+
+    const unsigned char *p = source->frames + frame * source->frame_size + channel * (source->bits_per_sample / 8);
+
+    switch (source->bits_per_sample)
+    {
+        case 8:  return ((int)p[0] - 128) / 128.0f;     // 8-bit WAV is unsigned
+        case 16: return (int16_t)ReadU16(p) / 32768.0f;
+        case 24: return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.0f;
+        case 32:
+            if (source->is_float)
+            {
+                float sample;
+                memcpy(&sample, p, sizeof(float));
+                return sample;
+            }
+            return (int32_t)ReadU32(p) / 2147483648.0f;
+        default: return 0.0f;
+    }
+}
+
+/* Pointer to a frame inside the mapping, for formats the audio stream takes as they are. */
+const void *GetWavFrames(const WavSource *source, uint64_t frame)
+{
+    if (frame >= source->frame_count) return NULL;
+    return source->frames + frame * source->frame_size;
+}
+
+/* Converts up to frame_count interleaved frames to float; returns the number converted. */
+size_t ConvertWavFrames(const WavSource *source, uint64_t frame, size_t frame_count, float *output)
+{
+    if (frame >= source->frame_count) return 0;
+    if (frame_count > source->frame_count - frame) frame_count = (size_t)(source->frame_count - frame);
+
+    for (size_t i = 0; i < frame_count; i++)
+    {
+        for (unsigned int c = 0; c < source->channels; c++)
+        {
+            output[i * source->channels + c] = GetWavSample(source, frame + i, c);
+        }
+    }
+    return frame_count;
+}
+
+/* Read-ahead hint for the frames about to be used. */
+void PrefetchWavFrames(const WavSource *source, uint64_t frame, uint64_t frame_count, bool sequential)
+{
+    if (frame >= source->frame_count) return;
+    if (frame_count > source->frame_count - frame) frame_count = source->frame_count - frame;
+
+    size_t offset = (size_t)(source->frames - source->file.data) + (size_t)(frame * source->frame_size);
+    size_t length = (size_t)(frame_count * source->frame_size);
+    AdviseMappedFile(&source->file, offset, length, sequential ? MAPPED_FILE_SEQUENTIAL : MAPPED_FILE_WILLNEED);
+}
+
+/*
+ * Keeps WAV_READ_AHEAD_FRAMES past frame paged in, a half window at a time,
+ * instead of the whole file: a long capture would push everything else out
+ * of the page cache. A jump back or past the window starts a new one.
+ */
+void UpdateWavReadAhead(const WavSource *source, WavReadAhead *window, uint64_t frame)
+{
+    if (frame < window->start || frame > window->end)
+    {
+        window->start = frame;
+        window->end = frame;
+    }
+    if (window->end >= source->frame_count || window->end - frame >= WAV_READ_AHEAD_FRAMES / 2) return;
+
+    uint64_t end = frame + WAV_READ_AHEAD_FRAMES;
+    if (end > source->frame_count) end = source->frame_count;
+    PrefetchWavFrames(source, window->end, end - window->end, false);
+    window->end = end;
+}
@@ -0,0 +1,27 @@
+# Writes the WAV fixture of `SonicSpectra --alloc-check tests/audio/tones.wav`,
+# which build_debug.bat runs after building: 4 s of 16-bit mono at 22050 Hz,
+# one tone per band of the spectrum, each fading in and out in turn.
+# Run from this folder: python make_fixtures.py
+
+import math
+import struct
+import wave
+
+SAMPLE_RATE = 22050
+SECONDS = 4
+BANDS = [30.0, 60.0, 120.0, 240.0, 480.0, 960.0, 1920.0, 3840.0, 7600.0]
+
+frames = bytearray()
+for n in range(SAMPLE_RATE * SECONDS):
+    t = n / SAMPLE_RATE
+    sample = 0.0
+    for i, frequency in enumerate(BANDS):
+        gain = 0.5 + 0.5 * math.cos(2.0 * math.pi * (t / SECONDS - i / len(BANDS)))
+        sample += gain * math.sin(2.0 * math.pi * frequency * t)
+    frames += struct.pack('<h', int(32767 * 0.8 * sample / len(BANDS)))
+
+with wave.open('tones.wav', 'wb') as f:
+    f.setnchannels(1)
+    f.setsampwidth(2)
+    f.setframerate(SAMPLE_RATE)
+    f.writeframes(bytes(frames))
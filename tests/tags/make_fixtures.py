@@ -0,0 +1,138 @@
+# Writes the MP3 fixtures of `SonicSpectra --check-tags tests/tags`:
+#   id3v2/   tags the built-in ID3v2 reader must read, the same way TagLib does
+#   taglib/  tags it must leave to TagLib
+# Each file is a tag followed by a few silent MPEG-1 Layer III frames.
+# Run from this folder: python make_fixtures.py
+
+import os
+import struct
+
+
+def syncsafe(n):
+    return bytes([(n >> 21) & 0x7F, (n >> 14) & 0x7F, (n >> 7) & 0x7F, n & 0x7F])
+
+
+def frame(version, frame_id, payload, format_flags=0):
+    size = syncsafe(len(payload)) if version == 4 else struct.pack('>I', len(payload))
+    return frame_id.encode('ascii') + size + bytes([0, format_flags]) + payload
+
+
+def tag(version, frames, flags=0, padding=64):
+    body = b''.join(frames) + b'\0' * padding
+    return b'ID3' + bytes([version, 0, flags]) + syncsafe(len(body)) + body
+
+
+def latin1(*values):
+    return b'\x00' + b'\x00'.join(v.encode('latin-1') for v in values)
+
+
+def utf8(*values):
+    return b'\x03' + b'\x00'.join(v.encode('utf-8') for v in values)
+
+
+def utf16(*values):
+    return b'\x01' + b'\x00\x00'.join(b'\xff\xfe' + v.encode('utf-16-le') for v in values)
+
+
+def utf16be(*values):
+    return b'\x02' + b'\x00\x00'.join(v.encode('utf-16-be') for v in values)
+
+
+def id3v1(title, artist, album, year, genre):
+    def field(text, size):
+        return text.encode('latin-1')[:size].ljust(size, b'\0')
+    return b'TAG' + field(title, 30) + field(artist, 30) + field(album, 30) + field(year, 4) + b'\0' * 30 + bytes([genre])
+
+
+# A 1x1 gray baseline JPEG
+JPEG = bytes.fromhex(
+    'ffd8ffe000104a46494600010100000100010000ffdb004300100b0c0e0c0a100e0d0e1211101318281a181616183123251d283a333d3c3933383740'
+    '485c4e404457453738506d51575f626768673e4d71797064785c656763ffc0000b080001000101011100ffc4001f0000010501010101010100000000'
+    '000000000102030405060708090a0bffc400b5100002010303020403050504040000017d01020300041105122131410613516107227114328191a108'
+    '2342b1c11552d1f02433627282090a161718191a25262728292a3435363738393a434445464748494a535455565758595a636465666768696a737475'
+    '767778797a838485868788898a92939495969798999aa2a3a4a5a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9dae1e2'
+    'e3e4e5e6e7e8e9eaf1f2f3f4f5f6f7f8f9faffda0008010100003f002bffd9')
+
+
+def apic(encoding, mime, description, data):
+    return bytes([encoding]) + mime.encode('ascii') + b'\0' + b'\x03' + description + data
+
+
+SILENCE = (b'\xff\xfb\x90\x64' + b'\0' * 413) * 4   # 128 kbit/s, 44.1 kHz
+
+fixtures = {
+    'id3v2/v23_latin1_utf16.mp3': tag(3, [
+        frame(3, 'TIT2', latin1('Caf\xe9')),
+        frame(3, 'TPE1', utf16('Art\U0001F3B5')),
+        frame(3, 'TALB', latin1('Album')),
+        frame(3, 'TCON', latin1('(17)')),
+        frame(3, 'TYER', latin1('1999')),
+        frame(3, 'APIC', apic(1, 'image/jpeg', '\ufeffd'.encode('utf-16-le') + b'\0\0', JPEG)),
+    ]),
+    'id3v2/v24_multiple_values.mp3': tag(4, [
+        frame(4, 'TIT2', utf16('Part One', 'Part Two')),
+        frame(4, 'TPE1', utf8('First', 'Second', 'Third')),
+        frame(4, 'TALB', utf16be('Album', 'Deluxe')),
+        frame(4, 'TCON', utf8('17', 'Indie', 'Rock')),
+        frame(4, 'TDRC', utf8('2019-05-01')),
+        frame(4, 'APIC', apic(3, 'image/jpeg', b'cover\0', JPEG)),
+    ]),
+    'id3v2/v24_trailing_zero.mp3': tag(4, [
+        frame(4, 'TIT2', utf8('Title', '')),
+        frame(4, 'TPE1', utf16('Artist', '')),
+        frame(4, 'TALB', latin1('Album', '')),
+        frame(4, 'TCON', utf8('Jazz', '')),
+        frame(4, 'TDRC', utf8('2004')),
+    ]),
+    'id3v2/v23_genre_references.mp3': tag(3, [
+        frame(3, 'TIT2', latin1('Refs')),
+        frame(3, 'TPE1', latin1('Artist')),
+        frame(3, 'TALB', latin1('Album')),
+        frame(3, 'TCON', latin1('(17)(31)Indie')),
+        frame(3, 'TYER', latin1('2001')),
+    ]),
+    'id3v2/v23_genre_refinement.mp3': tag(3, [
+        frame(3, 'TIT2', latin1('Refinement')),
+        frame(3, 'TPE1', latin1('Artist')),
+        frame(3, 'TALB', latin1('Album')),
+        frame(3, 'TCON', latin1('(17)Rock')),
+        frame(3, 'TYER', latin1('2002')),
+    ]),
+    'taglib/v24_album_in_id3v1.mp3': tag(4, [
+        frame(4, 'TIT2', utf8('Title')),
+        frame(4, 'TPE1', utf8('Artist')),
+        frame(4, 'TCON', utf8('Rock')),
+        frame(4, 'TDRC', utf8('2010')),
+    ]),
+    'taglib/v23_empty_title.mp3': tag(3, [
+        frame(3, 'TIT2', latin1('')),
+        frame(3, 'TPE1', latin1('Artist')),
+        frame(3, 'TALB', latin1('Album')),
+        frame(3, 'TCON', latin1('Rock')),
+        frame(3, 'TYER', latin1('2011')),
+    ]),
+    'taglib/v24_winamp_genre.mp3': tag(4, [
+        frame(4, 'TIT2', utf8('Title')),
+        frame(4, 'TPE1', utf8('Artist')),
+        frame(4, 'TALB', utf8('Album')),
+        frame(4, 'TCON', utf8('(120)')),
+        frame(4, 'TDRC', utf8('2012')),
+    ]),
+    'taglib/v24_compressed.mp3': tag(4, [
+        frame(4, 'TIT2', utf8('Title'), format_flags=0x08),
+    ]),
+    'taglib/v23_unsynchronised.mp3': tag(3, [frame(3, 'TIT2', latin1('Title'))], flags=0x80),
+    'taglib/v22.mp3': b'ID3\x02\x00\x00' + syncsafe(16) + b'TT2\x00\x00\x06\x00Title' + b'\0' * 6,
+    'taglib/id3v1_only.mp3': b'',
+}
+
+for name, data in fixtures.items():
+    os.makedirs(os.path.dirname(name), exist_ok=True)
+    with open(name, 'wb') as f:
+        f.write(data + SILENCE)
+
+# ID3v1 tags go at the end of the file
+with open('taglib/v24_album_in_id3v1.mp3', 'ab') as f:
+    f.write(id3v1('Title', 'Artist', 'Album from ID3v1', '2010', 17))
+with open('taglib/id3v1_only.mp3', 'ab') as f:
+    f.write(id3v1('Title', 'Artist', 'Album', '2013', 17))